@@ -0,0 +1,1390 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BenchmarkVariants.cxx
+* @author Naoki Eto
+* @brief This program benchmarks the variants (serial, pthreads,
+*        pthreads-files, mpi, mpi-files, hybrid) on the 27, 64 and 512 file
+*        datasets. Every variant is run a few times to warm up and then
+*        repeatedly, each run in a scratch directory of its own, and the
+*        wall clock times of the runs are summed up into min, median, 95th
+*        percentile, mean and standard deviation, together with the
+*        triangles of the output and triangles per second at the median.
+*        The results are printed as a table and written to CSV and/or JSON.
+*        With --sweep, every variant is run with every number of processes
+*        and threads asked for, and the runs are summed up into speedup and
+*        parallel efficiency tables (strong scaling on each dataset, weak
+*        scaling across datasets with the same files per worker), and, for
+*        variants built with STAGE_TRACING, a table of the share of each
+*        stage, flagging the stage whose share grows the fastest.
+* @param[in] --variant NAME - a variant to run, may be given more than once
+*            (all of them if left out, mpi, pthreads and hybrid with --sweep)
+* @param[in] --dataset NAME - 27, 64, 512, a ".visit" manifest or a prefix
+*            with its number of files (PREFIX:N), may be given more than once
+*            (27 if left out)
+* @param[in] --procs LIST - MPI processes of the mpi and hybrid variants, a
+*            number, a range (2-9) or a comma separated list of them
+* @param[in] --threads LIST - threads of the pthreads and hybrid variants,
+*            like --procs
+* @param[in] --sweep - prints the scaling and stage tables
+* @param[in] --warmup N - runs before the measured ones (1)
+* @param[in] --repetitions N - measured runs (5)
+* @param[in] --root DIR - the directory with the variants and datasets (..)
+* @param[in] --build DIR - the build directory of each variant (build)
+* @param[in] --workdir DIR - where the scratch directories go (bench_work)
+* @param[in] --mpirun CMD - the MPI launcher (mpirun)
+* @param[in] --csv FILE, --json FILE - where the results go
+* @param[in] --verbose - shows the output of the runs
+* @return - EXIT_SUCCESS if every configuration had a successful run
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "StageTraceSummary.h"
+
+/**
+ * How to run one of the variants.
+ */
+typedef struct Bench_Variant
+{
+    const char* Name;
+    const char* Directory;
+    const char* Program;
+    bool Mpi;
+    bool Threads;
+    // reads prefix + n + ".vtk" for worker n, so needs a prefix and one
+    // file per worker
+    bool FilePerWorker;
+} bench_variant;
+
+static const bench_variant Variants[] =
+{
+    { "serial", "Serial_No_Files_Rectilinear", "ApplyingVtkMarchingCubes", false, false, false },
+    { "pthreads", "Pthreads_No_Files_Rectilinear", "ApplyingVtkContourFilter", false, true, false },
+    { "pthreads-files", "Pthreads_Files_Rectilinear", "ApplyingVtkContourFilter", false, true, true },
+    { "mpi", "MPI_No_files_Rectilinear", "ApplyingVtkContourFilter", true, false, false },
+    { "mpi-files", "MPI_files_Rectilinear", "ApplyingVtkContourFilter", true, false, true },
+    { "hybrid", "MPI_Pthreads_Rectilinear", "ApplyingVtkContourFilter", true, true, false }
+};
+
+static const int NumVariants = sizeof(Variants) / sizeof(Variants[0]);
+
+/**
+ * A dataset: its manifest, its filename prefix, and how many files it has.
+ */
+typedef struct Bench_Dataset
+{
+    std::string Name;
+    std::string Manifest;
+    std::string Prefix;
+    int Blocks;
+} bench_dataset;
+
+/**
+ * What to run, and how often.
+ */
+typedef struct Bench_Options
+{
+    std::vector<std::string> Variants;
+    std::vector<std::string> Datasets;
+    std::vector<int> Procs;
+    std::vector<int> Threads;
+    bool Sweep;
+    int Warmup;
+    int Repetitions;
+    std::string Root;
+    std::string Build;
+    std::string Workdir;
+    std::string Mpirun;
+    std::string Csv;
+    std::string Json;
+    bool Verbose;
+} bench_options;
+
+/**
+ * The summed up runs of one variant on one dataset.
+ */
+typedef struct Bench_Result
+{
+    std::string Variant;
+    std::string Dataset;
+    int Blocks;
+    int Procs;
+    int Threads;
+    int Workers;
+    int Runs;
+    int Failures;
+    double Min;
+    double Median;
+    double P95;
+    double Mean;
+    double StdDev;
+    double ReportedMedian;
+    long long Triangles;
+    double TrianglesPerSecond;
+    // against the serial variant, or the fewest workers (0 if not swept)
+    double Speedup;
+    double Efficiency;
+    // mean seconds per run of every traced stage, over all the threads
+    // and processes
+    std::vector<std::string> StageNames;
+    std::vector<double> StageSeconds;
+} bench_result;
+
+/**
+ * The stages of the tracer, in the order they are printed. Stages that
+ * are not in here come after them.
+ */
+static const char* StageOrder[] =
+{
+    "read", "parse", "range", "contour", "normals", "send", "receive", "append", "write"
+};
+
+static const int NumStageOrder = sizeof(StageOrder) / sizeof(StageOrder[0]);
+
+/**
+ * Returns the absolute path of path, which has to exist.
+ */
+static std::string absolute_path(const std::string& path)
+{
+    char resolved[4096];
+
+    if (realpath(path.c_str(), resolved) == NULL)
+        return path;
+
+    return resolved;
+}
+
+/**
+ * Returns the number as a string.
+ */
+static std::string to_string(int number)
+{
+    std::ostringstream out;
+
+    out << number;
+
+    return out.str();
+}
+
+/**
+ * Counts the file names of a ".visit" manifest. Returns -1 if it cannot be
+ * read.
+ */
+static int count_manifest_blocks(const std::string& manifest)
+{
+    FILE* in = fopen(manifest.c_str(), "r");
+
+    if (in == NULL)
+        return -1;
+
+    char line[4096];
+    int blocks = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (line[0] != '!' && line[strspn(line, " \t\r\n")] != '\0')
+            blocks++;
+    }
+
+    fclose(in);
+
+    return blocks;
+}
+
+/**
+ * Turns a dataset argument into its manifest, prefix and number of files:
+ * 27, 64 and 512 are the datasets in the root directory, X.vtk.visit a
+ * manifest whose prefix is X.vtk., and PREFIX:N a prefix of N files.
+ * Returns false if the dataset cannot be found.
+ */
+static bool resolve_dataset(const bench_options& options, const std::string& name,
+                            bench_dataset& dataset)
+{
+    std::string base;
+
+    if (name == "27")
+        base = options.Root + "/27PartVTK/27noise.vtk.";
+    else if (name == "64")
+        base = options.Root + "/64PartVtk/64noise.vtk.";
+    else if (name == "512")
+        base = options.Root + "/512PartVtk/512noise.vtk.";
+
+    dataset.Name = name;
+
+    std::string::size_type colon = name.rfind(':');
+
+    if (!base.empty() || (name.size() > 6 && name.compare(name.size() - 6, 6, ".visit") == 0))
+    {
+        if (base.empty())
+            base = name.substr(0, name.size() - 5);
+
+        dataset.Manifest = absolute_path(base + "visit");
+        dataset.Blocks = count_manifest_blocks(dataset.Manifest);
+
+        std::string::size_type slash = dataset.Manifest.rfind('/');
+        std::string::size_type baseSlash = base.rfind('/');
+
+        dataset.Prefix = dataset.Manifest.substr(0, slash + 1) +
+                         (baseSlash == std::string::npos ? base : base.substr(baseSlash + 1));
+    }
+    else if (colon != std::string::npos)
+    {
+        std::string prefix = name.substr(0, colon);
+        std::string::size_type slash = prefix.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : prefix.substr(0, slash);
+
+        dataset.Prefix = absolute_path(directory) + "/" +
+                         (slash == std::string::npos ? prefix : prefix.substr(slash + 1));
+        dataset.Blocks = atoi(name.c_str() + colon + 1);
+    }
+
+    return dataset.Blocks > 0;
+}
+
+/**
+ * Returns the variant called name, or NULL.
+ */
+static const bench_variant* find_variant(const std::string& name)
+{
+    for (int v = 0; v < NumVariants; v++)
+    {
+        if (name == Variants[v].Name)
+            return &Variants[v];
+    }
+
+    return NULL;
+}
+
+/**
+ * Reads a list of counts: numbers and ranges of them (2-9), separated by
+ * commas. Returns false if it is not one.
+ */
+static bool parse_counts(const std::string& list, std::vector<int>& counts)
+{
+    counts.clear();
+
+    std::string::size_type begin = 0;
+
+    while (begin <= list.size())
+    {
+        std::string::size_type end = list.find(',', begin);
+
+        if (end == std::string::npos)
+            end = list.size();
+
+        std::string item = list.substr(begin, end - begin);
+
+        int first, last;
+        char extra;
+
+        if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &extra) == 2)
+        {
+            if (first < 1 || last < first)
+                return false;
+
+            for (int c = first; c <= last; c++)
+                counts.push_back(c);
+        }
+        else if (sscanf(item.c_str(), "%d%c", &first, &extra) == 1 && first > 0)
+            counts.push_back(first);
+        else
+            return false;
+
+        begin = end + 1;
+    }
+
+    return !counts.empty();
+}
+
+/**
+ * Chooses the processes and threads of a run: what was asked for (0 if
+ * nothing), or one file per worker. The file per worker variants always
+ * get one file per worker, since they cannot take more.
+ */
+static void choose_workers(int askedProcs, int askedThreads, const bench_variant& variant,
+                           const bench_dataset& dataset, int& procs, int& threads)
+{
+    procs = 1;
+    threads = 1;
+
+    if (variant.Mpi && variant.Threads)
+    {
+        procs = askedProcs > 1 ? askedProcs : 3;
+        threads = askedThreads > 0 ? askedThreads
+                                   : (dataset.Blocks + procs - 2) / (procs - 1);
+    }
+    else if (variant.Mpi)
+    {
+        procs = askedProcs > 1 && !variant.FilePerWorker ? askedProcs : dataset.Blocks + 1;
+    }
+    else if (variant.Threads)
+    {
+        threads = askedThreads > 0 && !variant.FilePerWorker ? askedThreads : dataset.Blocks;
+    }
+}
+
+/**
+ * Returns how many workers contour blocks in a run: the threads, in every
+ * process but the first for the MPI variants, whose first process only
+ * gathers.
+ */
+static int count_workers(const bench_variant& variant, int procs, int threads)
+{
+    return (variant.Mpi ? procs - 1 : 1) * threads;
+}
+
+/**
+ * Returns the command line of one run of the variant.
+ */
+static std::vector<std::string> build_command(const bench_options& options,
+                                              const bench_variant& variant,
+                                              const bench_dataset& dataset,
+                                              int procs, int threads,
+                                              const std::string& output)
+{
+    std::vector<std::string> command;
+
+    std::string program = absolute_path(options.Root + "/" + variant.Directory + "/" +
+                                         options.Build + "/" + variant.Program);
+
+    if (variant.Mpi)
+    {
+        std::istringstream launcher(options.Mpirun);
+        std::string word;
+
+        while (launcher >> word)
+            command.push_back(word);
+
+        command.push_back("-np");
+        command.push_back(to_string(procs));
+    }
+
+    command.push_back(program);
+
+    if (variant.Threads)
+        command.push_back(to_string(threads));
+
+    command.push_back(output);
+
+    // the file per worker variants and the serial one only take prefixes
+    bool prefix = variant.FilePerWorker || (!variant.Threads && !variant.Mpi) ||
+                  dataset.Manifest.empty();
+
+    command.push_back(prefix ? dataset.Prefix : dataset.Manifest);
+
+    // the pthreads variant needs the number of files of a prefix
+    if (prefix && variant.Threads && !variant.Mpi && !variant.FilePerWorker)
+        command.push_back(to_string(dataset.Blocks));
+
+    if (prefix && variant.Mpi && !variant.Threads && !variant.FilePerWorker)
+        command.push_back(to_string(dataset.Blocks));
+
+    return command;
+}
+
+/**
+ * Returns the seconds since t0.
+ */
+static double seconds_since(const struct timespec& t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+
+    return (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+}
+
+/**
+ * Runs the command in the directory, and collects what it prints. Returns
+ * the exit status (-1 if it could not be run or was killed), and the wall
+ * clock seconds it took.
+ */
+static int run_command(const std::vector<std::string>& command, const std::string& directory,
+                       double& seconds, std::string& output)
+{
+    int pipes[2];
+
+    if (pipe(pipes) < 0)
+        return -1;
+
+    std::vector<char*> args;
+
+    for (size_t a = 0; a < command.size(); a++)
+        args.push_back((char*) command[a].c_str());
+
+    args.push_back(NULL);
+
+    struct timespec t0;
+
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    pid_t child = fork();
+
+    if (child < 0)
+    {
+        close(pipes[0]);
+        close(pipes[1]);
+        return -1;
+    }
+
+    if (child == 0)
+    {
+        dup2(pipes[1], STDOUT_FILENO);
+        dup2(pipes[1], STDERR_FILENO);
+        close(pipes[0]);
+        close(pipes[1]);
+
+        if (chdir(directory.c_str()) < 0)
+            _exit(127);
+
+        execvp(args[0], &args[0]);
+
+        _exit(127);
+    }
+
+    close(pipes[1]);
+
+    output.clear();
+
+    char buffer[4096];
+    ssize_t got;
+
+    while ((got = read(pipes[0], buffer, sizeof(buffer))) != 0)
+    {
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            break;
+
+        output.append(buffer, got);
+    }
+
+    close(pipes[0]);
+
+    int status;
+
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    seconds = seconds_since(t0);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * Returns the time the program printed itself ("... time elapsed to be:
+ * T"), the last one if there are several, or -1.
+ */
+static double reported_time(const std::string& output)
+{
+    const std::string marker = "time elapsed to be:";
+
+    std::string::size_type at = output.rfind(marker);
+
+    if (at == std::string::npos)
+        return -1;
+
+    return atof(output.c_str() + at + marker.size());
+}
+
+/**
+ * Returns the number of polygons in a vtk polydata file (ASCII or binary),
+ * which for contours are the triangles, or -1 if it cannot be read.
+ */
+static long long count_triangles(const std::string& path)
+{
+    FILE* in = fopen(path.c_str(), "rb");
+
+    if (in == NULL)
+        return -1;
+
+    char line[4096];
+    bool binary = false;
+    long long triangles = -1;
+
+    for (int n = 0; fgets(line, sizeof(line), in) != NULL; n++)
+    {
+        if (n == 2)
+            binary = strncmp(line, "BINARY", 6) == 0;
+
+        long long count;
+        char type[64];
+
+        // skip the points of binary files, they are not lines
+        if (binary && sscanf(line, "POINTS %lld %63s", &count, type) == 2)
+        {
+            int size = strcmp(type, "double") == 0 ? 8 : 4;
+
+            fseeko(in, (off_t) (3 * count * size), SEEK_CUR);
+        }
+        else if (sscanf(line, "POLYGONS %lld", &count) == 1)
+        {
+            triangles = count;
+            break;
+        }
+    }
+
+    fclose(in);
+
+    return triangles;
+}
+
+/**
+ * Makes the directory (and the ones above it) if it is not there yet.
+ */
+static void make_directory(const std::string& path)
+{
+    for (std::string::size_type slash = path.find('/', 1); slash != std::string::npos;
+         slash = path.find('/', slash + 1))
+        mkdir(path.substr(0, slash).c_str(), 0755);
+
+    mkdir(path.c_str(), 0755);
+}
+
+/**
+ * Returns the q-th quantile (0 to 1) of the sorted times, by nearest rank.
+ */
+static double quantile(const std::vector<double>& sorted, double q)
+{
+    int rank = (int) ceil(q * sorted.size());
+
+    if (rank < 1)
+        rank = 1;
+
+    return sorted[rank - 1];
+}
+
+/**
+ * Sums up the times of the successful runs into the result.
+ */
+static void summarize(std::vector<double> times, std::vector<double> reported,
+                      bench_result& result)
+{
+    result.Runs = (int) times.size();
+    result.Min = result.Median = result.P95 = result.Mean = result.StdDev = 0;
+    result.ReportedMedian = -1;
+    result.TrianglesPerSecond = 0;
+
+    if (times.empty())
+        return;
+
+    std::sort(times.begin(), times.end());
+
+    result.Min = times[0];
+    result.P95 = quantile(times, 0.95);
+
+    size_t middle = times.size() / 2;
+
+    result.Median = times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+
+    double sum = 0;
+
+    for (size_t t = 0; t < times.size(); t++)
+        sum += times[t];
+
+    result.Mean = sum / times.size();
+
+    double squares = 0;
+
+    for (size_t t = 0; t < times.size(); t++)
+        squares += (times[t] - result.Mean) * (times[t] - result.Mean);
+
+    result.StdDev = times.size() > 1 ? sqrt(squares / (times.size() - 1)) : 0;
+
+    if (!reported.empty())
+    {
+        std::sort(reported.begin(), reported.end());
+        result.ReportedMedian = quantile(reported, 0.5);
+    }
+
+    if (result.Triangles > 0 && result.Median > 0)
+        result.TrianglesPerSecond = result.Triangles / result.Median;
+}
+
+/**
+ * Runs the variant on the dataset with warmup runs and measured runs, each
+ * in a fresh scratch directory, and sums the measured runs up.
+ */
+static bench_result run_configuration(const bench_options& options, const bench_variant& variant,
+                                      const bench_dataset& dataset, int procs, int threads)
+{
+    bench_result result;
+
+    result.Variant = variant.Name;
+    result.Dataset = dataset.Name;
+    result.Blocks = dataset.Blocks;
+    result.Procs = procs;
+    result.Threads = threads;
+    result.Workers = count_workers(variant, procs, threads);
+    result.Failures = 0;
+    result.Triangles = -1;
+    result.Speedup = 0;
+    result.Efficiency = 0;
+
+    std::string runDir = options.Workdir + "/" + variant.Name + "_" + to_string(dataset.Blocks) +
+                         "_" + to_string(procs) + "x" + to_string(threads) + "/run";
+
+    make_directory(runDir);
+
+    runDir = absolute_path(runDir);
+
+    std::string output = runDir + "/benchmark_output.vtk";
+
+    std::vector<std::string> command = build_command(options, variant, dataset, procs, threads,
+                                                     output);
+
+    std::vector<double> times;
+    std::vector<double> reported;
+
+    for (int r = 0; r < options.Warmup + options.Repetitions; r++)
+    {
+        bool warmup = r < options.Warmup;
+
+        remove(output.c_str());
+        remove_stage_traces(runDir);
+
+        double seconds;
+        std::string printed;
+
+        int status = run_command(command, runDir, seconds, printed);
+
+        if (options.Verbose)
+            fputs(printed.c_str(), stdout);
+
+        long long triangles = status == 0 ? count_triangles(output) : -1;
+
+        if (status != 0 || triangles < 0)
+        {
+            fprintf(stderr, "%s on %s: run %d failed (exit status %d)\n",
+                    variant.Name, dataset.Name.c_str(), r + 1, status);
+
+            if (!options.Verbose)
+                fputs(printed.c_str(), stderr);
+
+            if (!warmup)
+                result.Failures++;
+
+            continue;
+        }
+
+        result.Triangles = triangles;
+
+        if (warmup)
+            continue;
+
+        times.push_back(seconds);
+
+        double self = reported_time(printed);
+
+        if (self >= 0)
+            reported.push_back(self);
+
+        read_stage_traces(runDir, result.StageNames, result.StageSeconds);
+    }
+
+    remove(output.c_str());
+    remove_stage_traces(runDir);
+
+    summarize(times, reported, result);
+
+    for (size_t s = 0; s < result.StageSeconds.size(); s++)
+        result.StageSeconds[s] /= times.size();
+
+    return result;
+}
+
+/**
+ * Returns where the stage goes among the others: its place in StageOrder,
+ * or after them.
+ */
+static int stage_place(const std::string& name)
+{
+    for (int s = 0; s < NumStageOrder; s++)
+    {
+        if (name == StageOrder[s])
+            return s;
+    }
+
+    return NumStageOrder;
+}
+
+/**
+ * Orders stages by their place, then by name.
+ */
+static bool stage_before(const std::string& a, const std::string& b)
+{
+    int placeA = stage_place(a);
+    int placeB = stage_place(b);
+
+    return placeA != placeB ? placeA < placeB : a < b;
+}
+
+/**
+ * Returns the stages traced in any of the results, in order.
+ */
+static std::vector<std::string> traced_stages(const std::vector<bench_result>& results)
+{
+    std::vector<std::string> stages;
+
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        for (size_t s = 0; s < results[r].StageNames.size(); s++)
+        {
+            if (std::find(stages.begin(), stages.end(), results[r].StageNames[s]) == stages.end())
+                stages.push_back(results[r].StageNames[s]);
+        }
+    }
+
+    std::sort(stages.begin(), stages.end(), stage_before);
+
+    return stages;
+}
+
+/**
+ * Returns the mean seconds per run of the stage in the result (0 if it was
+ * not traced).
+ */
+static double stage_seconds(const bench_result& result, const std::string& stage)
+{
+    for (size_t s = 0; s < result.StageNames.size(); s++)
+    {
+        if (result.StageNames[s] == stage)
+            return result.StageSeconds[s];
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the share of the stage in the time of all the traced stages of
+ * the result.
+ */
+static double stage_share(const bench_result& result, const std::string& stage)
+{
+    double total = 0;
+
+    for (size_t s = 0; s < result.StageSeconds.size(); s++)
+        total += result.StageSeconds[s];
+
+    return total > 0 ? stage_seconds(result, stage) / total : 0;
+}
+
+/**
+ * Writes the results as CSV.
+ */
+static bool write_csv(const std::string& path, const std::vector<bench_result>& results)
+{
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    std::vector<std::string> stages = traced_stages(results);
+
+    fprintf(out, "variant,dataset,procs,threads,runs,failures,min_s,median_s,p95_s,mean_s,"
+                 "stddev_s,reported_median_s,triangles,triangles_per_s,blocks,workers,"
+                 "speedup,efficiency");
+
+    for (size_t s = 0; s < stages.size(); s++)
+        fprintf(out, ",stage_%s_s", stages[s].c_str());
+
+    fprintf(out, "\n");
+
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const bench_result& b = results[r];
+
+        fprintf(out, "%s,%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%lld,%.1f,%d,%d,%.3f,%.3f",
+                b.Variant.c_str(), b.Dataset.c_str(), b.Procs, b.Threads, b.Runs, b.Failures,
+                b.Min, b.Median, b.P95, b.Mean, b.StdDev, b.ReportedMedian, b.Triangles,
+                b.TrianglesPerSecond, b.Blocks, b.Workers, b.Speedup, b.Efficiency);
+
+        for (size_t s = 0; s < stages.size(); s++)
+            fprintf(out, ",%.6f", stage_seconds(b, stages[s]));
+
+        fprintf(out, "\n");
+    }
+
+    return fclose(out) == 0;
+}
+
+/**
+ * Returns the string quoted for JSON.
+ */
+static std::string json_string(const std::string& value)
+{
+    std::string quoted = "\"";
+
+    for (size_t c = 0; c < value.size(); c++)
+    {
+        if (value[c] == '"' || value[c] == '\\')
+            quoted += '\\';
+
+        quoted += value[c];
+    }
+
+    return quoted + "\"";
+}
+
+/**
+ * Writes the results as a JSON array of objects.
+ */
+static bool write_json(const std::string& path, const std::vector<bench_result>& results)
+{
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "[\n");
+
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const bench_result& b = results[r];
+
+        fprintf(out, "  {\"variant\": %s, \"dataset\": %s, \"procs\": %d, \"threads\": %d, "
+                     "\"runs\": %d, \"failures\": %d, \"min_s\": %.6f, \"median_s\": %.6f, "
+                     "\"p95_s\": %.6f, \"mean_s\": %.6f, \"stddev_s\": %.6f, "
+                     "\"reported_median_s\": %.6f, \"triangles\": %lld, "
+                     "\"triangles_per_s\": %.1f, \"blocks\": %d, \"workers\": %d, "
+                     "\"speedup\": %.3f, \"efficiency\": %.3f, \"stages_s\": {",
+                json_string(b.Variant).c_str(), json_string(b.Dataset).c_str(), b.Procs,
+                b.Threads, b.Runs, b.Failures, b.Min, b.Median, b.P95, b.Mean, b.StdDev,
+                b.ReportedMedian, b.Triangles, b.TrianglesPerSecond, b.Blocks, b.Workers,
+                b.Speedup, b.Efficiency);
+
+        for (size_t s = 0; s < b.StageNames.size(); s++)
+        {
+            fprintf(out, "%s%s: %.6f", s > 0 ? ", " : "", json_string(b.StageNames[s]).c_str(),
+                    b.StageSeconds[s]);
+        }
+
+        fprintf(out, "}}%s\n", r + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(out, "]\n");
+
+    return fclose(out) == 0;
+}
+
+/**
+ * Prints the results as a table.
+ */
+static void print_table(const std::vector<bench_result>& results)
+{
+    printf("%-15s %-8s %5s %7s %4s %10s %10s %10s %10s %12s %14s\n",
+           "variant", "dataset", "procs", "threads", "runs", "min", "median", "p95",
+           "stddev", "triangles", "triangles/s");
+
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const bench_result& b = results[r];
+
+        printf("%-15s %-8s %5d %7d %4d %10.4f %10.4f %10.4f %10.4f %12lld %14.1f\n",
+               b.Variant.c_str(), b.Dataset.c_str(), b.Procs, b.Threads, b.Runs, b.Min,
+               b.Median, b.P95, b.StdDev, b.Triangles, b.TrianglesPerSecond);
+    }
+}
+
+/**
+ * Orders results by dataset, then variant, then workers, keeping the order
+ * they were asked for in.
+ */
+struct ResultOrder
+{
+    const std::vector<bench_result>* Results;
+    const bench_options* Options;
+
+    int place(const std::vector<std::string>& names, const std::string& name) const
+    {
+        return (int) (std::find(names.begin(), names.end(), name) - names.begin());
+    }
+
+    bool operator()(size_t a, size_t b) const
+    {
+        const bench_result& ra = (*Results)[a];
+        const bench_result& rb = (*Results)[b];
+
+        if (ra.Blocks != rb.Blocks)
+            return ra.Blocks < rb.Blocks;
+
+        if (ra.Dataset != rb.Dataset)
+            return ra.Dataset < rb.Dataset;
+
+        int va = place(Options->Variants, ra.Variant);
+        int vb = place(Options->Variants, rb.Variant);
+
+        if (va != vb)
+            return va < vb;
+
+        if (ra.Workers != rb.Workers)
+            return ra.Workers < rb.Workers;
+
+        return ra.Procs < rb.Procs;
+    }
+};
+
+/**
+ * Returns the indices of the results, sorted by dataset, variant and
+ * workers.
+ */
+static std::vector<size_t> sorted_results(const bench_options& options,
+                                          const std::vector<bench_result>& results)
+{
+    std::vector<size_t> order;
+
+    for (size_t r = 0; r < results.size(); r++)
+        order.push_back(r);
+
+    ResultOrder before;
+
+    before.Results = &results;
+    before.Options = &options;
+
+    std::stable_sort(order.begin(), order.end(), before);
+
+    return order;
+}
+
+/**
+ * Works out the speedup and parallel efficiency of every result on its
+ * dataset: against the serial variant, if it was run on it, or else
+ * against the run of the same variant with the fewest workers.
+ */
+static void compute_scaling(std::vector<bench_result>& results)
+{
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        bench_result& b = results[r];
+
+        if (b.Runs == 0)
+            continue;
+
+        const bench_result* base = NULL;
+
+        for (size_t o = 0; o < results.size(); o++)
+        {
+            const bench_result& other = results[o];
+
+            if (other.Runs > 0 && other.Dataset == b.Dataset && other.Variant == "serial")
+                base = &other;
+        }
+
+        bool serial = base != NULL;
+
+        for (size_t o = 0; o < results.size() && !serial; o++)
+        {
+            const bench_result& other = results[o];
+
+            if (other.Runs == 0 || other.Dataset != b.Dataset || other.Variant != b.Variant)
+                continue;
+
+            if (base == NULL || other.Workers < base->Workers)
+                base = &other;
+        }
+
+        if (base == NULL || b.Median <= 0)
+            continue;
+
+        b.Speedup = base->Median / b.Median;
+        b.Efficiency = b.Speedup * base->Workers / b.Workers;
+    }
+}
+
+/**
+ * Prints the speedup and parallel efficiency of every run on its dataset
+ * (strong scaling).
+ */
+static void print_strong_scaling(const bench_options& options,
+                                 const std::vector<bench_result>& results)
+{
+    std::vector<size_t> order = sorted_results(options, results);
+
+    printf("\nStrong scaling (against serial if it was run, else the fewest workers)\n");
+    printf("%-15s %-8s %5s %7s %7s %10s %8s %10s\n", "variant", "dataset", "procs", "threads",
+           "workers", "median", "speedup", "efficiency");
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const bench_result& b = results[order[i]];
+
+        if (b.Runs == 0)
+            continue;
+
+        printf("%-15s %-8s %5d %7d %7d %10.4f %8.2f %9.1f%%\n", b.Variant.c_str(),
+               b.Dataset.c_str(), b.Procs, b.Threads, b.Workers, b.Median, b.Speedup,
+               100.0 * b.Efficiency);
+    }
+}
+
+/**
+ * Prints the weak scaling efficiency of every variant: the time of its run
+ * on the smallest dataset with the fewest workers over the time of its
+ * runs with as many files per worker on the bigger datasets. Prints
+ * nothing if no two runs have as many files per worker.
+ */
+static void print_weak_scaling(const bench_options& options,
+                               const std::vector<bench_result>& results)
+{
+    std::vector<size_t> order = sorted_results(options, results);
+    bool header = false;
+
+    for (size_t v = 0; v < options.Variants.size(); v++)
+    {
+        const bench_result* base = NULL;
+
+        // the first in order is the smallest dataset with the fewest workers
+        for (size_t i = 0; i < order.size() && base == NULL; i++)
+        {
+            const bench_result& b = results[order[i]];
+
+            if (b.Runs > 0 && b.Variant == options.Variants[v])
+                base = &b;
+        }
+
+        if (base == NULL)
+            continue;
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const bench_result& b = results[order[i]];
+
+            if (b.Runs == 0 || b.Variant != base->Variant || b.Dataset == base->Dataset ||
+                (long long) b.Blocks * base->Workers != (long long) base->Blocks * b.Workers)
+                continue;
+
+            if (!header)
+            {
+                printf("\nWeak scaling (as many files per worker as the smallest run)\n");
+                printf("%-15s %-8s %7s %-8s %7s %10s %10s\n", "variant", "from", "workers",
+                       "to", "workers", "median", "efficiency");
+                header = true;
+            }
+
+            printf("%-15s %-8s %7d %-8s %7d %10.4f %9.1f%%\n", b.Variant.c_str(),
+                   base->Dataset.c_str(), base->Workers, b.Dataset.c_str(), b.Workers,
+                   b.Median, 100.0 * base->Median / b.Median);
+        }
+    }
+}
+
+/**
+ * Prints the share of every stage in the traced time of every run, then,
+ * for every variant and dataset run with more than one number of workers,
+ * the stage whose share grows the fastest with the workers: the slope of
+ * a least squares line through its shares against log2 of the workers.
+ * Prints nothing if no variant was built with STAGE_TRACING.
+ */
+static void print_stages(const bench_options& options, const std::vector<bench_result>& results)
+{
+    std::vector<std::string> stages = traced_stages(results);
+
+    if (stages.empty())
+    {
+        printf("\nNo stage traces: build the variants with -DSTAGE_TRACING=ON for the "
+               "breakdown by stage\n");
+        return;
+    }
+
+    std::vector<size_t> order = sorted_results(options, results);
+
+    printf("\nShare of the traced time of every stage, over all threads and processes\n");
+    printf("%-15s %-8s %7s", "variant", "dataset", "workers");
+
+    for (size_t s = 0; s < stages.size(); s++)
+        printf(" %8s", stages[s].c_str());
+
+    printf("\n");
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const bench_result& b = results[order[i]];
+
+        if (b.StageNames.empty())
+            continue;
+
+        printf("%-15s %-8s %7d", b.Variant.c_str(), b.Dataset.c_str(), b.Workers);
+
+        for (size_t s = 0; s < stages.size(); s++)
+            printf(" %7.1f%%", 100.0 * stage_share(b, stages[s]));
+
+        printf("\n");
+    }
+
+    printf("\n");
+
+    for (size_t i = 0; i < order.size(); )
+    {
+        // the runs of one variant on one dataset are next to each other
+        size_t end = i;
+        std::vector<const bench_result*> series;
+
+        while (end < order.size() && results[order[end]].Variant == results[order[i]].Variant &&
+               results[order[end]].Dataset == results[order[i]].Dataset)
+        {
+            if (!results[order[end]].StageNames.empty())
+                series.push_back(&results[order[end]]);
+
+            end++;
+        }
+
+        i = end;
+
+        if (series.size() < 2 || series.front()->Workers == series.back()->Workers)
+            continue;
+
+        double meanX = 0;
+
+        for (size_t p = 0; p < series.size(); p++)
+            meanX += log((double) series[p]->Workers) / log(2.0) / series.size();
+
+        double varX = 0;
+
+        for (size_t p = 0; p < series.size(); p++)
+        {
+            double dx = log((double) series[p]->Workers) / log(2.0) - meanX;
+            varX += dx * dx;
+        }
+
+        std::string fastest;
+        double fastestSlope = 0;
+
+        for (size_t s = 0; s < stages.size(); s++)
+        {
+            double covXY = 0;
+
+            for (size_t p = 0; p < series.size(); p++)
+            {
+                double dx = log((double) series[p]->Workers) / log(2.0) - meanX;
+                covXY += dx * stage_share(*series[p], stages[s]);
+            }
+
+            if (fastest.empty() || covXY / varX > fastestSlope)
+            {
+                fastest = stages[s];
+                fastestSlope = covXY / varX;
+            }
+        }
+
+        if (fastestSlope <= 0)
+        {
+            printf("%s on %s: no stage grows its share with the workers\n",
+                   series.front()->Variant.c_str(), series.front()->Dataset.c_str());
+            continue;
+        }
+
+        printf("%s on %s: %s grows the fastest, +%.1f points per doubling of the workers "
+               "(%.1f%% with %d, %.1f%% with %d)\n", series.front()->Variant.c_str(),
+               series.front()->Dataset.c_str(), fastest.c_str(), 100.0 * fastestSlope,
+               100.0 * stage_share(*series.front(), fastest), series.front()->Workers,
+               100.0 * stage_share(*series.back(), fastest), series.back()->Workers);
+    }
+}
+
+/**
+ * Prints how to use the program.
+ */
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--variant NAME]... [--dataset 27|64|512|X.visit|PREFIX:N]...\n"
+            "          [--procs LIST] [--threads LIST] [--sweep] [--warmup N]\n"
+            "          [--repetitions N] [--root DIR] [--build DIR] [--workdir DIR]\n"
+            "          [--mpirun CMD] [--csv FILE] [--json FILE] [--verbose]\n"
+            "Variants: serial pthreads pthreads-files mpi mpi-files hybrid\n"
+            "LIST: numbers and ranges separated by commas, like 1,2,4,8 or 2-9\n", program);
+}
+
+/**
+ * This program runs every asked for variant on every asked for dataset,
+ * and writes how long they took.
+ */
+int main(int argc, char *argv[])
+{
+    bench_options options;
+
+    options.Sweep = false;
+    options.Warmup = 1;
+    options.Repetitions = 5;
+    options.Root = "..";
+    options.Build = "build";
+    options.Workdir = "bench_work";
+    options.Mpirun = "mpirun";
+    options.Verbose = false;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (arg == "--verbose")
+            options.Verbose = true;
+        else if (arg == "--sweep")
+            options.Sweep = true;
+        else if (arg == "--variant" && hasValue)
+            options.Variants.push_back(argv[++a]);
+        else if (arg == "--dataset" && hasValue)
+            options.Datasets.push_back(argv[++a]);
+        else if (arg == "--procs" && hasValue && parse_counts(argv[a + 1], options.Procs))
+            a++;
+        else if (arg == "--threads" && hasValue && parse_counts(argv[a + 1], options.Threads))
+            a++;
+        else if (arg == "--warmup" && hasValue)
+            options.Warmup = atoi(argv[++a]);
+        else if (arg == "--repetitions" && hasValue)
+            options.Repetitions = atoi(argv[++a]);
+        else if (arg == "--root" && hasValue)
+            options.Root = argv[++a];
+        else if (arg == "--build" && hasValue)
+            options.Build = argv[++a];
+        else if (arg == "--workdir" && hasValue)
+            options.Workdir = argv[++a];
+        else if (arg == "--mpirun" && hasValue)
+            options.Mpirun = argv[++a];
+        else if (arg == "--csv" && hasValue)
+            options.Csv = argv[++a];
+        else if (arg == "--json" && hasValue)
+            options.Json = argv[++a];
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.Variants.empty() && options.Sweep)
+    {
+        options.Variants.push_back("mpi");
+        options.Variants.push_back("pthreads");
+        options.Variants.push_back("hybrid");
+    }
+    else if (options.Variants.empty())
+    {
+        for (int v = 0; v < NumVariants; v++)
+            options.Variants.push_back(Variants[v].Name);
+    }
+
+    // nothing asked for: one file per worker
+    if (options.Procs.empty())
+        options.Procs.push_back(0);
+
+    if (options.Threads.empty())
+        options.Threads.push_back(0);
+
+    if (options.Datasets.empty())
+        options.Datasets.push_back("27");
+
+    if (options.Repetitions < 1)
+        options.Repetitions = 1;
+
+    std::vector<bench_result> results;
+    bool allRan = true;
+
+    for (size_t d = 0; d < options.Datasets.size(); d++)
+    {
+        bench_dataset dataset;
+
+        dataset.Blocks = 0;
+
+        if (!resolve_dataset(options, options.Datasets[d], dataset))
+        {
+            fprintf(stderr, "Could not find the dataset %s\n", options.Datasets[d].c_str());
+            return EXIT_FAILURE;
+        }
+
+        for (size_t v = 0; v < options.Variants.size(); v++)
+        {
+            const bench_variant* variant = find_variant(options.Variants[v]);
+
+            if (variant == NULL)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            // the counts a variant does not take give the same run again
+            std::vector<std::pair<int, int> > ran;
+
+            for (size_t p = 0; p < options.Procs.size(); p++)
+            {
+                for (size_t t = 0; t < options.Threads.size(); t++)
+                {
+                    int procs, threads;
+
+                    choose_workers(options.Procs[p], options.Threads[t], *variant, dataset,
+                                   procs, threads);
+
+                    std::pair<int, int> workers(procs, threads);
+
+                    if (std::find(ran.begin(), ran.end(), workers) != ran.end())
+                        continue;
+
+                    ran.push_back(workers);
+
+                    printf("Running %s on %s (%d processes, %d threads): %d + %d runs\n",
+                           variant->Name, dataset.Name.c_str(), procs, threads, options.Warmup,
+                           options.Repetitions);
+                    fflush(stdout);
+
+                    bench_result result = run_configuration(options, *variant, dataset, procs,
+                                                            threads);
+
+                    if (result.Runs == 0)
+                        allRan = false;
+
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    compute_scaling(results);
+
+    print_table(results);
+
+    if (options.Sweep)
+    {
+        print_strong_scaling(options, results);
+        print_weak_scaling(options, results);
+        print_stages(options, results);
+    }
+
+    if (!options.Csv.empty() && !write_csv(options.Csv, results))
+        fprintf(stderr, "Could not write %s\n", options.Csv.c_str());
+
+    if (!options.Json.empty() && !write_json(options.Json, results))
+        fprintf(stderr, "Could not write %s\n", options.Json.c_str());
+
+    return allRan ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file CoalescingVtkRectilinearFiles.cxx
+* @author Naoki Eto
+* @brief This program merges neighbouring VTK rectilinear blocks of a
+*        dataset into bricks of about a target number of points, and writes
+*        a ".visit" manifest of the bricks.
+* @param[in] argv[1] - the prefix of the bricks (i.e. 512brick.vtk.), the
+*            manifest is this prefix + "visit"
+* @param[in] argv[2] - the target number of points of a brick
+* @param[in] argv[3] - the prefix of the files (i.e. 512noise.vtk.) or a
+*            ".visit" manifest (i.e. 512noise.vtk.visit)
+* @param[in] argv[4] - the number of files when argv[3] is a prefix
+* @param[out] the bricks and their manifest
+* @return - EXIT_SUCCESS at the end, EXIT_FAILURE if the blocks could not
+*           be merged
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "BlockCoalesce.h"
+#include "BlockManifest.h"
+
+/**
+ * This program takes in vtkRectilinear files, finds which of them are
+ * neighbours, and writes them out again as fewer, bigger files.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || (!is_visit_manifest(argv[3]) && argc < 5))
+    {
+        fprintf(stderr, "Usage: %s OUTPREFIX TARGETPOINTS PREFIX NUMFILES | "
+                "%s OUTPREFIX TARGETPOINTS MANIFEST.visit\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::string outPrefix = argv[1];
+
+    long long targetPoints = atoll(argv[2]);
+
+    int numFiles = argc > 4 ? atoi(argv[4]) : 0;
+
+    std::vector<std::string> files;
+
+    if (read_block_list(argv[3], numFiles, files) < 0)
+    {
+        fprintf(stderr, "Could not read the manifest %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> bricks;
+    coalesce_stats stats;
+
+    if (coalesce_blocks(files, targetPoints, outPrefix, bricks, &stats) < 0)
+        return EXIT_FAILURE;
+
+    std::string manifest = outPrefix + "visit";
+
+    if (!write_block_manifest(manifest, bricks))
+    {
+        fprintf(stderr, "Could not write the manifest %s\n", manifest.c_str());
+        return EXIT_FAILURE;
+    }
+
+    printf("Merged %d blocks (%d x %d x %d) into %d bricks of up to %d x %d x %d blocks "
+           "(%lld points) in %f s, listed in %s\n",
+           stats.Blocks, stats.Lattice[0], stats.Lattice[1], stats.Lattice[2], stats.Bricks,
+           stats.BlocksPerBrick[0], stats.BlocksPerBrick[1], stats.BlocksPerBrick[2],
+           stats.LargestBrick, stats.Seconds, manifest.c_str());
+
+    return EXIT_SUCCESS;
+}
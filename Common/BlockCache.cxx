@@ -0,0 +1,188 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockCache.cxx
+* @author Naoki Eto
+* @brief Least recently used cache of vtk rectilinear files.
+*/
+
+#include "BlockCache.h"
+
+#include <vtkRectilinearGrid.h>
+#include <vtkRectilinearGridReader.h>
+
+cache_budget* cache_budget_create(unsigned long budget)
+{
+    cache_budget* shared = new cache_budget;
+
+    shared->Budget = budget;
+    shared->Bytes = 0;
+
+    pthread_mutex_init(&shared->mutex, NULL);
+
+    return shared;
+}
+
+bool cache_budget_charge(cache_budget* budget, long bytes)
+{
+    pthread_mutex_lock(&budget->mutex);
+
+    budget->Bytes += bytes;
+
+    bool over = budget->Bytes > budget->Budget;
+
+    pthread_mutex_unlock(&budget->mutex);
+
+    return over;
+}
+
+void cache_budget_destroy(cache_budget* budget)
+{
+    pthread_mutex_destroy(&budget->mutex);
+
+    delete budget;
+}
+
+block_cache* block_cache_create(cache_budget* budget)
+{
+    block_cache* cache = new block_cache;
+
+    cache->Bytes = 0;
+    cache->Budget = budget;
+    cache->Hits = 0;
+    cache->Misses = 0;
+    cache->Evictions = 0;
+
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    return cache;
+}
+
+/**
+ * Charges the file just taken in to the budget, and evicts least recently
+ * used files while the caches charged to it are over it. The most
+ * recently used file always stays, even if it alone is over budget. The
+ * mutex must be held.
+*/
+static void evict(block_cache* cache, unsigned long taken)
+{
+    bool over = cache_budget_charge(cache->Budget, (long) taken);
+
+    while (over && cache->Order.size() > 1)
+    {
+        std::map<std::string, cache_entry>::iterator oldest =
+            cache->Entries.find(cache->Order.back());
+
+        cache->Bytes -= oldest->second.Bytes;
+
+        over = cache_budget_charge(cache->Budget, -(long) oldest->second.Bytes);
+
+        // threads still contouring this grid hold their own reference
+        oldest->second.grid->Delete();
+
+        cache->Order.pop_back();
+        cache->Entries.erase(oldest);
+        cache->Evictions++;
+    }
+}
+
+vtkRectilinearGrid* block_cache_acquire(block_cache* cache, const std::string& file)
+{
+    pthread_mutex_lock(&cache->mutex);
+
+    std::map<std::string, cache_entry>::iterator found = cache->Entries.find(file);
+
+    if (found != cache->Entries.end())
+    {
+        // move it to the front of the least recently used order
+        cache->Order.splice(cache->Order.begin(), cache->Order, found->second.Use);
+
+        vtkRectilinearGrid* grid = found->second.grid;
+        grid->Register(NULL);
+
+        cache->Hits++;
+
+        pthread_mutex_unlock(&cache->mutex);
+
+        return grid;
+    }
+
+    cache->Misses++;
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    // read without holding the mutex, so that other threads can go on
+    vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
+
+    reader->SetFileName(file.c_str());
+    reader->Update();
+
+    vtkRectilinearGrid* grid = vtkRectilinearGrid::New();
+    grid->ShallowCopy(reader->GetOutput());
+    reader->Delete();
+
+    if (grid->GetNumberOfPoints() == 0)
+    {
+        grid->Delete();
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    found = cache->Entries.find(file);
+
+    if (found == cache->Entries.end())
+    {
+        cache_entry entry;
+
+        entry.grid = grid;
+
+        // GetActualMemorySize is in kilobytes
+        entry.Bytes = grid->GetActualMemorySize() * 1024;
+
+        cache->Order.push_front(file);
+        entry.Use = cache->Order.begin();
+
+        cache->Entries[file] = entry;
+        cache->Bytes += entry.Bytes;
+
+        // one reference for the cache, one for the caller
+        grid->Register(NULL);
+
+        evict(cache, entry.Bytes);
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return grid;
+}
+
+void block_cache_destroy(block_cache* cache)
+{
+    std::map<std::string, cache_entry>::iterator it;
+
+    for (it = cache->Entries.begin(); it != cache->Entries.end(); ++it)
+        it->second.grid->Delete();
+
+    cache_budget_charge(cache->Budget, -(long) cache->Bytes);
+
+    pthread_mutex_destroy(&cache->mutex);
+
+    delete cache;
+}
@@ -0,0 +1,116 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockCache.h
+* @author Naoki Eto
+* @brief A least recently used cache of read vtk rectilinear files, kept
+*        under a memory budget, so that repeated contours of the same
+*        dataset only pay for the reading once. It can be used from
+*        several threads at the same time. Its budget may be shared with
+*        other caches (see cache_budget), so that all of them together
+*        hold no more than it.
+*/
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+
+#include <pthread.h>
+
+class vtkRectilinearGrid;
+
+/**
+ * A memory budget that one or more caches are charged to: Bytes is what
+ * they hold together. Each cache drops its own least recently used
+ * entries while they are over it, so together they only go over it by
+ * the entry each one last took in.
+*/
+typedef struct Cache_Budget
+{
+    unsigned long Budget;
+    unsigned long Bytes;
+    pthread_mutex_t mutex;
+} cache_budget;
+
+/**
+ * Creates a budget of budget bytes, nothing being charged to it yet.
+*/
+cache_budget* cache_budget_create(unsigned long budget);
+
+/**
+ * Charges bytes to the budget (or gives them back, if negative). Returns
+ * whether the caches are over it afterwards.
+*/
+bool cache_budget_charge(cache_budget* budget, long bytes);
+
+/**
+ * Frees the budget, once no cache is charged to it any more.
+*/
+void cache_budget_destroy(cache_budget* budget);
+
+/**
+ * One read file in the cache, with its size and its place in the least
+ * recently used order.
+*/
+typedef struct Block_Cache_Entry
+{
+    vtkRectilinearGrid* grid;
+    unsigned long Bytes;
+    std::list<std::string>::iterator Use;
+} cache_entry;
+
+/**
+ * The cache itself. Most recently used files are at the front of Order.
+ * Bytes is what it holds, charged to Budget.
+*/
+typedef struct Block_Cache
+{
+    std::map<std::string, cache_entry> Entries;
+    std::list<std::string> Order;
+    unsigned long Bytes;
+    cache_budget* Budget;
+    long Hits;
+    long Misses;
+    long Evictions;
+    pthread_mutex_t mutex;
+} block_cache;
+
+/**
+ * Creates an empty cache of read files charged to budget, which it does
+ * not own.
+*/
+block_cache* block_cache_create(cache_budget* budget);
+
+/**
+ * Returns the vtk rectilinear grid of the file, reading it on a miss. The
+ * returned grid carries a reference for the caller, who has to Delete() it
+ * when done; evicting it from the cache meanwhile is safe. Returns NULL if
+ * the file could not be read.
+*/
+vtkRectilinearGrid* block_cache_acquire(block_cache* cache, const std::string& file);
+
+/**
+ * Drops every file from the cache and frees it.
+*/
+void block_cache_destroy(block_cache* cache);
+
+#endif
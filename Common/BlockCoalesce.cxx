@@ -0,0 +1,455 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockCoalesce.cxx
+* @author Naoki Eto
+* @brief Merging of neighbouring blocks into bricks.
+*/
+
+#include "BlockCoalesce.h"
+#include "BlockManifest.h"
+#include "StreamingContour.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkRectilinearGridReader.h>
+#include <vtkRectilinearGridWriter.h>
+
+/**
+ * The dimensions and coordinates of one block, from its header.
+*/
+typedef struct Coalesce_Block
+{
+    int Dims[3];
+    std::vector<float> Coords[3];
+} coalesce_block;
+
+/**
+ * Where the blocks are: how many there are along each axis, and which
+ * block is at each place of the lattice, x fastest.
+*/
+typedef struct Block_Lattice
+{
+    int Size[3];
+    std::vector<int> At;
+} block_lattice;
+
+/**
+ * Returns the block at place (i, j, k) of the lattice.
+*/
+static int block_at(const block_lattice& lattice, int i, int j, int k)
+{
+    return lattice.At[((size_t) k * lattice.Size[1] + j) * lattice.Size[0] + i];
+}
+
+/**
+ * Returns the coordinates along the axis of the blocks at place c along
+ * that axis.
+*/
+static const std::vector<float>& column_coords(const std::vector<coalesce_block>& blocks,
+                                               const block_lattice& lattice, int axis, int c)
+{
+    int place[3] = { 0, 0, 0 };
+
+    place[axis] = c;
+
+    return blocks[block_at(lattice, place[0], place[1], place[2])].Coords[axis];
+}
+
+/**
+ * Places the blocks on a lattice by where they start. Returns false if the
+ * blocks do not fill a lattice, or if neighbouring blocks do not share
+ * their boundary plane.
+*/
+static bool find_lattice(const std::vector<coalesce_block>& blocks, block_lattice& lattice)
+{
+    std::vector<float> starts[3];
+
+    for (int a = 0; a < 3; a++)
+    {
+        for (size_t b = 0; b < blocks.size(); b++)
+            starts[a].push_back(blocks[b].Coords[a][0]);
+
+        std::sort(starts[a].begin(), starts[a].end());
+        starts[a].erase(std::unique(starts[a].begin(), starts[a].end()), starts[a].end());
+
+        lattice.Size[a] = (int) starts[a].size();
+    }
+
+    if ((size_t) lattice.Size[0] * lattice.Size[1] * lattice.Size[2] != blocks.size())
+        return false;
+
+    lattice.At.assign(blocks.size(), -1);
+
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        int place[3];
+
+        for (int a = 0; a < 3; a++)
+        {
+            place[a] = (int) (std::lower_bound(starts[a].begin(), starts[a].end(),
+                                               blocks[b].Coords[a][0]) - starts[a].begin());
+        }
+
+        size_t at = ((size_t) place[2] * lattice.Size[1] + place[1]) * lattice.Size[0] + place[0];
+
+        if (lattice.At[at] >= 0)
+            return false;
+
+        lattice.At[at] = (int) b;
+    }
+
+    // all the blocks of a column have its coordinates, and every column
+    // starts on the last plane of the one before
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            int c = (int) (std::lower_bound(starts[a].begin(), starts[a].end(),
+                                            blocks[b].Coords[a][0]) - starts[a].begin());
+
+            if (blocks[b].Coords[a] != column_coords(blocks, lattice, a, c))
+                return false;
+        }
+    }
+
+    for (int a = 0; a < 3; a++)
+    {
+        for (int c = 1; c < lattice.Size[a]; c++)
+        {
+            if (column_coords(blocks, lattice, a, c - 1).back() !=
+                column_coords(blocks, lattice, a, c).front())
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Chooses how many blocks along each axis go into a brick: the brick grows
+ * along its shortest axis for as long as it stays within targetPoints,
+ * then the blocks are spread evenly over the bricks of each axis.
+*/
+static void choose_brick_shape(const std::vector<coalesce_block>& blocks,
+                               const block_lattice& lattice, long long targetPoints,
+                               int shape[3])
+{
+    double meanPoints[3];
+
+    for (int a = 0; a < 3; a++)
+    {
+        double sum = 0;
+
+        for (int c = 0; c < lattice.Size[a]; c++)
+            sum += column_coords(blocks, lattice, a, c).size();
+
+        meanPoints[a] = sum / lattice.Size[a];
+
+        shape[a] = 1;
+    }
+
+    bool full[3] = { false, false, false };
+
+    for (;;)
+    {
+        int shortest = -1;
+        double extent[3];
+
+        for (int a = 0; a < 3; a++)
+        {
+            extent[a] = shape[a] * (meanPoints[a] - 1) + 1;
+
+            if (!full[a] && shape[a] < lattice.Size[a] &&
+                (shortest < 0 || extent[a] < extent[shortest]))
+                shortest = a;
+        }
+
+        if (shortest < 0)
+            break;
+
+        extent[shortest] += meanPoints[shortest] - 1;
+
+        if (extent[0] * extent[1] * extent[2] > (double) targetPoints)
+            full[shortest] = true;
+        else
+            shape[shortest]++;
+    }
+
+    for (int a = 0; a < 3; a++)
+    {
+        int bricks = (lattice.Size[a] + shape[a] - 1) / shape[a];
+
+        shape[a] = (lattice.Size[a] + bricks - 1) / bricks;
+    }
+}
+
+/**
+ * Returns a float array with the values.
+*/
+static vtkFloatArray* coordinate_array(const std::vector<float>& values)
+{
+    vtkFloatArray* array = vtkFloatArray::New();
+
+    array->SetNumberOfTuples(values.size());
+
+    for (size_t i = 0; i < values.size(); i++)
+        array->SetValue(i, values[i]);
+
+    return array;
+}
+
+/**
+ * Reads the blocks at places lo to hi (not included) of the lattice, puts
+ * their point arrays together into one brick, and writes it to path.
+ * Returns the number of points of the brick, or -1 if a block cannot be
+ * read or the brick cannot be written.
+*/
+static long long write_brick(const std::vector<std::string>& files,
+                             const std::vector<coalesce_block>& blocks,
+                             const block_lattice& lattice, const int lo[3], const int hi[3],
+                             const std::string& path)
+{
+    // the coordinates of the brick, with the shared planes once, and where
+    // the blocks of each column start in them
+    std::vector<float> coords[3];
+    std::vector<int> offsets[3];
+
+    for (int a = 0; a < 3; a++)
+    {
+        for (int c = lo[a]; c < hi[a]; c++)
+        {
+            const std::vector<float>& column = column_coords(blocks, lattice, a, c);
+
+            int skip = coords[a].empty() ? 0 : 1;
+
+            offsets[a].push_back((int) coords[a].size() - skip);
+            coords[a].insert(coords[a].end(), column.begin() + skip, column.end());
+        }
+    }
+
+    int dims[3] = { (int) coords[0].size(), (int) coords[1].size(), (int) coords[2].size() };
+    vtkIdType numPoints = (vtkIdType) dims[0] * dims[1] * dims[2];
+
+    vtkRectilinearGrid* brick = vtkRectilinearGrid::New();
+    brick->SetDimensions(dims[0], dims[1], dims[2]);
+
+    vtkFloatArray* x = coordinate_array(coords[0]);
+    vtkFloatArray* y = coordinate_array(coords[1]);
+    vtkFloatArray* z = coordinate_array(coords[2]);
+
+    brick->SetXCoordinates(x);
+    brick->SetYCoordinates(y);
+    brick->SetZCoordinates(z);
+
+    x->Delete();
+    y->Delete();
+    z->Delete();
+
+    vtkPointData* brickData = brick->GetPointData();
+
+    vtkRectilinearGridReader* reader = vtkRectilinearGridReader::New();
+
+    bool ok = true;
+
+    for (int k = lo[2]; ok && k < hi[2]; k++)
+    for (int j = lo[1]; ok && j < hi[1]; j++)
+    for (int i = lo[0]; ok && i < hi[0]; i++)
+    {
+        int b = block_at(lattice, i, j, k);
+
+        reader->SetFileName(files[b].c_str());
+        reader->Update();
+
+        vtkRectilinearGrid* block = reader->GetOutput();
+        vtkPointData* blockData = block->GetPointData();
+
+        const int* bdims = blocks[b].Dims;
+
+        if (block->GetNumberOfPoints() != (vtkIdType) bdims[0] * bdims[1] * bdims[2])
+        {
+            fprintf(stderr, "Could not read %s\n", files[b].c_str());
+            ok = false;
+            break;
+        }
+
+        int ox = offsets[0][i - lo[0]];
+        int oy = offsets[1][j - lo[1]];
+        int oz = offsets[2][k - lo[2]];
+
+        for (int n = 0; n < blockData->GetNumberOfArrays(); n++)
+        {
+            vtkDataArray* from = blockData->GetArray(n);
+
+            if (from == NULL || from->GetName() == NULL)
+                continue;
+
+            vtkDataArray* to = brickData->GetArray(from->GetName());
+
+            if (to == NULL)
+            {
+                to = vtkDataArray::CreateDataArray(from->GetDataType());
+                to->SetName(from->GetName());
+                to->SetNumberOfComponents(from->GetNumberOfComponents());
+                to->SetNumberOfTuples(numPoints);
+
+                // "grad" stays the vectors, like in the blocks
+                if (from == blockData->GetVectors())
+                    brickData->SetVectors(to);
+                else if (from == blockData->GetScalars())
+                    brickData->SetScalars(to);
+                else
+                    brickData->AddArray(to);
+
+                to->Delete();
+            }
+
+            for (int kk = 0; kk < bdims[2]; kk++)
+            for (int jj = 0; jj < bdims[1]; jj++)
+            {
+                vtkIdType source = ((vtkIdType) kk * bdims[1] + jj) * bdims[0];
+                vtkIdType target = ((vtkIdType) (oz + kk) * dims[1] + oy + jj) * dims[0] + ox;
+
+                for (int ii = 0; ii < bdims[0]; ii++)
+                    to->SetTuple(target + ii, source + ii, from);
+            }
+        }
+    }
+
+    reader->Delete();
+
+    if (ok)
+    {
+        vtkRectilinearGridWriter* writer = vtkRectilinearGridWriter::New();
+
+        writer->SetFileName(path.c_str());
+        writer->SetInput(brick);
+        writer->SetFileTypeToBinary();
+
+        ok = writer->Write() == 1;
+
+        writer->Delete();
+    }
+
+    brick->Delete();
+
+    return ok ? (long long) numPoints : -1;
+}
+
+int coalesce_blocks(const std::vector<std::string>& files, long long targetPoints,
+                    const std::string& outPrefix, std::vector<std::string>& bricks,
+                    coalesce_stats* stats)
+{
+    coalesce_stats local;
+
+    if (stats == NULL)
+        stats = &local;
+
+    memset(stats, 0, sizeof(coalesce_stats));
+
+    bricks.clear();
+
+    struct timespec t0,t1;
+
+    clock_gettime(CLOCK_REALTIME,&t0);
+
+    std::vector<coalesce_block> blocks(files.size());
+
+    for (size_t b = 0; b < files.size(); b++)
+    {
+        if (!read_grid_header(files[b].c_str(), blocks[b].Dims, blocks[b].Coords))
+        {
+            fprintf(stderr, "Could not read the header of %s\n", files[b].c_str());
+            return -1;
+        }
+    }
+
+    block_lattice lattice;
+
+    if (files.empty() || !find_lattice(blocks, lattice))
+    {
+        fprintf(stderr, "The blocks do not form a lattice of blocks sharing their faces\n");
+        return -1;
+    }
+
+    int shape[3];
+
+    choose_brick_shape(blocks, lattice, targetPoints, shape);
+
+    stats->Blocks = (int) files.size();
+
+    for (int a = 0; a < 3; a++)
+    {
+        stats->Lattice[a] = lattice.Size[a];
+        stats->BlocksPerBrick[a] = shape[a];
+    }
+
+    for (int k = 0; k < lattice.Size[2]; k += shape[2])
+    for (int j = 0; j < lattice.Size[1]; j += shape[1])
+    for (int i = 0; i < lattice.Size[0]; i += shape[0])
+    {
+        int lo[3] = { i, j, k };
+        int hi[3];
+
+        for (int a = 0; a < 3; a++)
+            hi[a] = std::min(lo[a] + shape[a], lattice.Size[a]);
+
+        long long points;
+
+        if (hi[0] - lo[0] == 1 && hi[1] - lo[1] == 1 && hi[2] - lo[2] == 1)
+        {
+            // nothing to merge, the block is its own brick
+            int b = block_at(lattice, i, j, k);
+
+            bricks.push_back(files[b]);
+
+            points = (long long) blocks[b].Dims[0] * blocks[b].Dims[1] * blocks[b].Dims[2];
+        }
+        else
+        {
+            std::string path = block_filename(outPrefix, (int) bricks.size());
+
+            points = write_brick(files, blocks, lattice, lo, hi, path);
+
+            if (points < 0)
+                return -1;
+
+            bricks.push_back(path);
+        }
+
+        if (points > stats->LargestBrick)
+            stats->LargestBrick = points;
+    }
+
+    stats->Bricks = (int) bricks.size();
+
+    clock_gettime(CLOCK_REALTIME,&t1);
+
+    stats->Seconds = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+
+    return (int) bricks.size();
+}
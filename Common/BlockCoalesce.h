@@ -0,0 +1,70 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockCoalesce.h
+* @author Naoki Eto
+* @brief Merges neighbouring blocks of a dataset into bricks of about a
+*        target number of points, so that the reader, contour filter and
+*        normals filter of each task have enough work to pay for
+*        themselves. The blocks have to form a lattice (every block starts
+*        where its neighbours end, sharing the boundary plane, like the
+*        27, 64 and 512 block datasets), which is found from the headers
+*        of the block files. Every brick is a box of neighbouring blocks,
+*        written as one binary rectilinear grid file with the shared planes
+*        only once, so the bricks have the same cells as the blocks. A
+*        brick of one block is the block's own file.
+*
+*        The surface is not the same though: every variant contours a grid
+*        at 50 values over that grid's own range of "grad", so a brick is
+*        contoured at 50 values over the range of all its blocks rather
+*        than every block at 50 values over its own. Bricks are for timing
+*        the work per task, not for output to compare with the blocks'.
+*/
+
+#ifndef BLOCKCOALESCE_H
+#define BLOCKCOALESCE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * What coalescing did.
+*/
+typedef struct Coalesce_Stats
+{
+    int Blocks;
+    int Bricks;
+    int Lattice[3];
+    int BlocksPerBrick[3];
+    long long LargestBrick;
+    double Seconds;
+} coalesce_stats;
+
+/**
+ * Merges the blocks into bricks of at most targetPoints points (or of one
+ * block, if a block is already bigger), written as outPrefix + n + ".vtk",
+ * and fills bricks with the brick files. stats may be NULL. Returns the
+ * number of bricks, or -1 if the blocks cannot be read, do not form a
+ * lattice, or a brick cannot be written.
+*/
+int coalesce_blocks(const std::vector<std::string>& files, long long targetPoints,
+                    const std::string& outPrefix, std::vector<std::string>& bricks,
+                    coalesce_stats* stats);
+
+#endif
@@ -0,0 +1,517 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockLoader.cxx
+* @author Naoki Eto
+* @brief Batched loading of whole files with io_uring or pread.
+*/
+
+#include "BlockLoader.h"
+#include "StageTracer.h"
+#include "WorkerArena.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <map>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/**
+ * One file being read: its descriptor, its buffer, and how much of it has
+ * arrived.
+*/
+typedef struct Loader_File
+{
+    int fd;
+    arena_buffer buffer;
+    unsigned long Size;
+    unsigned long Done;
+} loader_file;
+
+/**
+ * Opens the file and takes a buffer for all of it from the arena. Returns
+ * false if the file cannot be opened.
+*/
+static bool open_file(const std::string& name, loader_file& file, worker_arena& arena)
+{
+    file.fd = open(name.c_str(), O_RDONLY);
+
+    if (file.fd < 0)
+        return false;
+
+    struct stat info;
+
+    if (fstat(file.fd, &info) < 0)
+    {
+        close(file.fd);
+        return false;
+    }
+
+    file.Size = (unsigned long) info.st_size;
+    file.Done = 0;
+    file.buffer = arena_take(arena, file.Size);
+
+    if (file.buffer.Data == NULL)
+    {
+        close(file.fd);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Hands the file to the callback, then lets go of it, its buffer going
+ * back to the arena for the next file.
+*/
+static void finish_file(int fileIndex, loader_file& file, bool ok, worker_arena& arena,
+                        loader_callback callback, void* user, loader_stats* stats)
+{
+    if (ok)
+    {
+        stats->FilesRead++;
+        stats->BytesRead += file.Size;
+        callback(fileIndex, file.buffer.Data, file.Size, user);
+    }
+    else
+    {
+        stats->FilesFailed++;
+        callback(fileIndex, NULL, 0, user);
+    }
+
+    arena_give(arena, file.buffer);
+    close(file.fd);
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * Reads the files with io_uring. Returns how many of the files it went
+ * through: all of them, or, if waiting on the ring failed for another
+ * reason than an interruption, those it had submitted, the reads still in
+ * flight failing (their buffers are not given back to the arena, the
+ * kernel may still write into them). Returns -1, having read nothing, if
+ * the kernel does not let us set up a ring.
+*/
+static int load_with_io_uring(const std::vector<std::string>& files, int queueDepth,
+                              worker_arena& arena, loader_callback callback, void* user,
+                              loader_stats* stats)
+{
+    struct io_uring ring;
+
+    if (io_uring_queue_init(queueDepth, &ring, 0) < 0)
+        return -1;
+
+    stats->UsedIoUring = 1;
+
+    std::vector<loader_file> open_files(files.size());
+
+    // whether each file is still being read
+    std::vector<bool> reading(files.size(), false);
+
+    int next = 0;
+    int inFlight = 0;
+    unsigned long bytesInFlight = 0;
+
+    while (next < (int) files.size() || inFlight > 0)
+    {
+        // fill the queue up to its depth
+        while (inFlight < queueDepth && next < (int) files.size())
+        {
+            loader_file& file = open_files[next];
+
+            if (!open_file(files[next], file, arena))
+            {
+                stats->FilesFailed++;
+                callback(next, NULL, 0, user);
+                next++;
+                continue;
+            }
+
+            if (file.Size == 0)
+            {
+                finish_file(next, file, true, arena, callback, user, stats);
+                next++;
+                continue;
+            }
+
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_read(sqe, file.fd, file.buffer.Data, file.Size, 0);
+            io_uring_sqe_set_data(sqe, (void*) (intptr_t) next);
+
+            reading[next] = true;
+            inFlight++;
+            bytesInFlight += file.Size;
+            next++;
+
+            if (inFlight > stats->PeakInFlight)
+                stats->PeakInFlight = inFlight;
+            if (bytesInFlight > stats->PeakBytesInFlight)
+                stats->PeakBytesInFlight = bytesInFlight;
+        }
+
+        if (inFlight == 0)
+            break;
+
+        TRACE_BEGIN(read);
+
+        io_uring_submit(&ring);
+
+        struct io_uring_cqe* cqe;
+
+        int waited = io_uring_wait_cqe(&ring, &cqe);
+
+        TRACE_END(read);
+
+        if (waited == -EINTR || waited == -EAGAIN)
+            continue;
+
+        if (waited < 0)
+        {
+            fprintf(stderr, "Waiting on io_uring failed (%d), the files still being read "
+                            "failed\n", waited);
+
+            for (int f = 0; f < next; f++)
+            {
+                if (!reading[f])
+                    continue;
+
+                stats->FilesFailed++;
+                callback(f, NULL, 0, user);
+                close(open_files[f].fd);
+            }
+
+            break;
+        }
+
+        int fileIndex = (int) (intptr_t) io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+
+        io_uring_cqe_seen(&ring, cqe);
+
+        loader_file& file = open_files[fileIndex];
+
+        if (result > 0)
+            file.Done += (unsigned long) result;
+
+        if (result > 0 && file.Done < file.Size)
+        {
+            // a short read, ask for the rest
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_read(sqe, file.fd, file.buffer.Data + file.Done,
+                               file.Size - file.Done, file.Done);
+            io_uring_sqe_set_data(sqe, (void*) (intptr_t) fileIndex);
+            continue;
+        }
+
+        reading[fileIndex] = false;
+        inFlight--;
+        bytesInFlight -= file.Size;
+
+        // parse this file while the others are still being read
+        finish_file(fileIndex, file, result >= 0 && file.Done == file.Size, arena,
+                    callback, user, stats);
+    }
+
+    io_uring_queue_exit(&ring);
+
+    return next;
+}
+#endif
+
+/**
+ * Reads the files from first on one after the other with pread, telling
+ * the kernel about the next queueDepth files so that it can read ahead.
+ * The bytes in flight are those of the buffers of the hinted files, which
+ * are all taken at once.
+*/
+static void load_with_pread(const std::vector<std::string>& files, int first, int queueDepth,
+                            worker_arena& arena, loader_callback callback, void* user,
+                            loader_stats* stats)
+{
+    std::vector<loader_file> open_files(files.size());
+    std::vector<bool> opened(files.size(), false);
+
+    int hinted = first;
+    unsigned long bytesHinted = 0;
+
+    if (stats->PeakInFlight < 1)
+        stats->PeakInFlight = 1;
+
+    for (int f = first; f < (int) files.size(); f++)
+    {
+        // hint the files ahead of this one
+        while (hinted < (int) files.size() && hinted < f + queueDepth)
+        {
+            opened[hinted] = open_file(files[hinted], open_files[hinted], arena);
+
+            if (opened[hinted])
+            {
+                posix_fadvise(open_files[hinted].fd, 0, 0, POSIX_FADV_WILLNEED);
+
+                bytesHinted += open_files[hinted].Size;
+            }
+
+            hinted++;
+        }
+
+        if (bytesHinted > stats->PeakBytesInFlight)
+            stats->PeakBytesInFlight = bytesHinted;
+
+        if (!opened[f])
+        {
+            stats->FilesFailed++;
+            callback(f, NULL, 0, user);
+            continue;
+        }
+
+        loader_file& file = open_files[f];
+
+        bool ok = true;
+
+        TRACE_BEGIN(read);
+
+        while (file.Done < file.Size)
+        {
+            ssize_t result = pread(file.fd, file.buffer.Data + file.Done,
+                                   file.Size - file.Done, file.Done);
+
+            if (result <= 0)
+            {
+                ok = false;
+                break;
+            }
+
+            file.Done += (unsigned long) result;
+        }
+
+        TRACE_END(read);
+
+        bytesHinted -= file.Size;
+
+        finish_file(f, file, ok, arena, callback, user, stats);
+    }
+}
+
+/**
+ * Reads every file, like load_files, without looking at the kept files.
+*/
+static void read_files(const std::vector<std::string>& files, int queueDepth,
+                       loader_callback callback, void* user, loader_stats* stats)
+{
+    loader_stats local;
+
+    if (stats == NULL)
+        stats = &local;
+
+    if (queueDepth < 1)
+        queueDepth = 1;
+
+    stats->QueueDepth = queueDepth;
+    stats->PeakInFlight = 0;
+    stats->PeakBytesInFlight = 0;
+    stats->BytesRead = 0;
+    stats->FilesRead = 0;
+    stats->FilesFailed = 0;
+    stats->UsedIoUring = 0;
+
+    // the buffers of the files, recycled from one file to the next for the
+    // whole list (the whole run of a worker)
+    worker_arena arena;
+    init_worker_arena(arena);
+
+    struct timespec t0,t1;
+
+    clock_gettime(CLOCK_REALTIME,&t0);
+
+    int first = 0;
+
+#ifdef HAVE_LIBURING
+    // the files io_uring did not get to are read with pread
+    first = load_with_io_uring(files, queueDepth, arena, callback, user, stats);
+
+    if (first < 0)
+        first = 0;
+#endif
+
+    if (first < (int) files.size())
+        load_with_pread(files, first, queueDepth, arena, callback, user, stats);
+
+    stats->BuffersReused = arena.Reused;
+    stats->BufferBytes = arena.PeakHeldBytes;
+
+    free_worker_arena(arena);
+
+    clock_gettime(CLOCK_REALTIME,&t1);
+
+    stats->Seconds = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+}
+
+/**
+ * The files kept for the whole process (see keep_loaded_files), by path,
+ * and whether the files read now are kept, behind KeptMutex as every
+ * worker thread loads.
+*/
+static pthread_mutex_t KeptMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, std::vector<char> > KeptFiles;
+static bool KeepingFiles = false;
+
+/**
+ * What the reads of load_files need past the kept files: the files read,
+ * their indexes in the list load_files was given, whether to keep them,
+ * and the callback to hand them on to.
+*/
+typedef struct Kept_Load
+{
+    const std::vector<std::string>* Files;
+    const std::vector<int>* Indexes;
+    bool Keep;
+    loader_callback Callback;
+    void* User;
+} kept_load;
+
+/**
+ * Loader callback of the reads of load_files: keeps a copy of the file if
+ * it has to, then hands the file on at its index in the whole list.
+*/
+static void keep_file(int fileIndex, const char* data, unsigned long size, void* user)
+{
+    kept_load* load = (kept_load*) user;
+
+    if (load->Keep && data != NULL)
+    {
+        std::vector<char> copy(data, data + size);
+
+        pthread_mutex_lock(&KeptMutex);
+        KeptFiles[(*load->Files)[fileIndex]].swap(copy);
+        pthread_mutex_unlock(&KeptMutex);
+    }
+
+    load->Callback((*load->Indexes)[fileIndex], data, size, load->User);
+}
+
+void load_files(const std::vector<std::string>& files, int queueDepth,
+                loader_callback callback, void* user, loader_stats* stats)
+{
+    pthread_mutex_lock(&KeptMutex);
+
+    bool keep = KeepingFiles;
+    bool anyKept = !KeptFiles.empty();
+
+    pthread_mutex_unlock(&KeptMutex);
+
+    if (!keep && !anyKept)
+    {
+        read_files(files, queueDepth, callback, user, stats);
+        return;
+    }
+
+    // the kept files are handed on first, and let go of, the others read
+    std::vector<std::string> toRead;
+    std::vector<int> indexes;
+
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        std::vector<char> data;
+        bool kept = false;
+
+        pthread_mutex_lock(&KeptMutex);
+
+        std::map<std::string, std::vector<char> >::iterator it = KeptFiles.find(files[f]);
+
+        if (it != KeptFiles.end())
+        {
+            data.swap(it->second);
+            KeptFiles.erase(it);
+            kept = true;
+        }
+
+        pthread_mutex_unlock(&KeptMutex);
+
+        if (!kept)
+        {
+            toRead.push_back(files[f]);
+            indexes.push_back((int) f);
+            continue;
+        }
+
+        callback((int) f, data.empty() ? "" : &data[0], (unsigned long) data.size(), user);
+    }
+
+    kept_load load;
+    load.Files = &toRead;
+    load.Indexes = &indexes;
+    load.Keep = keep;
+    load.Callback = callback;
+    load.User = user;
+
+    read_files(toRead, queueDepth, keep_file, &load, stats);
+}
+
+void keep_loaded_files(bool keep)
+{
+    pthread_mutex_lock(&KeptMutex);
+    KeepingFiles = keep;
+    pthread_mutex_unlock(&KeptMutex);
+}
+
+unsigned long kept_file_bytes()
+{
+    unsigned long bytes = 0;
+
+    pthread_mutex_lock(&KeptMutex);
+
+    std::map<std::string, std::vector<char> >::const_iterator it;
+
+    for (it = KeptFiles.begin(); it != KeptFiles.end(); ++it)
+        bytes += (unsigned long) it->second.size();
+
+    pthread_mutex_unlock(&KeptMutex);
+
+    return bytes;
+}
+
+void forget_loaded_files()
+{
+    std::map<std::string, std::vector<char> > kept;
+
+    pthread_mutex_lock(&KeptMutex);
+    kept.swap(KeptFiles);
+    pthread_mutex_unlock(&KeptMutex);
+}
+
+void print_loader_stats(const char* who, const loader_stats* stats)
+{
+    printf("%s loaded %d files (%d failed), %lu bytes in %f s with %s: "
+           "queue depth %d, at most %d reads and %lu bytes in flight, "
+           "%d buffers reused out of %lu bytes of buffers\n",
+           who, stats->FilesRead, stats->FilesFailed, stats->BytesRead, stats->Seconds,
+           stats->UsedIoUring ? "io_uring" : "pread", stats->QueueDepth,
+           stats->PeakInFlight, stats->PeakBytesInFlight, stats->BuffersReused,
+           stats->BufferBytes);
+}
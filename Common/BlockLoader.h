@@ -0,0 +1,101 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockLoader.h
+* @author Naoki Eto
+* @brief Reads the whole contents of many files at once. With io_uring
+*        (when built with liburing, HAVE_LIBURING) the reads of up to a
+*        queue depth of files are submitted together and each file is
+*        handed on as soon as its read completes, in whatever order that
+*        is. Without io_uring, or if the kernel refuses it, the files are
+*        read one after the other with pread, with the next files hinted
+*        to the kernel ahead of time. The buffers the files are read into
+*        come from an arena (see WorkerArena.h) and are reused from one
+*        file to the next. A process can keep the files it reads in
+*        memory, for a second pass over them not to read them again.
+*/
+
+#ifndef BLOCKLOADER_H
+#define BLOCKLOADER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * What the loader did, to tune the queue depth on a given filesystem.
+ * PeakBytesInFlight is the most bytes of files read at once: submitted
+ * together with io_uring, or hinted together (their buffers all taken)
+ * with pread. BuffersReused is how many files were read into a buffer of
+ * an earlier file, and BufferBytes the most the buffers took at once.
+*/
+typedef struct Loader_Stats
+{
+    int QueueDepth;
+    int PeakInFlight;
+    unsigned long PeakBytesInFlight;
+    unsigned long BytesRead;
+    int FilesRead;
+    int FilesFailed;
+    int UsedIoUring;
+    int BuffersReused;
+    unsigned long BufferBytes;
+    double Seconds;
+} loader_stats;
+
+/**
+ * Called once per file, in the calling thread, with the index of the file
+ * and its contents. data is NULL if the file could not be read. data is
+ * freed when the callback returns.
+*/
+typedef void (*loader_callback)(int fileIndex, const char* data, unsigned long size, void* user);
+
+/**
+ * Reads every file, with at most queueDepth files in flight, calling the
+ * callback as each one completes. The files kept (see keep_loaded_files)
+ * are handed on first, without being read or counted in stats. stats may
+ * be NULL.
+*/
+void load_files(const std::vector<std::string>& files, int queueDepth,
+                loader_callback callback, void* user, loader_stats* stats);
+
+/**
+ * Starts or stops keeping, for the whole process, a copy of every file
+ * load_files reads. The next load of a kept file hands it on from memory,
+ * without reading it, and lets go of it. Files already kept stay kept
+ * when keeping stops, until loaded or forgotten. Keeping takes as much
+ * memory as the files.
+*/
+void keep_loaded_files(bool keep);
+
+/**
+ * Returns the bytes of the files kept in the process.
+*/
+unsigned long kept_file_bytes();
+
+/**
+ * Lets go of every file still kept in the process.
+*/
+void forget_loaded_files();
+
+/**
+ * Prints the loader stats on one line, prefixed with who loaded.
+*/
+void print_loader_stats(const char* who, const loader_stats* stats);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockManifest.cxx
+* @author Naoki Eto
+* @brief Parsing of filename prefixes and ".visit" manifests into lists of
+*        block files.
+*/
+
+#include "BlockManifest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+bool is_visit_manifest(const std::string& dataset)
+{
+    const std::string suffix = ".visit";
+
+    return dataset.size() > suffix.size() &&
+           dataset.compare(dataset.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string block_filename(const std::string& prefix, int blockId)
+{
+    char buf[16];
+
+    sprintf(buf, "%d", blockId);
+
+    return prefix + buf + ".vtk";
+}
+
+int read_block_list(const std::string& dataset, int numBlocks,
+                    std::vector<std::string>& blockFiles)
+{
+    blockFiles.clear();
+
+    if (!is_visit_manifest(dataset))
+    {
+        for (int n = 0; n < numBlocks; n++)
+            blockFiles.push_back(block_filename(dataset, n));
+
+        return numBlocks;
+    }
+
+    FILE* manifest = fopen(dataset.c_str(), "r");
+
+    if (manifest == NULL)
+        return -1;
+
+    // block names in the manifest are relative to the manifest itself
+    std::string directory;
+    std::string::size_type slash = dataset.rfind('/');
+    if (slash != std::string::npos)
+        directory = dataset.substr(0, slash + 1);
+
+    char line[4096];
+
+    while (fgets(line, sizeof(line), manifest) != NULL)
+    {
+        // strip the newline (and a DOS carriage return)
+        line[strcspn(line, "\r\n")] = '\0';
+
+        // skip blank lines and the "!NBLOCKS n" line
+        if (line[0] == '\0' || line[0] == '!')
+            continue;
+
+        if (line[0] == '/')
+            blockFiles.push_back(line);
+        else
+            blockFiles.push_back(directory + line);
+    }
+
+    fclose(manifest);
+
+    return (int) blockFiles.size();
+}
+
+bool write_block_manifest(const std::string& manifest,
+                          const std::vector<std::string>& blockFiles)
+{
+    FILE* out = fopen(manifest.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    std::string directory;
+    std::string::size_type slash = manifest.rfind('/');
+    if (slash != std::string::npos)
+        directory = manifest.substr(0, slash + 1);
+
+    char cwd[4096];
+    std::string here;
+    if (getcwd(cwd, sizeof(cwd)) != NULL)
+        here = std::string(cwd) + "/";
+
+    fprintf(out, "!NBLOCKS %d\n", (int) blockFiles.size());
+
+    for (size_t b = 0; b < blockFiles.size(); b++)
+    {
+        const std::string& file = blockFiles[b];
+
+        if (!directory.empty() && file.compare(0, directory.size(), directory) == 0 &&
+            file.find('/', directory.size()) == std::string::npos)
+            fprintf(out, "%s\n", file.c_str() + directory.size());
+        else if (directory.empty() && file.find('/') == std::string::npos)
+            fprintf(out, "%s\n", file.c_str());
+        else if (file[0] == '/')
+            fprintf(out, "%s\n", file.c_str());
+        else
+            fprintf(out, "%s%s\n", here.c_str(), file.c_str());
+    }
+
+    return fclose(out) == 0;
+}
@@ -0,0 +1,65 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockManifest.h
+* @author Naoki Eto
+* @brief Turns a dataset argument into the list of its block files. A
+*        dataset is either a filename prefix (i.e. 27noise.vtk.), whose
+*        blocks are prefix + n + ".vtk", or a VisIt ".visit" manifest
+*        (i.e. 27noise.vtk.visit), which lists its blocks after a
+*        "!NBLOCKS n" line.
+*/
+
+#ifndef BLOCKMANIFEST_H
+#define BLOCKMANIFEST_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Returns true when the dataset argument names a ".visit" manifest rather
+ * than a filename prefix.
+ */
+bool is_visit_manifest(const std::string& dataset);
+
+/**
+ * Returns the filename of block blockId for a filename prefix,
+ * i.e. ("27noise.vtk.", 4) gives "27noise.vtk.4.vtk".
+ */
+std::string block_filename(const std::string& prefix, int blockId);
+
+/**
+ * Fills blockFiles with the block filenames of the dataset. For a prefix,
+ * numBlocks names are generated. For a ".visit" manifest, the names listed
+ * in the manifest are used (relative names are taken relative to the
+ * directory of the manifest) and numBlocks is ignored. Returns the number
+ * of blocks, or -1 if the manifest could not be read.
+ */
+int read_block_list(const std::string& dataset, int numBlocks,
+                    std::vector<std::string>& blockFiles);
+
+/**
+ * Writes a ".visit" manifest listing the block files. Files in the
+ * directory of the manifest are listed by their name alone, other relative
+ * names are made absolute. Returns false if the manifest cannot be written.
+ */
+bool write_block_manifest(const std::string& manifest,
+                          const std::vector<std::string>& blockFiles);
+
+#endif
@@ -0,0 +1,476 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockOperators.cxx
+* @author Naoki Eto
+* @brief The slice, threshold and histogram operators run on a loaded
+*        block besides the contour.
+*/
+
+#include "BlockOperators.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <vtkAppendPolyData.h>
+#include <vtkCutter.h>
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkGeometryFilter.h>
+#include <vtkPlane.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkThreshold.h>
+
+static const char* ProductNames[] = { "slice", "threshold", "histogram" };
+
+/**
+ * The values of a histogram row before its bins: the bounds of the block,
+ * its number of points, and the minimum, maximum and mean.
+*/
+static const int HistogramStats = 10;
+
+void default_block_operators(block_operators& operators)
+{
+    operators.Slice = false;
+    operators.SliceAxis = 2;
+    operators.SlicePosition = 0.0;
+    operators.Threshold = false;
+    operators.ThresholdRange[0] = 0.0;
+    operators.ThresholdRange[1] = 0.0;
+    operators.HistogramBins = 0;
+}
+
+bool parse_slice_operator(const std::string& text, block_operators& operators)
+{
+    if (text.size() < 3 || text[1] != '=' || text[0] < 'x' || text[0] > 'z')
+        return false;
+
+    char* end;
+    double position = strtod(text.c_str() + 2, &end);
+
+    if (*end != '\0')
+        return false;
+
+    operators.Slice = true;
+    operators.SliceAxis = text[0] - 'x';
+    operators.SlicePosition = position;
+
+    return true;
+}
+
+bool parse_threshold_operator(const std::string& text, block_operators& operators)
+{
+    size_t colon = text.find(':');
+
+    if (colon == std::string::npos || colon == 0)
+        return false;
+
+    char* end;
+    double low = strtod(text.c_str(), &end);
+
+    if (end != text.c_str() + colon)
+        return false;
+
+    double high = strtod(text.c_str() + colon + 1, &end);
+
+    if (*end != '\0' || colon + 1 == text.size() || high < low)
+        return false;
+
+    operators.Threshold = true;
+    operators.ThresholdRange[0] = low;
+    operators.ThresholdRange[1] = high;
+
+    return true;
+}
+
+bool block_product_enabled(const block_operators& operators, int product)
+{
+    switch (product)
+    {
+    case PRODUCT_SLICE:
+        return operators.Slice;
+    case PRODUCT_THRESHOLD:
+        return operators.Threshold;
+    case PRODUCT_HISTOGRAM:
+        return operators.HistogramBins > 0;
+    default:
+        return false;
+    }
+}
+
+bool any_block_operator(const block_operators& operators)
+{
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (block_product_enabled(operators, p))
+            return true;
+    }
+
+    return false;
+}
+
+const char* block_product_name(int product)
+{
+    return ProductNames[product];
+}
+
+/**
+ * Cuts the grid with the plane of the slice. A block the plane does not go
+ * through is not cut at all.
+*/
+static vtkPolyData* slice_block(const block_operators& operators, vtkRectilinearGrid* grid)
+{
+    TRACE_STAGE(slice);
+
+    vtkPolyData* slice = vtkPolyData::New();
+
+    int axis = operators.SliceAxis;
+    double* bounds = grid->GetBounds();
+
+    if (operators.SlicePosition < bounds[2 * axis] ||
+        operators.SlicePosition > bounds[2 * axis + 1])
+        return slice;
+
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    double normal[3] = { 0.0, 0.0, 0.0 };
+
+    origin[axis] = operators.SlicePosition;
+    normal[axis] = 1.0;
+
+    vtkPlane* plane = vtkPlane::New();
+    plane->SetOrigin(origin);
+    plane->SetNormal(normal);
+
+    vtkCutter* cutter = vtkCutter::New();
+    cutter->SetCutFunction(plane);
+    cutter->SetInput(grid);
+    cutter->Update();
+
+    slice->ShallowCopy(cutter->GetOutput());
+
+    cutter->Delete();
+    plane->Delete();
+
+    MEMORY_RECORD_DATA(slice, slice);
+
+    return slice;
+}
+
+/**
+ * Keeps the cells of the grid within the threshold range, and returns
+ * their outer faces.
+*/
+static vtkPolyData* threshold_block(const block_operators& operators, vtkRectilinearGrid* grid)
+{
+    TRACE_STAGE(threshold);
+
+    vtkThreshold* threshold = vtkThreshold::New();
+
+    // the x component of "grad", like the contour
+    threshold->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+    threshold->SetInput(grid);
+    threshold->ThresholdBetween(operators.ThresholdRange[0], operators.ThresholdRange[1]);
+
+    vtkGeometryFilter* faces = vtkGeometryFilter::New();
+    faces->SetInputConnection(threshold->GetOutputPort());
+    faces->Update();
+
+    vtkPolyData* region = vtkPolyData::New();
+    region->ShallowCopy(faces->GetOutput());
+
+    faces->Delete();
+    threshold->Delete();
+
+    MEMORY_RECORD_DATA(threshold, region);
+
+    return region;
+}
+
+/**
+ * Returns a product holding the histogram rows of bins bins, and none yet.
+*/
+static vtkPolyData* new_histogram(int bins, vtkDoubleArray*& rows)
+{
+    vtkPolyData* histogram = vtkPolyData::New();
+
+    rows = vtkDoubleArray::New();
+    rows->SetName("histogram");
+    rows->SetNumberOfComponents(HistogramStats + bins);
+
+    histogram->GetFieldData()->AddArray(rows);
+
+    rows->Delete();
+
+    return histogram;
+}
+
+/**
+ * Makes the histogram row of the grid, in one pass for the minimum,
+ * maximum and mean and one for the bins.
+*/
+static vtkPolyData* histogram_block(const block_operators& operators, vtkRectilinearGrid* grid)
+{
+    TRACE_STAGE(histogram);
+
+    int bins = operators.HistogramBins;
+
+    vtkDoubleArray* rows;
+    vtkPolyData* histogram = new_histogram(bins, rows);
+
+    vtkDataArray* grad = grid->GetPointData()->GetArray("grad");
+
+    if (grad == NULL)
+        return histogram;
+
+    vtkIdType numPoints = grad->GetNumberOfTuples();
+
+    std::vector<double> row(HistogramStats + bins, 0.0);
+
+    double* bounds = grid->GetBounds();
+
+    for (int b = 0; b < 6; b++)
+        row[b] = bounds[b];
+
+    double low = 1.0e300;
+    double high = -1.0e300;
+    double sum = 0.0;
+
+    for (vtkIdType i = 0; i < numPoints; i++)
+    {
+        double value = grad->GetComponent(i, 0);
+
+        low = value < low ? value : low;
+        high = value > high ? value : high;
+        sum += value;
+    }
+
+    row[6] = (double) numPoints;
+    row[7] = low;
+    row[8] = high;
+    row[9] = numPoints > 0 ? sum / numPoints : 0.0;
+
+    double width = (high - low) / bins;
+
+    for (vtkIdType i = 0; i < numPoints; i++)
+    {
+        int bin = width > 0.0 ? (int) ((grad->GetComponent(i, 0) - low) / width) : 0;
+
+        // the maximum goes in the last bin
+        if (bin >= bins)
+            bin = bins - 1;
+
+        row[HistogramStats + bin] += 1.0;
+    }
+
+    rows->InsertNextTuple(&row[0]);
+
+    return histogram;
+}
+
+void apply_block_operators(const block_operators& operators, vtkRectilinearGrid* grid,
+                           vtkPolyData* products[NUM_BLOCK_PRODUCTS])
+{
+    bool empty = grid->GetNumberOfPoints() == 0;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        products[p] = NULL;
+
+        if (!block_product_enabled(operators, p))
+            continue;
+
+        if (empty)
+        {
+            vtkDoubleArray* rows;
+
+            products[p] = p == PRODUCT_HISTOGRAM ? new_histogram(operators.HistogramBins, rows)
+                                                 : vtkPolyData::New();
+            continue;
+        }
+
+        switch (p)
+        {
+        case PRODUCT_SLICE:
+            products[p] = slice_block(operators, grid);
+            break;
+        case PRODUCT_THRESHOLD:
+            products[p] = threshold_block(operators, grid);
+            break;
+        default:
+            products[p] = histogram_block(operators, grid);
+            break;
+        }
+    }
+}
+
+/**
+ * Returns the histogram rows of a product, or NULL if it has none.
+*/
+static vtkDataArray* histogram_rows(vtkPolyData* histogram)
+{
+    vtkDataArray* rows = histogram->GetFieldData()->GetArray("histogram");
+
+    return rows != NULL && rows->GetNumberOfTuples() > 0 ? rows : NULL;
+}
+
+vtkPolyData* append_block_products(int product, std::vector<vtkPolyData*>& pieces)
+{
+    TRACE_STAGE(append);
+
+    vtkPolyData* appended;
+
+    if (product == PRODUCT_HISTOGRAM)
+    {
+        vtkDataArray* first = NULL;
+
+        for (size_t p = 0; p < pieces.size() && first == NULL; p++)
+            first = histogram_rows(pieces[p]);
+
+        vtkDoubleArray* rows;
+        appended = new_histogram(first != NULL ? first->GetNumberOfComponents() - HistogramStats
+                                               : 0, rows);
+
+        for (size_t p = 0; p < pieces.size(); p++)
+        {
+            vtkDataArray* piece = histogram_rows(pieces[p]);
+
+            for (vtkIdType r = 0; piece != NULL && r < piece->GetNumberOfTuples(); r++)
+                rows->InsertNextTuple(piece->GetTuple(r));
+        }
+    }
+    else
+    {
+        vtkAppendPolyData* append = vtkAppendPolyData::New();
+
+        for (size_t p = 0; p < pieces.size(); p++)
+            append->AddInput(pieces[p]);
+
+        append->Update();
+
+        appended = vtkPolyData::New();
+        appended->ShallowCopy(append->GetOutput());
+
+        append->Delete();
+    }
+
+    for (size_t p = 0; p < pieces.size(); p++)
+        pieces[p]->Delete();
+
+    pieces.clear();
+
+    return appended;
+}
+
+/**
+ * Orders histogram rows by the low corner of their block, z first.
+*/
+static bool row_before(const std::vector<double>& a, const std::vector<double>& b)
+{
+    if (a[4] != b[4])
+        return a[4] < b[4];
+
+    if (a[2] != b[2])
+        return a[2] < b[2];
+
+    return a[0] < b[0];
+}
+
+/**
+ * Writes the histogram rows as text, one block per line.
+*/
+static bool write_histogram(vtkPolyData* histogram, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == NULL)
+        return false;
+
+    vtkDataArray* rows = histogram_rows(histogram);
+
+    std::vector<std::vector<double> > sorted;
+
+    int numValues = rows != NULL ? rows->GetNumberOfComponents() : HistogramStats;
+
+    for (vtkIdType r = 0; rows != NULL && r < rows->GetNumberOfTuples(); r++)
+    {
+        double* tuple = rows->GetTuple(r);
+
+        sorted.push_back(std::vector<double>(tuple, tuple + numValues));
+    }
+
+    std::sort(sorted.begin(), sorted.end(), row_before);
+
+    fprintf(file, "# xmin xmax ymin ymax zmin zmax points min max mean and %d bins of "
+                  "the x component of grad over [min, max]\n", numValues - HistogramStats);
+
+    for (size_t r = 0; r < sorted.size(); r++)
+    {
+        for (int v = 0; v < numValues; v++)
+        {
+            if (v == 6 || v >= HistogramStats)
+                fprintf(file, v == 0 ? "%.0f" : " %.0f", sorted[r][v]);
+            else
+                fprintf(file, v == 0 ? "%g" : " %g", sorted[r][v]);
+        }
+
+        fprintf(file, "\n");
+    }
+
+    return fclose(file) == 0;
+}
+
+bool write_block_product(int product, vtkPolyData* data, const std::string& path)
+{
+    TRACE_STAGE(write);
+
+    if (product == PRODUCT_HISTOGRAM)
+        return write_histogram(data, path);
+
+    vtkPolyDataWriter* writer = vtkPolyDataWriter::New();
+
+    writer->SetFileName(path.c_str());
+    writer->SetFileTypeToBinary();
+    writer->SetInput(data);
+
+    bool written = writer->Write() == 1;
+
+    writer->Delete();
+
+    return written;
+}
+
+std::string block_product_path(const std::string& output, int product)
+{
+    std::string base = output;
+
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".vtk") == 0)
+        base.erase(base.size() - 4);
+
+    return base + "." + ProductNames[product] +
+           (product == PRODUCT_HISTOGRAM ? ".txt" : ".vtk");
+}
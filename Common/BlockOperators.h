@@ -0,0 +1,137 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockOperators.h
+* @author Naoki Eto
+* @brief What else is made of a block while its grid is loaded for the
+*        contour, so that a slice, a threshold region or the statistics of
+*        the blocks do not take another pass reading every file:
+*
+*        slice      the cut of the grid by a plane normal to an axis
+*                   (vtkCutter), with "grad" interpolated on it
+*        threshold  the outer faces of the cells whose points all have the
+*                   x component of "grad" in a range (vtkThreshold and
+*                   vtkGeometryFilter)
+*        histogram  the bounds of the block, and the number of points,
+*                   minimum, maximum, mean and histogram over its own range
+*                   of the x component of "grad"
+*
+*        Every product of a block is a vtkPolyData, the histogram one
+*        holding its row in a "histogram" field array and no points, so
+*        that they are appended, sent and read back like the contoured
+*        pieces, and each one is written to a file of its own.
+*/
+
+#ifndef BLOCKOPERATORS_H
+#define BLOCKOPERATORS_H
+
+#include <string>
+#include <vector>
+
+class vtkPolyData;
+class vtkRectilinearGrid;
+
+/**
+ * The products of the operators, besides the contour.
+*/
+typedef enum Block_Product
+{
+    PRODUCT_SLICE,
+    PRODUCT_THRESHOLD,
+    PRODUCT_HISTOGRAM,
+    NUM_BLOCK_PRODUCTS
+} block_product;
+
+/**
+ * Which operators run on every block, with their parameters: the slice at
+ * SlicePosition along SliceAxis (0, 1 or 2), the cells with the x component
+ * of "grad" within ThresholdRange, and a histogram of HistogramBins bins
+ * (no histogram if 0).
+*/
+typedef struct Block_Operators
+{
+    bool Slice;
+    int SliceAxis;
+    double SlicePosition;
+    bool Threshold;
+    double ThresholdRange[2];
+    int HistogramBins;
+} block_operators;
+
+/**
+ * Fills operators with none of them.
+*/
+void default_block_operators(block_operators& operators);
+
+/**
+ * Reads a slice, AXIS=POSITION (i.e. z=0.5). Returns false if it is not
+ * one.
+*/
+bool parse_slice_operator(const std::string& text, block_operators& operators);
+
+/**
+ * Reads a threshold range, LOW:HIGH. Returns false if it is not one.
+*/
+bool parse_threshold_operator(const std::string& text, block_operators& operators);
+
+/**
+ * Returns whether the operator of the product runs.
+*/
+bool block_product_enabled(const block_operators& operators, int product);
+
+/**
+ * Returns whether any operator runs.
+*/
+bool any_block_operator(const block_operators& operators);
+
+/**
+ * Returns the name of the product (slice, threshold, histogram).
+*/
+const char* block_product_name(int product);
+
+/**
+ * Runs the operators on the grid, in the calling thread, and sets
+ * products[p] to a new vtkPolyData, which the caller has to Delete(), for
+ * every product that is enabled, and to NULL for the others. An empty grid
+ * gives empty products.
+*/
+void apply_block_operators(const block_operators& operators, vtkRectilinearGrid* grid,
+                           vtkPolyData* products[NUM_BLOCK_PRODUCTS]);
+
+/**
+ * Appends the pieces of one product into one and lets go of them: the
+ * geometry of the slices and threshold regions, the rows of the
+ * histograms. Returns a new vtkPolyData, which the caller has to Delete().
+*/
+vtkPolyData* append_block_products(int product, std::vector<vtkPolyData*>& pieces);
+
+/**
+ * Writes a product to path: a slice or threshold region as a binary vtk
+ * file, the histogram as a text file of one row per block, in the order of
+ * their bounds. Returns false if it could not be written.
+*/
+bool write_block_product(int product, vtkPolyData* data, const std::string& path);
+
+/**
+ * Returns the file a product goes to next to the output, i.e.
+ * AllStars.slice.vtk or AllStars.histogram.txt for AllStars.vtk.
+*/
+std::string block_product_path(const std::string& output, int product);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPack.cxx
+* @author Naoki Eto
+* @brief Writing and reading the index of packed dataset files.
+*/
+
+#include "BlockPack.h"
+
+#include <string.h>
+
+/* "VTKPACK1", NumBlocks and a zero */
+static const long long HeaderSize = 8 + 2 * sizeof(int);
+
+bool is_block_pack(const std::string& dataset)
+{
+    const std::string suffix = ".vtkpack";
+
+    return dataset.size() > suffix.size() &&
+           dataset.compare(dataset.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+long long packed_block_size(const int dims[3])
+{
+    long long points = (long long) dims[0] * dims[1] * dims[2];
+
+    return (long long) sizeof(float) * (dims[0] + dims[1] + dims[2] + 3 * points);
+}
+
+FILE* begin_block_pack(const char* packFile, int numBlocks)
+{
+    FILE* pack = fopen(packFile, "wb");
+
+    if (pack == NULL)
+        return NULL;
+
+    int header[2] = { numBlocks, 0 };
+
+    fwrite(BLOCK_PACK_MAGIC, 1, 8, pack);
+    fwrite(header, sizeof(int), 2, pack);
+
+    // the index is written for real once every block is in
+    std::vector<pack_entry> empty(numBlocks);
+    memset(&empty[0], 0, numBlocks * sizeof(pack_entry));
+    fwrite(&empty[0], sizeof(pack_entry), numBlocks, pack);
+
+    return pack;
+}
+
+bool append_packed_block(FILE* pack, std::vector<pack_entry>& index, const int dims[3],
+                         const float* x, const float* y, const float* z, const float* grad)
+{
+    pack_entry entry;
+
+    fseeko(pack, 0, SEEK_END);
+
+    entry.Offset = (long long) ftello(pack);
+    entry.Size = packed_block_size(dims);
+    entry.Dims[0] = dims[0];
+    entry.Dims[1] = dims[1];
+    entry.Dims[2] = dims[2];
+    entry.Reserved = 0;
+
+    size_t points = (size_t) dims[0] * dims[1] * dims[2];
+
+    bool ok = fwrite(x, sizeof(float), dims[0], pack) == (size_t) dims[0] &&
+              fwrite(y, sizeof(float), dims[1], pack) == (size_t) dims[1] &&
+              fwrite(z, sizeof(float), dims[2], pack) == (size_t) dims[2] &&
+              fwrite(grad, sizeof(float), 3 * points, pack) == 3 * points;
+
+    index.push_back(entry);
+
+    return ok;
+}
+
+bool finish_block_pack(FILE* pack, const std::vector<pack_entry>& index)
+{
+    bool ok = fseeko(pack, HeaderSize, SEEK_SET) == 0;
+
+    if (ok && !index.empty())
+        ok = fwrite(&index[0], sizeof(pack_entry), index.size(), pack) == index.size();
+
+    return fclose(pack) == 0 && ok;
+}
+
+void plan_block_pack(const std::vector<int>& dims, std::vector<pack_entry>& index)
+{
+    int numBlocks = (int) dims.size() / 3;
+
+    index.resize(numBlocks);
+
+    long long offset = HeaderSize + (long long) numBlocks * sizeof(pack_entry);
+
+    for (int b = 0; b < numBlocks; b++)
+    {
+        pack_entry& entry = index[b];
+
+        entry.Dims[0] = dims[3 * b];
+        entry.Dims[1] = dims[3 * b + 1];
+        entry.Dims[2] = dims[3 * b + 2];
+        entry.Reserved = 0;
+        entry.Offset = offset;
+        entry.Size = packed_block_size(entry.Dims);
+
+        offset += entry.Size;
+    }
+}
+
+void block_pack_header(const std::vector<pack_entry>& index, std::vector<char>& header)
+{
+    int counts[2] = { (int) index.size(), 0 };
+
+    header.resize(HeaderSize + index.size() * sizeof(pack_entry));
+
+    memcpy(&header[0], BLOCK_PACK_MAGIC, 8);
+    memcpy(&header[8], counts, sizeof(counts));
+
+    if (!index.empty())
+        memcpy(&header[HeaderSize], &index[0], index.size() * sizeof(pack_entry));
+}
+
+bool read_pack_index(const char* packFile, std::vector<pack_entry>& index)
+{
+    FILE* pack = fopen(packFile, "rb");
+
+    if (pack == NULL)
+        return false;
+
+    char magic[8];
+    int header[2];
+
+    bool ok = fread(magic, 1, 8, pack) == 8 &&
+              memcmp(magic, BLOCK_PACK_MAGIC, 8) == 0 &&
+              fread(header, sizeof(int), 2, pack) == 2 &&
+              header[0] >= 0;
+
+    if (ok)
+    {
+        index.resize(header[0]);
+
+        if (header[0] > 0)
+            ok = fread(&index[0], sizeof(pack_entry), header[0], pack) == (size_t) header[0];
+    }
+
+    fclose(pack);
+
+    return ok;
+}
@@ -0,0 +1,105 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPack.h
+* @author Naoki Eto
+* @brief The packed dataset format: every block of a dataset in one binary
+*        file (".vtkpack"), so that all processors can read their blocks
+*        out of a single file. The file is
+*
+*          "VTKPACK1", int NumBlocks, int 0
+*          NumBlocks index entries (pack_entry), one per block
+*          the blocks, each being nx X coordinates, ny Y coordinates,
+*          nz Z coordinates and nx*ny*nz "grad" vectors (3 floats each)
+*
+*        all in the native byte order of the machine that packed it.
+*/
+
+#ifndef BLOCKPACK_H
+#define BLOCKPACK_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#define BLOCK_PACK_MAGIC "VTKPACK1"
+
+/**
+ * Where a block is in the packed file, how many bytes it has, and its
+ * dimensions.
+*/
+typedef struct Block_Pack_Entry
+{
+    long long Offset;
+    long long Size;
+    int Dims[3];
+    int Reserved;
+} pack_entry;
+
+/**
+ * Returns true when the dataset argument names a ".vtkpack" file.
+*/
+bool is_block_pack(const std::string& dataset);
+
+/**
+ * Returns how many bytes a block of the given dimensions has.
+*/
+long long packed_block_size(const int dims[3]);
+
+/**
+ * Creates the packed file for numBlocks blocks, leaving room for the
+ * index. Returns NULL if the file cannot be created.
+*/
+FILE* begin_block_pack(const char* packFile, int numBlocks);
+
+/**
+ * Writes the next block at the end of the packed file and adds its entry
+ * to the index. Returns false if the write failed.
+*/
+bool append_packed_block(FILE* pack, std::vector<pack_entry>& index, const int dims[3],
+                         const float* x, const float* y, const float* z, const float* grad);
+
+/**
+ * Writes the index into the packed file and closes it. Returns false if
+ * the write failed.
+*/
+bool finish_block_pack(FILE* pack, const std::vector<pack_entry>& index);
+
+/**
+ * Fills index with where the blocks of the given dimensions (3 per block)
+ * go when they are packed one after the other in this order, for programs
+ * that write the blocks of a packed file in parallel instead of appending
+ * them.
+*/
+void plan_block_pack(const std::vector<int>& dims, std::vector<pack_entry>& index);
+
+/**
+ * Fills header with the bytes of the header and index of a packed file,
+ * which go at its start.
+*/
+void block_pack_header(const std::vector<pack_entry>& index, std::vector<char>& header);
+
+/**
+ * Reads the header and index of the packed file. Returns false if the file
+ * cannot be read or is not a packed file.
+*/
+bool read_pack_index(const char* packFile, std::vector<pack_entry>& index);
+
+#endif
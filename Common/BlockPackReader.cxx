@@ -0,0 +1,215 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPackReader.cxx
+* @author Naoki Eto
+* @brief Collective MPI-IO reading of packed dataset files.
+*/
+
+#include "BlockPackReader.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkRectilinearGrid.h>
+
+MPI_Info block_pack_hints()
+{
+    const char* hints = getenv("MPIIO_HINTS");
+
+    if (hints == NULL || *hints == '\0')
+        return MPI_INFO_NULL;
+
+    MPI_Info info;
+    MPI_Info_create(&info);
+
+    std::string list(hints);
+    size_t start = 0;
+
+    while (start < list.size())
+    {
+        size_t end = list.find(',', start);
+
+        if (end == std::string::npos)
+            end = list.size();
+
+        std::string pair = list.substr(start, end - start);
+        size_t equals = pair.find('=');
+
+        if (equals != std::string::npos && equals > 0)
+        {
+            std::string key = pair.substr(0, equals);
+            std::string value = pair.substr(equals + 1);
+
+            MPI_Info_set(info, (char*) key.c_str(), (char*) value.c_str());
+        }
+
+        start = end + 1;
+    }
+
+    return info;
+}
+
+bool read_pack_index_all(MPI_Comm comm, const char* packFile, std::vector<pack_entry>& index)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    int numBlocks = -1;
+
+    if (rank == 0 && read_pack_index(packFile, index))
+        numBlocks = (int) index.size();
+
+    MPI_Bcast(&numBlocks, 1, MPI_INT, 0, comm);
+
+    if (numBlocks < 0)
+        return false;
+
+    index.resize(numBlocks);
+
+    if (numBlocks > 0)
+        MPI_Bcast(&index[0], numBlocks * (int) sizeof(pack_entry), MPI_BYTE, 0, comm);
+
+    return true;
+}
+
+/**
+ * Returns a float array of count values (of components each) copied out
+ * of the block.
+*/
+static vtkFloatArray* unpack_array(const float* values, int components, long long count)
+{
+    vtkFloatArray* array = vtkFloatArray::New();
+
+    array->SetNumberOfComponents(components);
+    array->SetNumberOfTuples(count);
+
+    memcpy(array->GetPointer(0), values, components * count * sizeof(float));
+
+    return array;
+}
+
+/**
+ * Turns a block read out of the packed file into a rectilinear grid with
+ * the "grad" vectors, like the legacy reader gives.
+*/
+static void unpack_block(const pack_entry& entry, const float* data, vtkRectilinearGrid* grid)
+{
+    const int* dims = entry.Dims;
+
+    grid->SetDimensions(dims[0], dims[1], dims[2]);
+
+    vtkFloatArray* x = unpack_array(data, 1, dims[0]);
+    vtkFloatArray* y = unpack_array(data + dims[0], 1, dims[1]);
+    vtkFloatArray* z = unpack_array(data + dims[0] + dims[1], 1, dims[2]);
+
+    grid->SetXCoordinates(x);
+    grid->SetYCoordinates(y);
+    grid->SetZCoordinates(z);
+
+    x->Delete();
+    y->Delete();
+    z->Delete();
+
+    long long points = (long long) dims[0] * dims[1] * dims[2];
+
+    vtkFloatArray* grad = unpack_array(data + dims[0] + dims[1] + dims[2], 3, points);
+    grad->SetName("grad");
+
+    grid->GetPointData()->SetVectors(grad);
+
+    grad->Delete();
+}
+
+void read_packed_blocks_all(MPI_Comm comm, const char* packFile,
+                            const std::vector<pack_entry>& index,
+                            const std::vector<int>& blocks, MPI_Info hints,
+                            std::vector<vtkRectilinearGrid*>& grids)
+{
+    grids.clear();
+
+    MPI_File file;
+
+    int opened = MPI_File_open(comm, (char*) packFile, MPI_MODE_RDONLY, hints, &file);
+
+    if (opened != MPI_SUCCESS)
+    {
+        for (int b = 0; b < (int) blocks.size(); b++)
+            grids.push_back(vtkRectilinearGrid::New());
+
+        return;
+    }
+
+    // every processor has to take part in every round
+    int myRounds = (int) blocks.size();
+    int rounds;
+
+    MPI_Allreduce(&myRounds, &rounds, 1, MPI_INT, MPI_MAX, comm);
+
+    for (int r = 0; r < rounds; r++)
+    {
+        MPI_Offset offset = 0;
+        int count = 0;
+        float* data = NULL;
+
+        if (r < myRounds)
+        {
+            const pack_entry& entry = index[blocks[r]];
+
+            // MPI counts are ints, so blocks are read as floats
+            if (entry.Size / (long long) sizeof(float) <= INT_MAX)
+            {
+                offset = (MPI_Offset) entry.Offset;
+                count = (int) (entry.Size / (long long) sizeof(float));
+                data = (float*) malloc(count * sizeof(float));
+            }
+        }
+
+        MPI_Status status;
+
+        int result = MPI_File_read_at_all(file, offset, data, count, MPI_FLOAT, &status);
+
+        if (r >= myRounds)
+            continue;
+
+        vtkRectilinearGrid* grid = vtkRectilinearGrid::New();
+
+        int got = 0;
+
+        if (result == MPI_SUCCESS)
+            MPI_Get_count(&status, MPI_FLOAT, &got);
+
+        if (data != NULL && got == count)
+            unpack_block(index[blocks[r]], data, grid);
+        else
+            fprintf(stderr, "Could not read block %d of %s\n", blocks[r], packFile);
+
+        free(data);
+
+        grids.push_back(grid);
+    }
+
+    MPI_File_close(&file);
+}
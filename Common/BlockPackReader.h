@@ -0,0 +1,70 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPackReader.h
+* @author Naoki Eto
+* @brief Reads the blocks of a packed dataset file (see BlockPack.h) with
+*        collective MPI-IO. Only rank 0 reads the index, and every block is
+*        read with MPI_File_read_at_all at its offset from the index, so the
+*        file system sees one open and a few large coordinated reads instead
+*        of one open and read per block. Processors without a block in a
+*        round take part in it with a read of zero bytes.
+*
+*        The MPI-IO hints come from the MPIIO_HINTS environment variable,
+*        a comma separated list of key=value pairs, for example
+*        "romio_cb_read=enable,cb_nodes=8,cb_buffer_size=16777216".
+*/
+
+#ifndef BLOCKPACKREADER_H
+#define BLOCKPACKREADER_H
+
+#include <mpi.h>
+
+#include <vector>
+
+#include "BlockPack.h"
+
+class vtkRectilinearGrid;
+
+/**
+ * Returns the MPI-IO hints from the MPIIO_HINTS environment variable, or
+ * MPI_INFO_NULL when it is not set. The caller frees them with
+ * MPI_Info_free unless they are MPI_INFO_NULL.
+*/
+MPI_Info block_pack_hints();
+
+/**
+ * Rank 0 reads the index of the packed file and broadcasts it to the other
+ * processors of comm. Collective; returns false on every processor if the
+ * file cannot be read.
+*/
+bool read_pack_index_all(MPI_Comm comm, const char* packFile, std::vector<pack_entry>& index);
+
+/**
+ * Reads the blocks of this processor out of the packed file into grids
+ * (one new grid per block, which the caller has to Delete()). Collective:
+ * every processor of comm calls it, with an empty list of blocks if it has
+ * none. Blocks that cannot be read give empty grids.
+*/
+void read_packed_blocks_all(MPI_Comm comm, const char* packFile,
+                            const std::vector<pack_entry>& index,
+                            const std::vector<int>& blocks, MPI_Info hints,
+                            std::vector<vtkRectilinearGrid*>& grids);
+
+#endif
@@ -0,0 +1,450 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPipeline.cxx
+* @author Naoki Eto
+* @brief Staged read, contour, normals and send pipeline of one worker.
+*/
+
+#include "BlockPipeline.h"
+#include "BoundedQueue.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkRectilinearGridReader.h>
+#include <vtkContourFilter.h>
+#include <vtkExtractRectilinearGrid.h>
+
+/**
+ * One file on its way through the pipeline. grid is set by the reader
+ * stage, piece by the contour and normals stages, and products by the
+ * contour stage.
+*/
+typedef struct Pipeline_Item
+{
+    int Index;
+    vtkRectilinearGrid* grid;
+    vtkPolyData* piece;
+    vtkPolyData* products[NUM_BLOCK_PRODUCTS];
+} pipeline_item;
+
+/**
+ * What the stage threads share: the files and the queues between stages.
+*/
+typedef struct Pipeline_Stages
+{
+    const std::vector<std::string>* Files;
+    int LoaderDepth;
+    int Stride;
+    const block_operators* Operators;
+    loader_stats* Stats;
+    vtkRectilinearGridReader* reader;
+    BoundedQueue<pipeline_item>* Read;
+    BoundedQueue<pipeline_item>* Contoured;
+    BoundedQueue<pipeline_item>* Done;
+} pipeline;
+
+/**
+ * Parses one file that the block loader has read into its own grid, at the
+ * stride of the pipeline, and hands it to the contour stage.
+*/
+static void parse_file(int fileIndex, const char* data, unsigned long size, void* user)
+{
+    pipeline* stages = (pipeline*) user;
+
+    pipeline_item item;
+    item.Index = fileIndex;
+    item.grid = vtkRectilinearGrid::New();
+    item.piece = NULL;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+        item.products[p] = NULL;
+
+    if (data != NULL)
+    {
+        MEMORY_RECORD(read, size);
+
+        TRACE_STAGE(parse);
+
+        stages->reader->SetBinaryInputString(data, (int) size);
+        stages->reader->Modified();
+        stages->reader->Update();
+
+        item.grid->ShallowCopy(stages->reader->GetOutput());
+
+        if (stages->Stride > 1 && item.grid->GetNumberOfPoints() > 0)
+        {
+            vtkRectilinearGrid* strided = stride_block(item.grid, stages->Stride);
+
+            item.grid->Delete();
+            item.grid = strided;
+        }
+
+        MEMORY_RECORD_DATA(parse, item.grid);
+    }
+
+    stages->Read->Push(item);
+}
+
+/**
+ * Reader stage: reads the files in batches, and parses every file into its
+ * own grid as soon as it has arrived, at most depth files ahead of the 
+ * contour stage.
+*/
+static void* reader_stage(void* ptr)
+{
+    pipeline* stages = (pipeline*) ptr;
+
+    stages->reader = vtkRectilinearGridReader::New();
+    stages->reader->ReadFromInputStringOn();
+
+    load_files(*stages->Files, stages->LoaderDepth, parse_file, stages, stages->Stats);
+
+    stages->reader->Delete();
+
+    stages->Read->Close();
+
+    return NULL;
+}
+
+/**
+ * Contour stage: applies vtkContourFilter with 50 values over the range
+ * of "grad", runs the operators on the same grid, and lets go of it.
+*/
+static void* contour_stage(void* ptr)
+{
+    pipeline* stages = (pipeline*) ptr;
+
+    vtkContourFilter* contour = vtkContourFilter::New();
+
+    // name of array is "grad"
+    contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+
+    contour->ComputeNormalsOn();
+
+    pipeline_item item;
+
+    while (stages->Read->Pop(item))
+    {
+        if (stages->Operators != NULL)
+            apply_block_operators(*stages->Operators, item.grid, item.products);
+
+        if (item.grid->GetNumberOfPoints() == 0)
+        {
+            // the file could not be read, it gives an empty piece
+            item.piece = vtkPolyData::New();
+            item.grid->Delete();
+            item.grid = NULL;
+
+            stages->Contoured->Push(item);
+            continue;
+        }
+
+        double* range;
+
+        TRACE_BEGIN(range);
+
+        range = item.grid->GetPointData()->GetArray("grad")->GetRange();
+
+        TRACE_END(range);
+
+        TRACE_BEGIN(contour);
+
+        // better than setinput
+        contour->SetInputConnection(item.grid->GetProducerPort());
+
+        // woo 50 contours
+        contour->GenerateValues(50, range);
+
+        contour->Update();
+
+        TRACE_END(contour);
+
+        item.piece = vtkPolyData::New();
+        item.piece->ShallowCopy(contour->GetOutput());
+
+        MEMORY_RECORD_DATA(contour, item.piece);
+
+        item.grid->Delete();
+        item.grid = NULL;
+
+        stages->Contoured->Push(item);
+    }
+
+    contour->Delete();
+
+    stages->Contoured->Close();
+
+    return NULL;
+}
+
+/**
+ * Normals stage: computes the cell normals of every piece.
+*/
+static void* normals_stage(void* ptr)
+{
+    pipeline* stages = (pipeline*) ptr;
+
+    // calc cell normal
+    vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
+
+    triangleCellNormals->ComputeCellNormalsOn();
+    triangleCellNormals->ComputePointNormalsOff();
+    triangleCellNormals->ConsistencyOn();
+    triangleCellNormals->AutoOrientNormalsOn();
+
+    pipeline_item item;
+
+    while (stages->Contoured->Pop(item))
+    {
+        TRACE_BEGIN(normals);
+
+        triangleCellNormals->SetInputConnection(item.piece->GetProducerPort());
+        triangleCellNormals->Update(); // creates vtkPolyData
+
+        TRACE_END(normals);
+
+        vtkPolyData* normals = vtkPolyData::New();
+        normals->ShallowCopy(triangleCellNormals->GetOutput());
+
+        MEMORY_RECORD_DATA(normals, normals);
+
+        item.piece->Delete();
+        item.piece = normals;
+
+        stages->Done->Push(item);
+    }
+
+    triangleCellNormals->Delete();
+
+    stages->Done->Close();
+
+    return NULL;
+}
+
+/**
+ * The sink of run_block_pipeline() and its user data, for a pipeline with
+ * no operators.
+*/
+typedef struct Pipeline_Sink
+{
+    block_sink Sink;
+    void* User;
+} pipeline_sink;
+
+/**
+ * Hands the piece of a pipeline with no operators to its sink.
+*/
+static void plain_sink(int fileIndex, vtkPolyData* piece,
+                       vtkPolyData* products[NUM_BLOCK_PRODUCTS], void* user)
+{
+    pipeline_sink* plain = (pipeline_sink*) user;
+
+    plain->Sink(fileIndex, piece, plain->User);
+}
+
+void run_block_pipeline(const std::vector<std::string>& files, int depth, int loaderDepth,
+                        block_sink sink, void* user, loader_stats* stats)
+{
+    pipeline_sink plain;
+    plain.Sink = sink;
+    plain.User = user;
+
+    run_block_pipeline_with(files, depth, loaderDepth, 1, NULL, plain_sink, &plain, stats);
+}
+
+void run_block_pipeline_with(const std::vector<std::string>& files, int depth, int loaderDepth,
+                             int stride, const block_operators* operators,
+                             block_products_sink sink, void* user, loader_stats* stats)
+{
+    BoundedQueue<pipeline_item> read(depth);
+    BoundedQueue<pipeline_item> contoured(depth);
+    BoundedQueue<pipeline_item> done(depth);
+
+    pipeline stages;
+    stages.Files = &files;
+    stages.LoaderDepth = loaderDepth;
+    stages.Stride = stride;
+    stages.Operators = operators;
+    stages.Stats = stats;
+    stages.Read = &read;
+    stages.Contoured = &contoured;
+    stages.Done = &done;
+
+    pthread_t reader, contourer, normaler;
+
+    pthread_create(&reader, NULL, reader_stage, (void*) &stages);
+    pthread_create(&contourer, NULL, contour_stage, (void*) &stages);
+    pthread_create(&normaler, NULL, normals_stage, (void*) &stages);
+
+    // sender stage, in the calling thread so that MPI is only ever called
+    // from the thread that initialized it
+    pipeline_item item;
+
+    while (done.Pop(item))
+        sink(item.Index, item.piece, item.products, user);
+
+    pthread_join(reader, NULL);
+    pthread_join(contourer, NULL);
+    pthread_join(normaler, NULL);
+}
+
+block_workspace* new_block_workspace()
+{
+    block_workspace* workspace = new block_workspace;
+
+    workspace->contour = vtkContourFilter::New();
+
+    // name of array is "grad"
+    workspace->contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS,
+                                               "grad");
+
+    workspace->contour->ComputeNormalsOn();
+
+    // calc cell normal
+    workspace->normals = vtkPolyDataNormals::New();
+
+    workspace->normals->ComputeCellNormalsOn();
+    workspace->normals->ComputePointNormalsOff();
+    workspace->normals->ConsistencyOn();
+    workspace->normals->AutoOrientNormalsOn();
+
+    return workspace;
+}
+
+void delete_block_workspace(block_workspace* workspace)
+{
+    workspace->normals->Delete();
+    workspace->contour->Delete();
+
+    delete workspace;
+}
+
+vtkPolyData* contour_block_with(block_workspace* workspace, vtkRectilinearGrid* grid)
+{
+    vtkPolyData* piece = vtkPolyData::New();
+
+    if (grid->GetNumberOfPoints() == 0)
+        return piece;
+
+    double* range;
+
+    TRACE_BEGIN(range);
+
+    range = grid->GetPointData()->GetArray("grad")->GetRange();
+
+    TRACE_END(range);
+
+    TRACE_BEGIN(contour);
+
+    vtkContourFilter* contour = workspace->contour;
+
+    contour->SetInputConnection(grid->GetProducerPort());
+
+    // woo 50 contours
+    contour->GenerateValues(50, range);
+
+    contour->Update();
+
+    TRACE_END(contour);
+
+    MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+    TRACE_BEGIN(normals);
+
+    vtkPolyDataNormals* triangleCellNormals = workspace->normals;
+
+    triangleCellNormals->SetInputConnection(contour->GetOutputPort());
+    triangleCellNormals->Update(); // creates vtkPolyData
+
+    TRACE_END(normals);
+
+    // the filters' outputs are rebuilt for the next block, so keep our own
+    // reference to this block's data
+    piece->ShallowCopy(triangleCellNormals->GetOutput());
+
+    MEMORY_RECORD_DATA(normals, piece);
+
+    // let go of the grid now rather than at the next block
+    contour->SetInputConnection(NULL);
+
+    return piece;
+}
+
+vtkPolyData* contour_block(vtkRectilinearGrid* grid)
+{
+    block_workspace* workspace = new_block_workspace();
+
+    vtkPolyData* piece = contour_block_with(workspace, grid);
+
+    delete_block_workspace(workspace);
+
+    return piece;
+}
+
+vtkRectilinearGrid* stride_block(vtkRectilinearGrid* grid, int stride)
+{
+    TRACE_STAGE(stride);
+
+    int dims[3];
+    grid->GetDimensions(dims);
+
+    vtkExtractRectilinearGrid* extract = vtkExtractRectilinearGrid::New();
+
+    extract->SetInput(grid);
+    extract->SetVOI(0, dims[0] - 1, 0, dims[1] - 1, 0, dims[2] - 1);
+    extract->SetSampleRate(stride, stride, stride);
+
+    // keeps the last point of every axis even if the stride skips it
+    extract->IncludeBoundaryOn();
+    extract->Update();
+
+    vtkRectilinearGrid* strided = vtkRectilinearGrid::New();
+    strided->ShallowCopy(extract->GetOutput());
+
+    extract->Delete();
+
+    return strided;
+}
+
+int loader_queue_depth()
+{
+    const char* depth = getenv("LOADER_QUEUE_DEPTH");
+
+    if (depth != NULL && atoi(depth) > 0)
+        return atoi(depth);
+
+    return 8;
+}
+
+void assign_blocks(const std::vector<std::string>& files, int worker, int numWorkers,
+                   std::vector<std::string>& workerFiles)
+{
+    workerFiles.clear();
+
+    for (int f = worker; f < (int) files.size(); f += numWorkers)
+        workerFiles.push_back(files[f]);
+}
@@ -0,0 +1,138 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BlockPipeline.h
+* @author Naoki Eto
+* @brief Runs the files of one worker through a staged pipeline: a reader
+*        stage, a vtkContourFilter stage and a vtkPolyDataNormals stage
+*        each run in their own pthread, and the calling thread is the
+*        sender stage. The stages are joined by bounded queues, so file
+*        N+1 is read while file N is contoured and file N-1 is sent. The
+*        reader stage reads the worker's files in batches with the block
+*        loader and parses each one as soon as it has arrived, so files
+*        may come out of the pipeline in a different order than they went
+*        in.
+*/
+
+#ifndef BLOCKPIPELINE_H
+#define BLOCKPIPELINE_H
+
+#include <string>
+#include <vector>
+
+#include "BlockLoader.h"
+#include "BlockOperators.h"
+
+class vtkContourFilter;
+class vtkPolyData;
+class vtkPolyDataNormals;
+class vtkRectilinearGrid;
+
+/**
+ * The sender stage. It is called in the calling thread, once per file, 
+ * with the index of the file and its contoured piece, which it owns and 
+ * has to Delete().
+*/
+typedef void (*block_sink)(int fileIndex, vtkPolyData* piece, void* user);
+
+/**
+ * The sender stage of a pipeline running block operators (see
+ * BlockOperators.h): called like block_sink, with the products of the
+ * operators on the same grid as well (NULL for those that did not run),
+ * which it owns too.
+*/
+typedef void (*block_products_sink)(int fileIndex, vtkPolyData* piece,
+                                    vtkPolyData* products[NUM_BLOCK_PRODUCTS], void* user);
+
+/**
+ * Reads, contours (50 values over the range of the "grad" array of each
+ * file) and computes cell normals of every file, handing each piece to
+ * the sink. depth is how many files may wait between two stages, and
+ * loaderDepth how many files the reader stage reads at once. The stats
+ * of the reader stage go into stats, which may be NULL.
+*/
+void run_block_pipeline(const std::vector<std::string>& files, int depth, int loaderDepth,
+                        block_sink sink, void* user, loader_stats* stats);
+
+/**
+ * Runs the pipeline like run_block_pipeline(), contouring every file at a
+ * stride (see stride_block()), 1 being the whole grid and more a coarse
+ * preview, and running the operators (which may be NULL for none) on the
+ * same grid in the contour stage, so that the file is read once for all of
+ * its products.
+*/
+void run_block_pipeline_with(const std::vector<std::string>& files, int depth, int loaderDepth,
+                             int stride, const block_operators* operators,
+                             block_products_sink sink, void* user, loader_stats* stats);
+
+/**
+ * The filters of a worker that contours block after block in one thread,
+ * set up once and reused for every block rather than made anew each time.
+*/
+typedef struct Block_Workspace
+{
+    vtkContourFilter* contour;
+    vtkPolyDataNormals* normals;
+} block_workspace;
+
+/**
+ * Returns a new workspace, to be freed with delete_block_workspace().
+*/
+block_workspace* new_block_workspace();
+
+/**
+ * Frees the workspace and its filters.
+*/
+void delete_block_workspace(block_workspace* workspace);
+
+/**
+ * Contours one grid and computes its cell normals the same way the
+ * pipeline does, in the calling thread, with the filters of the
+ * workspace. Returns a new piece, which the caller has to Delete(); an
+ * empty grid gives an empty piece.
+*/
+vtkPolyData* contour_block_with(block_workspace* workspace, vtkRectilinearGrid* grid);
+
+/**
+ * Contours one grid like contour_block_with(), with filters of its own,
+ * for a single block.
+*/
+vtkPolyData* contour_block(vtkRectilinearGrid* grid);
+
+/**
+ * Returns a new grid of every stride-th point of grid along each axis,
+ * and the last one, so that it still covers the whole block and meets the
+ * blocks next to it, with its point data. The caller has to Delete() it.
+*/
+vtkRectilinearGrid* stride_block(vtkRectilinearGrid* grid, int stride);
+
+/**
+ * Returns the loader queue depth to use, from the LOADER_QUEUE_DEPTH
+ * environment variable, or 8.
+*/
+int loader_queue_depth();
+
+/**
+ * Fills workerFiles with the files a worker takes when numWorkers workers
+ * deal out the files round robin: worker, worker + numWorkers, ...
+*/
+void assign_blocks(const std::vector<std::string>& files, int worker, int numWorkers,
+                   std::vector<std::string>& workerFiles);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file BoundedQueue.h
+* @author Naoki Eto
+* @brief A first in, first out queue between pthreads that holds at most
+*        a fixed number of items. Push waits while the queue is full and
+*        Pop waits while it is empty, so a fast stage can never run more
+*        than the capacity ahead of a slow one.
+*/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+
+#include <pthread.h>
+
+template <class T>
+class BoundedQueue
+{
+public:
+    BoundedQueue(int capacity) : Capacity(capacity), Closed(false)
+    {
+        pthread_mutex_init(&this->mutex, NULL);
+        pthread_cond_init(&this->notFull, NULL);
+        pthread_cond_init(&this->notEmpty, NULL);
+    }
+
+    ~BoundedQueue()
+    {
+        pthread_cond_destroy(&this->notEmpty);
+        pthread_cond_destroy(&this->notFull);
+        pthread_mutex_destroy(&this->mutex);
+    }
+
+    /**
+     * Adds the item at the back, waiting while the queue is full.
+    */
+    void Push(const T& item)
+    {
+        pthread_mutex_lock(&this->mutex);
+
+        while ((int) this->Items.size() >= this->Capacity)
+            pthread_cond_wait(&this->notFull, &this->mutex);
+
+        this->Items.push_back(item);
+
+        pthread_cond_signal(&this->notEmpty);
+        pthread_mutex_unlock(&this->mutex);
+    }
+
+    /**
+     * Takes the item at the front, waiting while the queue is empty.
+     * Returns false once the queue is closed and nothing is left in it.
+    */
+    bool Pop(T& item)
+    {
+        pthread_mutex_lock(&this->mutex);
+
+        while (this->Items.empty() && !this->Closed)
+            pthread_cond_wait(&this->notEmpty, &this->mutex);
+
+        if (this->Items.empty())
+        {
+            pthread_mutex_unlock(&this->mutex);
+            return false;
+        }
+
+        item = this->Items.front();
+        this->Items.pop_front();
+
+        pthread_cond_signal(&this->notFull);
+        pthread_mutex_unlock(&this->mutex);
+
+        return true;
+    }
+
+    /**
+     * Tells the stage popping from the queue that nothing else is coming.
+    */
+    void Close()
+    {
+        pthread_mutex_lock(&this->mutex);
+
+        this->Closed = true;
+
+        pthread_cond_broadcast(&this->notEmpty);
+        pthread_mutex_unlock(&this->mutex);
+    }
+
+private:
+    std::deque<T> Items;
+    int Capacity;
+    bool Closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t notFull;
+    pthread_cond_t notEmpty;
+
+    BoundedQueue(const BoundedQueue&);
+    void operator=(const BoundedQueue&);
+};
+
+#endif
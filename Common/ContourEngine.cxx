@@ -0,0 +1,1903 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ContourEngine.cxx
+* @author Naoki Eto
+* @brief The serial, threads, mpi and hybrid backends of the contour
+*        engine, the in memory and files handoffs of their pieces, and the
+*        vtkPolyData and soa_mesh kinds of pieces.
+*/
+
+#include "ContourEngine.h"
+#include "BlockPipeline.h"
+#include "BoundedQueue.h"
+#include "ContourKernel.h"
+#include "MemoryAccounting.h"
+#include "NodeMerge.h"
+#include "PolyStreamWriter.h"
+#include "SoaMesh.h"
+#include "StageTracer.h"
+#include "ThreadPlacement.h"
+
+#include <float.h>
+#include <mpi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include <string>
+
+#include <vtkAppendPolyData.h>
+#include <vtkMultiProcessController.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkRectilinearGridReader.h>
+
+/**
+ * The tag of the messages from the workers to the parent process.
+*/
+static const int PieceTag = 301;
+
+static const char* BackendNames[] = { "serial", "threads", "mpi", "hybrid" };
+
+static const char* HandoffNames[] = { "memory", "files" };
+
+static const char* MeshNames[] = { "vtk", "soa" };
+
+static const char* WriterNames[] = { "vtk", "direct", "stream" };
+
+static const char* GatherNames[] = { "flat", "node" };
+
+// the values every block is contoured at, and measured at in analytics mode
+static const int StatsValues = 50;
+
+/**
+ * A piece of the output: a vtkPolyData with the vtk mesh, or a soa_mesh
+ * with the soa mesh, the other one being NULL, and the products of the
+ * block operators of the same blocks (NULL for those that do not run).
+*/
+typedef struct Engine_Piece
+{
+    vtkPolyData* Poly;
+    soa_mesh* Mesh;
+    vtkPolyData* Products[NUM_BLOCK_PRODUCTS];
+} engine_piece;
+
+/**
+ * One worker thread: which files it takes, and its piece once it is done
+ * (or, with the files handoff, whether its piece file was written), or in
+ * analytics mode the range of its files if Ranging, else its measures.
+*/
+typedef struct Engine_Worker
+{
+    const engine_options* Options;
+    const std::vector<std::string>* Files;
+    engine_handoff Handoff;
+    int Rank;
+    int Thread;
+    int Worker;
+    int NumWorkers;
+    const thread_placement* Placement;
+    BoundedQueue<int>* Done;
+    engine_piece Piece;
+    bool Written;
+    bool Ranging;
+    double Range[2];
+    contour_stats Stats;
+} engine_worker;
+
+/**
+ * What the sender stage of a worker process needs to send its pieces.
+*/
+typedef struct Engine_Target
+{
+    vtkMultiProcessController* Controller;
+} engine_target;
+
+/**
+ * What the block loader of a worker with the soa mesh needs: the reader
+ * that parses every file, the mesh every file is contoured into, and the
+ * stride of the blocks (1 but for a preview). In analytics mode, Mesh
+ * being NULL, the files are measured into Stats, or if Stats is NULL their
+ * range is taken into Range.
+*/
+typedef struct Engine_Loader
+{
+    vtkRectilinearGridReader* Reader;
+    grid_scalars Scalars;
+    soa_mesh* Mesh;
+    contour_stats* Stats;
+    double Range[2];
+    kernel_component Component;
+    int Stride;
+    int Blocks;
+    int NumBlocks;
+} engine_loader;
+
+void default_engine_options(engine_options& options)
+{
+    options.Backend = ENGINE_SERIAL;
+    options.Handoff = HANDOFF_MEMORY;
+    options.Mesh = MESH_VTK;
+    options.Writer = WRITER_VTK;
+    options.Component = COMPONENT_X;
+    options.Placement = PLACEMENT_NONE;
+    options.Gather = GATHER_FLAT;
+    options.Preview = 1;
+    default_block_operators(options.Operators);
+    options.Analytics = false;
+    options.Threads = 1;
+    options.Depth = 2;
+    options.LoaderDepth = loader_queue_depth();
+    options.Output = "";
+    options.TempDir = ".";
+    options.Controller = NULL;
+}
+
+/**
+ * Returns the index of name in names, or -1.
+*/
+static int find_name(const std::string& name, const char* names[], int count)
+{
+    for (int n = 0; n < count; n++)
+    {
+        if (name == names[n])
+            return n;
+    }
+
+    return -1;
+}
+
+bool parse_engine_backend(const std::string& name, engine_backend& backend)
+{
+    int found = find_name(name, BackendNames, sizeof(BackendNames) / sizeof(BackendNames[0]));
+
+    if (found >= 0)
+        backend = (engine_backend) found;
+
+    return found >= 0;
+}
+
+bool parse_engine_handoff(const std::string& name, engine_handoff& handoff)
+{
+    int found = find_name(name, HandoffNames, sizeof(HandoffNames) / sizeof(HandoffNames[0]));
+
+    if (found >= 0)
+        handoff = (engine_handoff) found;
+
+    return found >= 0;
+}
+
+bool parse_engine_mesh(const std::string& name, engine_mesh& mesh)
+{
+    int found = find_name(name, MeshNames, sizeof(MeshNames) / sizeof(MeshNames[0]));
+
+    if (found >= 0)
+        mesh = (engine_mesh) found;
+
+    return found >= 0;
+}
+
+bool parse_engine_writer(const std::string& name, engine_writer& writer)
+{
+    int found = find_name(name, WriterNames, sizeof(WriterNames) / sizeof(WriterNames[0]));
+
+    if (found >= 0)
+        writer = (engine_writer) found;
+
+    return found >= 0;
+}
+
+bool parse_engine_gather(const std::string& name, engine_gather& gather)
+{
+    int found = find_name(name, GatherNames, sizeof(GatherNames) / sizeof(GatherNames[0]));
+
+    if (found >= 0)
+        gather = (engine_gather) found;
+
+    return found >= 0;
+}
+
+const char* engine_backend_name(engine_backend backend)
+{
+    return BackendNames[backend];
+}
+
+/**
+ * Returns a piece holding nothing.
+*/
+static engine_piece no_piece()
+{
+    engine_piece piece;
+
+    piece.Poly = NULL;
+    piece.Mesh = NULL;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+        piece.Products[p] = NULL;
+
+    return piece;
+}
+
+/**
+ * Returns a new empty piece of the kind of the engine, with an empty
+ * product for every operator that runs.
+*/
+static engine_piece new_piece(const engine_options& options)
+{
+    engine_piece piece = no_piece();
+
+    piece.Poly = options.Mesh == MESH_VTK ? vtkPolyData::New() : NULL;
+    piece.Mesh = options.Mesh == MESH_SOA ? new soa_mesh : NULL;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (block_product_enabled(options.Operators, p))
+            piece.Products[p] = vtkPolyData::New();
+    }
+
+    return piece;
+}
+
+/**
+ * Lets go of a piece.
+*/
+static void free_piece(engine_piece& piece)
+{
+    if (piece.Poly != NULL)
+        piece.Poly->Delete();
+
+    delete piece.Mesh;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (piece.Products[p] != NULL)
+            piece.Products[p]->Delete();
+    }
+
+    piece = no_piece();
+}
+
+#ifdef MEMORY_ACCOUNTING
+/**
+ * Returns the bytes a piece holds.
+*/
+static unsigned long long piece_bytes(const engine_piece& piece)
+{
+    unsigned long long bytes = piece.Poly != NULL ? memory_data_bytes(piece.Poly)
+                                                  : soa_mesh_bytes(*piece.Mesh);
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (piece.Products[p] != NULL)
+            bytes += memory_data_bytes(piece.Products[p]);
+    }
+
+    return bytes;
+}
+#endif
+
+/**
+ * Returns the name of the piece file of a thread of a process, for the
+ * files handoff.
+*/
+static std::string piece_file(const engine_options& options, int rank, int thread)
+{
+    char name[64];
+
+    sprintf(name, "/engine_piece.%d.%d.%s", rank, thread,
+            options.Mesh == MESH_VTK ? "vtk" : "soa");
+
+    return options.TempDir + name;
+}
+
+/**
+ * Returns the name of the file of a product of the piece in path.
+*/
+static std::string product_file(const std::string& path, int product)
+{
+    return path + "." + block_product_name(product);
+}
+
+/**
+ * Writes a vtkPolyData to path in binary, which is smaller and faster to
+ * read back than ASCII. Returns false if it could not be written.
+*/
+static bool write_poly(vtkPolyData* poly, const std::string& path)
+{
+    vtkPolyDataWriter* writer = vtkPolyDataWriter::New();
+
+    writer->SetFileName(path.c_str());
+    writer->SetFileTypeToBinary();
+    writer->SetInput(poly);
+
+    bool written = writer->Write() == 1;
+
+    writer->Delete();
+
+    return written;
+}
+
+/**
+ * Reads a vtkPolyData written by write_poly() into poly, and removes the
+ * file.
+*/
+static void read_poly(vtkPolyData* poly, const std::string& path)
+{
+    vtkPolyDataReader* reader = vtkPolyDataReader::New();
+
+    reader->SetFileName(path.c_str());
+    reader->Update();
+
+    poly->ShallowCopy(reader->GetOutput());
+
+    reader->Delete();
+
+    remove(path.c_str());
+}
+
+/**
+ * Writes a piece to its file: a vtkPolyData in binary, a soa_mesh as its
+ * arrays are, and each of its products to a file next to it. Returns false
+ * if it could not be written.
+*/
+static bool write_piece(const engine_piece& piece, const std::string& path)
+{
+    TRACE_STAGE(write);
+
+    bool written = piece.Mesh != NULL ? save_soa_mesh(*piece.Mesh, path)
+                                      : write_poly(piece.Poly, path);
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS && written; p++)
+    {
+        if (piece.Products[p] != NULL)
+            written = write_poly(piece.Products[p], product_file(path, p));
+    }
+
+    return written;
+}
+
+/**
+ * Reads a piece back from its file, and removes the file. Returns a new
+ * piece, which the caller has to free.
+*/
+static engine_piece read_piece(const engine_options& options, const std::string& path)
+{
+    engine_piece piece = new_piece(options);
+
+    TRACE_BEGIN(read);
+
+    if (piece.Mesh != NULL)
+    {
+        load_soa_mesh(path, *piece.Mesh);
+
+        remove(path.c_str());
+    }
+    else
+    {
+        read_poly(piece.Poly, path);
+    }
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (piece.Products[p] != NULL)
+            read_poly(piece.Products[p], product_file(path, p));
+    }
+
+    TRACE_END(read);
+
+    MEMORY_RECORD(receive, piece_bytes(piece));
+
+    return piece;
+}
+
+/**
+ * Appends the pieces into one, and each of their products, and lets go of
+ * them. Returns a new piece, which the caller has to free.
+*/
+static engine_piece append_pieces(const engine_options& options,
+                                  std::vector<engine_piece>& pieces)
+{
+    if (pieces.size() == 1)
+    {
+        engine_piece only = pieces[0];
+        pieces.clear();
+        return only;
+    }
+
+    engine_piece appended = new_piece(options);
+
+    if (pieces.empty())
+        return appended;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (appended.Products[p] == NULL)
+            continue;
+
+        std::vector<vtkPolyData*> products;
+
+        for (size_t k = 0; k < pieces.size(); k++)
+        {
+            if (pieces[k].Products[p] != NULL)
+                products.push_back(pieces[k].Products[p]);
+
+            pieces[k].Products[p] = NULL;
+        }
+
+        appended.Products[p]->Delete();
+        appended.Products[p] = append_block_products(p, products);
+    }
+
+    TRACE_BEGIN(append);
+
+    if (appended.Mesh != NULL)
+    {
+        // merging is copying a few flat arrays, the ids shifted
+        for (size_t p = 0; p < pieces.size(); p++)
+        {
+            append_soa_mesh(*appended.Mesh, *pieces[p].Mesh);
+            free_piece(pieces[p]);
+        }
+    }
+    else
+    {
+        vtkAppendPolyData* append = vtkAppendPolyData::New();
+
+        for (size_t p = 0; p < pieces.size(); p++)
+        {
+            append->AddInput(pieces[p].Poly);
+            free_piece(pieces[p]);
+        }
+
+        append->Update();
+
+        appended.Poly->ShallowCopy(append->GetOutput());
+
+        append->Delete();
+    }
+
+    TRACE_END(append);
+
+    pieces.clear();
+
+    MEMORY_RECORD(append, piece_bytes(appended));
+
+    return appended;
+}
+
+/**
+ * Sender stage of a worker thread: keeps every piece, and its products,
+ * to append them.
+*/
+static void keep_piece(int fileIndex, vtkPolyData* piece,
+                       vtkPolyData* products[NUM_BLOCK_PRODUCTS], void* user)
+{
+    std::vector<engine_piece>* pieces = (std::vector<engine_piece>*) user;
+
+    engine_piece kept = no_piece();
+    kept.Poly = piece;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+        kept.Products[p] = products[p];
+
+    pieces->push_back(kept);
+}
+
+/**
+ * Sender stage of a worker process: sends every piece to the parent
+ * process as soon as its normals are done, and then its products.
+*/
+static void send_piece(int fileIndex, vtkPolyData* piece,
+                       vtkPolyData* products[NUM_BLOCK_PRODUCTS], void* user)
+{
+    engine_target* target = (engine_target*) user;
+
+    TRACE_STAGE(send);
+
+    target->Controller->Send(piece, 0, PieceTag);
+
+    MEMORY_RECORD_DATA(send, piece);
+
+    piece->Delete();
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (products[p] == NULL)
+            continue;
+
+        target->Controller->Send(products[p], 0, PieceTag);
+
+        products[p]->Delete();
+    }
+}
+
+/**
+ * Makes room in the mesh for the blocks still to come, once the first
+ * block has told how many triangles a block makes, rather than letting its
+ * arrays grow by doubling block after block.
+*/
+static void reserve_mesh(soa_mesh& mesh, int blocks, int numBlocks)
+{
+    if (blocks != 1 || numBlocks < 2)
+        return;
+
+    // a quarter more than the first block times the blocks, for the blocks
+    // cutting more of the surface than it
+    size_t points = mesh.X.size() * numBlocks / 4 * 5;
+    size_t ids = mesh.Triangles.size() * numBlocks / 4 * 5;
+
+    mesh.X.reserve(points);
+    mesh.Y.reserve(points);
+    mesh.Z.reserve(points);
+    mesh.Triangles.reserve(ids);
+    mesh.Normals.reserve(ids);
+}
+
+/**
+ * Returns the component of "grad" as load_grid_scalars takes it.
+*/
+static int grad_component(kernel_component component)
+{
+    return component == COMPONENT_MAGNITUDE ? -1 : (int) component;
+}
+
+/**
+ * Loader callback of a worker with the soa mesh: picks the scalar of the
+ * engine and its range out of the file as it parses it, and contours it
+ * (at the stride of the loader) straight into the mesh of the worker,
+ * while the loader still reads the next files. A file the kernel's reader
+ * does not know goes through vtkRectilinearGridReader instead. A file that
+ * could not be read adds nothing.
+*/
+static void contour_file(int fileIndex, const char* data, unsigned long size, void* user)
+{
+    engine_loader* loader = (engine_loader*) user;
+
+    if (data == NULL)
+        return;
+
+    MEMORY_RECORD(read, size);
+
+    if (parse_grid_scalars(data, size, grad_component(loader->Component), loader->Scalars))
+    {
+        stride_grid_scalars(loader->Scalars, loader->Stride);
+
+        contour_scalars_block(loader->Scalars, *loader->Mesh);
+    }
+    else
+    {
+        TRACE_BEGIN(parse);
+
+        loader->Reader->SetBinaryInputString(data, (int) size);
+        loader->Reader->Modified();
+        loader->Reader->Update();
+
+        TRACE_END(parse);
+
+        MEMORY_RECORD_DATA(parse, loader->Reader->GetOutput());
+
+        vtkRectilinearGrid* grid = loader->Reader->GetOutput();
+
+        vtkRectilinearGrid* strided = NULL;
+
+        if (loader->Stride > 1 && grid->GetNumberOfPoints() > 0)
+        {
+            strided = stride_block(grid, loader->Stride);
+            grid = strided;
+        }
+
+        contour_soa_block(grid, loader->Component, *loader->Mesh);
+
+        if (strided != NULL)
+            strided->Delete();
+    }
+
+    reserve_mesh(*loader->Mesh, ++loader->Blocks, loader->NumBlocks);
+}
+
+/**
+ * Sets range to the empty range, which any range widens.
+*/
+static void empty_range(double range[2])
+{
+    range[0] = DBL_MAX;
+    range[1] = -DBL_MAX;
+}
+
+/**
+ * Widens range to take in other.
+*/
+static void widen_range(double range[2], const double other[2])
+{
+    if (other[0] < range[0])
+        range[0] = other[0];
+
+    if (other[1] > range[1])
+        range[1] = other[1];
+}
+
+/**
+ * Analytics mode: measures the scalars of a block into stats, at its
+ * values, or if stats is NULL widens range to theirs.
+*/
+static void measure_scalars(const grid_scalars& scalars, double range[2], contour_stats* stats)
+{
+    if (stats != NULL)
+        measure_soa_scalars(scalars, *stats);
+    else if (!scalars.Values.empty())
+        widen_range(range, scalars.Range);
+}
+
+/**
+ * Same as measure_scalars, for the component of a grid that the kernel's
+ * reader did not know.
+*/
+static void measure_grid(vtkRectilinearGrid* grid, kernel_component component, double range[2],
+                         contour_stats* stats)
+{
+    double found[2];
+
+    if (stats != NULL)
+        measure_soa(grid, component, *stats);
+    else if (grid_component_range(grid, component, found))
+        widen_range(range, found);
+}
+
+/**
+ * Loader callback of a worker in analytics mode: picks the scalar of the
+ * engine out of the file as it parses it, and measures it or takes its
+ * range, like measure_scalars, while the loader still reads the next
+ * files. A file the kernel's reader does not know goes through
+ * vtkRectilinearGridReader instead. A file that could not be read adds
+ * nothing.
+*/
+static void measure_file(int fileIndex, const char* data, unsigned long size, void* user)
+{
+    engine_loader* loader = (engine_loader*) user;
+
+    if (data == NULL)
+        return;
+
+    MEMORY_RECORD(read, size);
+
+    if (parse_grid_scalars(data, size, grad_component(loader->Component), loader->Scalars))
+    {
+        measure_scalars(loader->Scalars, loader->Range, loader->Stats);
+        return;
+    }
+
+    TRACE_BEGIN(parse);
+
+    loader->Reader->SetBinaryInputString(data, (int) size);
+    loader->Reader->Modified();
+    loader->Reader->Update();
+
+    TRACE_END(parse);
+
+    MEMORY_RECORD_DATA(parse, loader->Reader->GetOutput());
+
+    measure_grid(loader->Reader->GetOutput(), loader->Component, loader->Range, loader->Stats);
+}
+
+/**
+ * Contours the files of worker out of numWorkers (dealt out round robin):
+ * through the pipeline with the vtk mesh, with the block loader and the
+ * contour kernel with the soa mesh. Returns their pieces appended into
+ * one, which the caller has to free.
+*/
+static engine_piece worker_piece(const engine_options& options,
+                                 const std::vector<std::string>& files, int worker, int numWorkers)
+{
+    std::vector<std::string> myFiles;
+
+    assign_blocks(files, worker, numWorkers, myFiles);
+
+    if (options.Mesh == MESH_SOA)
+    {
+        engine_piece piece = new_piece(options);
+
+        engine_loader loader;
+        loader.Reader = vtkRectilinearGridReader::New();
+        loader.Reader->ReadFromInputStringOn();
+        loader.Mesh = piece.Mesh;
+        loader.Stats = NULL;
+        loader.Component = options.Component;
+        loader.Stride = options.Preview;
+        loader.Blocks = 0;
+        loader.NumBlocks = (int) myFiles.size();
+
+        load_files(myFiles, options.LoaderDepth, contour_file, &loader, NULL);
+
+        loader.Reader->Delete();
+
+        MEMORY_RECORD(normals, piece_bytes(piece));
+
+        return piece;
+    }
+
+    std::vector<engine_piece> pieces;
+
+    run_block_pipeline_with(myFiles, options.Depth, options.LoaderDepth, options.Preview,
+                            &options.Operators, keep_piece, &pieces, NULL);
+
+    return append_pieces(options, pieces);
+}
+
+/**
+ * What the block loader of the serial backend with the vtk mesh needs:
+ * the reader that parses every file, the filters every file goes through,
+ * the operators, the stride of the blocks and the pieces contoured.
+*/
+typedef struct Serial_Loader
+{
+    vtkRectilinearGridReader* Reader;
+    block_workspace* Workspace;
+    const block_operators* Operators;
+    int Stride;
+    std::vector<engine_piece>* Pieces;
+} serial_loader;
+
+/**
+ * Loader callback of the serial backend with the vtk mesh: parses the
+ * file, applies the operators to it and contours it into a piece of its
+ * own. A file that could not be read adds nothing.
+*/
+static void serial_file(int fileIndex, const char* data, unsigned long size, void* user)
+{
+    serial_loader* loader = (serial_loader*) user;
+
+    if (data == NULL)
+        return;
+
+    vtkRectilinearGrid* grid = vtkRectilinearGrid::New();
+
+    TRACE_BEGIN(read);
+
+    loader->Reader->SetBinaryInputString(data, (int) size);
+    loader->Reader->Modified();
+    loader->Reader->Update();
+
+    grid->ShallowCopy(loader->Reader->GetOutput());
+
+    TRACE_END(read);
+
+    MEMORY_RECORD_DATA(read, grid);
+
+    if (loader->Stride > 1 && grid->GetNumberOfPoints() > 0)
+    {
+        vtkRectilinearGrid* strided = stride_block(grid, loader->Stride);
+
+        grid->Delete();
+        grid = strided;
+    }
+
+    engine_piece piece = no_piece();
+
+    apply_block_operators(*loader->Operators, grid, piece.Products);
+
+    piece.Poly = contour_block_with(loader->Workspace, grid);
+
+    loader->Pieces->push_back(piece);
+
+    grid->Delete();
+}
+
+/**
+ * The serial backend: reads, contours and computes the normals of every
+ * file in turn, in the calling thread, through the block loader one file
+ * at a time (so that a preview's kept files are not read again). Returns
+ * the pieces appended.
+*/
+static engine_piece serial_piece(const engine_options& options,
+                                 const std::vector<std::string>& files)
+{
+    vtkRectilinearGridReader* reader = vtkRectilinearGridReader::New();
+    reader->ReadFromInputStringOn();
+
+    if (options.Mesh == MESH_SOA)
+    {
+        engine_piece output = new_piece(options);
+
+        engine_loader loader;
+        loader.Reader = reader;
+        loader.Mesh = output.Mesh;
+        loader.Stats = NULL;
+        loader.Component = options.Component;
+        loader.Stride = options.Preview;
+        loader.Blocks = 0;
+        loader.NumBlocks = (int) files.size();
+
+        load_files(files, 1, contour_file, &loader, NULL);
+
+        reader->Delete();
+
+        return output;
+    }
+
+    std::vector<engine_piece> pieces;
+
+    // the same filters for every file
+    serial_loader loader;
+    loader.Reader = reader;
+    loader.Workspace = new_block_workspace();
+    loader.Operators = &options.Operators;
+    loader.Stride = options.Preview;
+    loader.Pieces = &pieces;
+
+    load_files(files, 1, serial_file, &loader, NULL);
+
+    delete_block_workspace(loader.Workspace);
+
+    reader->Delete();
+
+    return append_pieces(options, pieces);
+}
+
+/**
+ * Analytics mode with the block loader: measures the files of worker out
+ * of numWorkers (dealt out round robin) into stats, at its values, or if
+ * stats is NULL widens range to the range of those files. Nothing is
+ * contoured into a mesh, whatever the mesh.
+*/
+static void worker_analytics(const engine_options& options, const std::vector<std::string>& files,
+                             int worker, int numWorkers, double range[2], contour_stats* stats)
+{
+    std::vector<std::string> myFiles;
+
+    assign_blocks(files, worker, numWorkers, myFiles);
+
+    engine_loader loader;
+    loader.Reader = vtkRectilinearGridReader::New();
+    loader.Reader->ReadFromInputStringOn();
+    loader.Mesh = NULL;
+    loader.Stats = stats;
+    empty_range(loader.Range);
+    loader.Component = options.Component;
+    loader.Stride = 1;
+    loader.Blocks = 0;
+    loader.NumBlocks = (int) myFiles.size();
+
+    load_files(myFiles, options.LoaderDepth, measure_file, &loader, NULL);
+
+    loader.Reader->Delete();
+
+    widen_range(range, loader.Range);
+}
+
+/**
+ * The serial backend in analytics mode: measures every file in turn, in
+ * the calling thread, like worker_analytics.
+*/
+static void serial_analytics(const engine_options& options, const std::vector<std::string>& files,
+                             double range[2], contour_stats* stats)
+{
+    vtkRectilinearGridReader* reader = vtkRectilinearGridReader::New();
+
+    grid_scalars scalars;
+
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        if (load_grid_scalars(files[f].c_str(), grad_component(options.Component), scalars))
+        {
+            measure_scalars(scalars, range, stats);
+            continue;
+        }
+
+        TRACE_BEGIN(read);
+
+        reader->SetFileName(files[f].c_str());
+        reader->Update();
+
+        TRACE_END(read);
+
+        MEMORY_RECORD_DATA(read, reader->GetOutput());
+
+        measure_grid(reader->GetOutput(), options.Component, range, stats);
+    }
+
+    reader->Delete();
+}
+
+/**
+ * Writes the output, with the vtk writer (a soa_mesh being turned into a
+ * vtkPolyData first), or a soa_mesh straight from its arrays with the
+ * direct writer. With the soa mesh, the meshes of the views go before it,
+ * read from where they are. Returns its number of triangles, or -1 if it
+ * could not be written.
+*/
+static long long write_output(const engine_options& options, engine_piece& output,
+                              const std::vector<soa_view>& views)
+{
+    TRACE_STAGE(write);
+
+    std::vector<soa_view> meshes(views);
+    long long numTriangles = 0;
+
+    if (output.Mesh != NULL)
+    {
+        meshes.push_back(soa_mesh_view(*output.Mesh));
+
+        for (size_t v = 0; v < meshes.size(); v++)
+            numTriangles += meshes[v].NumTriangles;
+    }
+
+    if (output.Mesh != NULL && options.Writer == WRITER_DIRECT)
+        return write_soa_views(meshes, options.Output) ? numTriangles : -1;
+
+    vtkPolyData* polydata = output.Poly;
+
+    if (output.Mesh != NULL)
+        polydata = soa_views_to_polydata(meshes);
+
+    vtkPolyDataWriter* writer = vtkPolyDataWriter::New();
+
+    writer->SetFileName(options.Output.c_str());
+    writer->SetInput(polydata);
+
+    bool written = writer->Write() == 1;
+
+    writer->Delete();
+
+    long long triangles = (long long) polydata->GetNumberOfPolys();
+
+    if (polydata != output.Poly)
+        polydata->Delete();
+
+    return written ? triangles : -1;
+}
+
+/**
+ * Where the pieces of the workers go as they come in: kept, to be appended
+ * and written once they are all in, or, streamed, written to the output
+ * right away (see PolyStreamWriter.h), so the output is written while the
+ * other workers are still contouring rather than after; their products are
+ * then kept in Products until the end. Views are soa meshes kept where
+ * they are (a shared memory window), written from there before the kept
+ * pieces, never copied into a piece.
+*/
+typedef struct Engine_Output
+{
+    const engine_options* Options;
+    std::vector<engine_piece> Pieces;
+    std::vector<soa_view> Views;
+    std::vector<vtkPolyData*> Products[NUM_BLOCK_PRODUCTS];
+    poly_stream* Stream;
+    bool Streamed;
+} engine_output;
+
+/**
+ * Starts an output that keeps the pieces, or streams them to options.Output
+ * with the stream writer if stream is true.
+*/
+static void open_output(const engine_options& options, bool stream, engine_output& output)
+{
+    output.Options = &options;
+    output.Streamed = stream && options.Writer == WRITER_STREAM;
+    output.Stream = output.Streamed ? poly_stream_open(options.Output.c_str()) : NULL;
+}
+
+/**
+ * Keeps the piece, or writes it to the output and lets go of it but for
+ * its products.
+*/
+static void add_output_piece(engine_output& output, engine_piece piece)
+{
+    if (!output.Streamed)
+    {
+        output.Pieces.push_back(piece);
+        return;
+    }
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (piece.Products[p] != NULL)
+            output.Products[p].push_back(piece.Products[p]);
+
+        piece.Products[p] = NULL;
+    }
+
+    if (output.Stream != NULL)
+    {
+        TRACE_STAGE(write);
+
+        if (piece.Mesh != NULL)
+            poly_stream_append_mesh(output.Stream, *piece.Mesh);
+        else
+            poly_stream_append(output.Stream, piece.Poly);
+
+        MEMORY_RECORD(write, piece_bytes(piece));
+    }
+
+    free_piece(piece);
+}
+
+/**
+ * Keeps the view, or writes its mesh to the output. Its arrays have to
+ * stay where they are until the output is finished.
+*/
+static void add_output_view(engine_output& output, const soa_view& view)
+{
+    if (!output.Streamed)
+    {
+        output.Views.push_back(view);
+        return;
+    }
+
+    if (output.Stream != NULL)
+    {
+        TRACE_STAGE(write);
+
+        poly_stream_append_view(output.Stream, view);
+    }
+}
+
+/**
+ * Finishes the output: the kept pieces appended into one, or the streamed
+ * output with its final counts. Returns the kept pieces appended, which
+ * the caller has to free (once streamed, only their products).
+*/
+static engine_piece close_output(engine_output& output, long long& triangles)
+{
+    if (!output.Streamed)
+        return append_pieces(*output.Options, output.Pieces);
+
+    engine_piece empty = no_piece();
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (block_product_enabled(output.Options->Operators, p))
+            empty.Products[p] = append_block_products(p, output.Products[p]);
+    }
+
+    triangles = -1;
+
+    if (output.Stream != NULL)
+    {
+        TRACE_STAGE(write);
+
+        long long numPolys = output.Stream->NumPolys;
+
+        if (poly_stream_close(output.Stream))
+            triangles = numPolys;
+    }
+
+    return empty;
+}
+
+/**
+ * Writes every product of the output to its file next to the output.
+ * Returns false if one could not be written.
+*/
+static bool write_products(const engine_options& options, const engine_piece& output)
+{
+    bool written = true;
+
+    for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (output.Products[p] == NULL)
+            continue;
+
+        std::string path = block_product_path(options.Output, p);
+
+        if (!write_block_product(p, output.Products[p], path))
+        {
+            fprintf(stderr, "Could not write the %s to %s\n", block_product_name(p),
+                    path.c_str());
+            written = false;
+        }
+    }
+
+    return written;
+}
+
+/**
+ * Finishes the output and writes it, if it was not streamed, and its
+ * products. Returns its number of triangles, or -1 if it or a product
+ * could not be written.
+*/
+static long long finish_output(engine_output& output)
+{
+    long long triangles = -1;
+
+    engine_piece appended = close_output(output, triangles);
+
+    if (!output.Streamed)
+        triangles = write_output(*output.Options, appended, output.Views);
+
+    if (!write_products(*output.Options, appended))
+        triangles = -1;
+
+    free_piece(appended);
+
+    return triangles;
+}
+
+/**
+ * A worker thread: goes to its cpus, contours its files, and keeps its
+ * piece or, with the files handoff, writes it to its piece file. The
+ * buffers, grids and pieces of its files are all first touched here, so
+ * on its NUMA node.
+*/
+static void* worker_thread(void* ptr)
+{
+    engine_worker* worker = (engine_worker*) ptr;
+
+    std::vector<int> cpus;
+
+    int numThreads = worker->Options->Threads > 0 ? worker->Options->Threads : 1;
+
+    placement_thread_cpus(*worker->Placement, worker->Thread, numThreads, cpus);
+
+    pin_calling_thread(cpus);
+
+    if (worker->Options->Analytics)
+    {
+        worker_analytics(*worker->Options, *worker->Files, worker->Worker, worker->NumWorkers,
+                         worker->Range, worker->Ranging ? NULL : &worker->Stats);
+    }
+    else
+    {
+        worker->Piece = worker_piece(*worker->Options, *worker->Files, worker->Worker,
+                                     worker->NumWorkers);
+
+        if (worker->Handoff == HANDOFF_FILES)
+        {
+            worker->Written = write_piece(worker->Piece,
+                                          piece_file(*worker->Options, worker->Rank,
+                                                     worker->Thread));
+
+            free_piece(worker->Piece);
+        }
+    }
+
+    if (worker->Done != NULL)
+        worker->Done->Push(worker->Thread);
+
+    return NULL;
+}
+
+/**
+ * Runs options.Threads worker threads in this process, placed on their
+ * cpus, as workers firstWorker, firstWorker + 1, ... out of numWorkers,
+ * and hands their pieces to the calling thread with the handoff, which
+ * puts them in the output: in the order of the threads, or, if the output
+ * is streamed, as each thread is done.
+*/
+static void run_worker_threads(const engine_options& options, const thread_placement& placement,
+                               const std::vector<std::string>& files, int rank,
+                               int firstWorker, int numWorkers, engine_handoff handoff,
+                               engine_output& output)
+{
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    std::vector<engine_worker> workers(numThreads);
+    std::vector<pthread_t> threads(numThreads);
+
+    BoundedQueue<int> done(numThreads);
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        workers[t].Options = &options;
+        workers[t].Files = &files;
+        workers[t].Handoff = handoff;
+        workers[t].Rank = rank;
+        workers[t].Thread = t;
+        workers[t].Worker = firstWorker + t;
+        workers[t].NumWorkers = numWorkers;
+        workers[t].Placement = &placement;
+        workers[t].Done = output.Streamed ? &done : NULL;
+        workers[t].Piece = no_piece();
+        workers[t].Written = false;
+
+        pthread_create(&threads[t], NULL, worker_thread, (void*) &workers[t]);
+    }
+
+    for (int n = 0; n < numThreads; n++)
+    {
+        int t = n;
+
+        if (output.Streamed)
+            done.Pop(t);
+
+        pthread_join(threads[t], NULL);
+
+        if (workers[t].Piece.Poly != NULL || workers[t].Piece.Mesh != NULL)
+            add_output_piece(output, workers[t].Piece);
+        else if (workers[t].Written)
+            add_output_piece(output, read_piece(options, piece_file(options, rank, t)));
+    }
+}
+
+/**
+ * Runs the worker threads of a process like run_worker_threads(), and
+ * returns their pieces appended, which the caller has to free.
+*/
+static engine_piece threads_piece(const engine_options& options,
+                                  const thread_placement& placement,
+                                  const std::vector<std::string>& files, int rank,
+                                  int firstWorker, int numWorkers, engine_handoff handoff)
+{
+    engine_output output;
+
+    open_output(options, false, output);
+
+    run_worker_threads(options, placement, files, rank, firstWorker, numWorkers, handoff,
+                       output);
+
+    long long triangles;
+
+    return close_output(output, triangles);
+}
+
+/**
+ * Runs options.Threads worker threads in this process that measure their
+ * files, like run_worker_threads(), and adds up their stats into stats as
+ * they are joined, or if stats is NULL widens range to the ranges of
+ * their files.
+*/
+static void threads_analytics(const engine_options& options, const thread_placement& placement,
+                              const std::vector<std::string>& files, int rank, int firstWorker,
+                              int numWorkers, double range[2], contour_stats* stats)
+{
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    std::vector<engine_worker> workers(numThreads);
+    std::vector<pthread_t> threads(numThreads);
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        workers[t].Options = &options;
+        workers[t].Files = &files;
+        workers[t].Handoff = HANDOFF_MEMORY;
+        workers[t].Rank = rank;
+        workers[t].Thread = t;
+        workers[t].Worker = firstWorker + t;
+        workers[t].NumWorkers = numWorkers;
+        workers[t].Placement = &placement;
+        workers[t].Done = NULL;
+        workers[t].Piece = no_piece();
+        workers[t].Written = false;
+        workers[t].Ranging = stats == NULL;
+
+        empty_range(workers[t].Range);
+
+        if (stats != NULL)
+            init_contour_stats(workers[t].Stats, (int) stats->Values.size(), stats->Range);
+
+        pthread_create(&threads[t], NULL, worker_thread, (void*) &workers[t]);
+    }
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        pthread_join(threads[t], NULL);
+
+        if (stats != NULL)
+            add_contour_stats(*stats, workers[t].Stats);
+        else
+            widen_range(range, workers[t].Range);
+    }
+}
+
+/**
+ * Hands the piece of a worker process to the parent process: sends it and
+ * its products, or writes them to their files and sends whether they were
+ * written. Lets go of the piece.
+*/
+static void hand_to_parent(const engine_options& options, engine_piece& piece, int rank)
+{
+    if (options.Handoff == HANDOFF_MEMORY)
+    {
+        TRACE_BEGIN(send);
+
+        if (piece.Mesh != NULL)
+            send_soa_mesh(options.Controller, *piece.Mesh, 0, PieceTag);
+        else
+            options.Controller->Send(piece.Poly, 0, PieceTag);
+
+        for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+        {
+            if (piece.Products[p] != NULL)
+                options.Controller->Send(piece.Products[p], 0, PieceTag);
+        }
+
+        TRACE_END(send);
+
+        MEMORY_RECORD(send, piece_bytes(piece));
+    }
+    else
+    {
+        int written = write_piece(piece, piece_file(options, rank, 0)) ? 1 : 0;
+
+        TRACE_BEGIN(send);
+
+        options.Controller->Send(&written, 1, 0, PieceTag);
+
+        TRACE_END(send);
+    }
+
+    free_piece(piece);
+}
+
+/**
+ * Takes the next piece of a worker process in the parent process, the
+ * other end of hand_to_parent() and send_piece(). Returns a new piece,
+ * empty if the worker could not write its piece file.
+*/
+static engine_piece take_from_worker(const engine_options& options, int rank)
+{
+    if (options.Handoff == HANDOFF_MEMORY)
+    {
+        engine_piece piece = new_piece(options);
+
+        TRACE_BEGIN(receive);
+
+        if (piece.Mesh != NULL)
+            receive_soa_mesh(options.Controller, *piece.Mesh, rank, PieceTag);
+        else
+            options.Controller->Receive(piece.Poly, rank, PieceTag);
+
+        // the products come from the same worker right after its piece
+        for (int p = 0; p < NUM_BLOCK_PRODUCTS; p++)
+        {
+            if (piece.Products[p] != NULL)
+                options.Controller->Receive(piece.Products[p], rank, PieceTag);
+        }
+
+        TRACE_END(receive);
+
+        MEMORY_RECORD(receive, piece_bytes(piece));
+
+        return piece;
+    }
+
+    int written = 0;
+
+    TRACE_BEGIN(receive);
+
+    options.Controller->Receive(&written, 1, rank, PieceTag);
+
+    TRACE_END(receive);
+
+    return written ? read_piece(options, piece_file(options, rank, 0)) : new_piece(options);
+}
+
+/**
+ * Plans where this process and its numThreads worker threads run with the
+ * placement of the options, pins the process to its share of the cpus,
+ * and prints it. With shared, the cpus of a machine are shared between the
+ * processes of the controller on it, which all have to call this.
+*/
+static void place_engine(const engine_options& options, int rank, int numThreads, bool shared,
+                         thread_placement& placement)
+{
+    cpu_topology topology;
+    std::vector<int> cpus;
+
+    int localRank = 0;
+    int localSize = 1;
+
+    if (options.Placement != PLACEMENT_NONE)
+    {
+        allowed_cpus(cpus);
+
+        if (shared)
+        {
+            MPI_Comm machine = split_machine(MPI_COMM_WORLD);
+
+            MPI_Comm_rank(machine, &localRank);
+            MPI_Comm_size(machine, &localSize);
+
+            // the cpus of every process of the machine, which the launcher
+            // may have bound each to cpus of its own
+            std::vector<int> mine(CPU_SETSIZE, 0);
+            std::vector<int> all(CPU_SETSIZE, 0);
+
+            for (size_t c = 0; c < cpus.size(); c++)
+                mine[cpus[c]] = 1;
+
+            MPI_Allreduce(&mine[0], &all[0], CPU_SETSIZE, MPI_INT, MPI_MAX, machine);
+            MPI_Comm_free(&machine);
+
+            cpus.clear();
+
+            for (int c = 0; c < CPU_SETSIZE; c++)
+            {
+                if (all[c])
+                    cpus.push_back(c);
+            }
+        }
+
+        read_cpu_topology(cpus, topology);
+    }
+
+    plan_placement(topology, options.Placement, localRank, localSize, placement);
+
+    if (options.Placement == PLACEMENT_NONE)
+        return;
+
+    if (!place_process(placement))
+        fprintf(stderr, "Rank %d could not be pinned to its cpus\n", rank);
+
+    print_placement(rank, placement, numThreads);
+}
+
+/**
+ * Waits for the next piece of a worker process and returns who sent it
+ * (the world communicator of vtkMPIController being MPI_COMM_WORLD). The
+ * messages of a process come in order, so its first one waiting is the
+ * start of its next piece.
+*/
+static int next_sender()
+{
+    MPI_Status status;
+
+    MPI_Probe(MPI_ANY_SOURCE, PieceTag, MPI_COMM_WORLD, &status);
+
+    return status.MPI_SOURCE;
+}
+
+/**
+ * The mpi and hybrid backends with the node gather, in every process: the
+ * pieces of the processes of a machine are merged in a shared memory
+ * window (see NodeMerge.h), and the leader of every machine but the one of
+ * the parent sends the merged piece to the parent, which writes the
+ * output, with the merged piece of its own machine read straight from the
+ * window. Only for the soa mesh in memory.
+*/
+static long long gather_by_node(const engine_options& options, const thread_placement& placement,
+                                const std::vector<std::string>& files, int rank, int children)
+{
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    engine_piece piece;
+
+    if (rank == 0)
+        piece = new_piece(options);
+    else if (options.Backend == ENGINE_HYBRID)
+        piece = threads_piece(options, placement, files, rank, (rank - 1) * numThreads,
+                              children * numThreads, HANDOFF_MEMORY);
+    else
+        piece = worker_piece(options, files, rank - 1, children);
+
+    MPI_Comm machine = split_machine(MPI_COMM_WORLD);
+
+    int localRank;
+
+    MPI_Comm_rank(machine, &localRank);
+
+    node_mesh merged;
+
+    TRACE_BEGIN(append);
+
+    merge_on_node(machine, *piece.Mesh, merged);
+
+    TRACE_END(append);
+
+    free_piece(piece);
+
+    // which processes lead a machine other than the parent's
+    int leader = localRank == 0 && rank != 0 ? 1 : 0;
+    std::vector<int> leaders(rank == 0 ? children + 1 : 1);
+
+    MPI_Gather(&leader, 1, MPI_INT, &leaders[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank != 0)
+    {
+        if (leader)
+        {
+            TRACE_BEGIN(send);
+
+            send_soa_view(options.Controller, node_mesh_view(merged), 0, PieceTag);
+
+            TRACE_END(send);
+
+            MEMORY_RECORD(send, (unsigned long long) (3 * merged.NumPoints +
+                                                      6 * merged.NumTriangles) * sizeof(float));
+        }
+
+        free_node_mesh(merged);
+
+        MPI_Comm_free(&machine);
+
+        return 0;
+    }
+
+    engine_output output;
+
+    open_output(options, true, output);
+
+    // the pieces of the machine of the parent, already merged, written
+    // from the window, which the other processes of the machine keep until
+    // the output is finished
+    add_output_view(output, node_mesh_view(merged));
+
+    // streamed, the merged pieces in the order they come
+    for (int k = 1; k <= children; k++)
+    {
+        if (leaders[k])
+            add_output_piece(output, take_from_worker(options,
+                                                      output.Streamed ? next_sender() : k));
+    }
+
+    long long triangles = finish_output(output);
+
+    free_node_mesh(merged);
+
+    MPI_Comm_free(&machine);
+
+    return triangles;
+}
+
+/**
+ * The mpi and hybrid backends, in every process.
+*/
+static long long run_processes(const engine_options& options,
+                               const std::vector<std::string>& files)
+{
+    vtkMultiProcessController* controller = options.Controller;
+
+    if (controller == NULL || controller->GetNumberOfProcesses() < 2)
+    {
+        fprintf(stderr, "The %s backend needs at least 2 MPI processes\n",
+                engine_backend_name(options.Backend));
+        return -1;
+    }
+
+    int rank = controller->GetLocalProcessId();
+    int children = controller->GetNumberOfProcesses() - 1;
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    bool hybrid = options.Backend == ENGINE_HYBRID;
+
+    thread_placement placement;
+
+    place_engine(options, rank, hybrid && rank != 0 ? numThreads : 0, true, placement);
+
+    // a worker process of the mpi backend sends every vtkPolyData piece as
+    // it is done, unless the pieces go through files; a soa_mesh is sent
+    // once, whole
+    bool streamed = !hybrid && options.Handoff == HANDOFF_MEMORY && options.Mesh == MESH_VTK;
+
+    if (options.Gather == GATHER_NODE && options.Mesh == MESH_SOA &&
+        options.Handoff == HANDOFF_MEMORY)
+        return gather_by_node(options, placement, files, rank, children);
+
+    if (rank != 0)
+    {
+        if (hybrid)
+        {
+            engine_piece piece = threads_piece(options, placement, files, rank,
+                                               (rank - 1) * numThreads,
+                                               children * numThreads, HANDOFF_MEMORY);
+
+            hand_to_parent(options, piece, rank);
+        }
+        else if (streamed)
+        {
+            std::vector<std::string> myFiles;
+
+            assign_blocks(files, rank - 1, children, myFiles);
+
+            engine_target target;
+            target.Controller = controller;
+
+            run_block_pipeline_with(myFiles, options.Depth, options.LoaderDepth,
+                                    options.Preview, &options.Operators, send_piece, &target,
+                                    NULL);
+        }
+        else
+        {
+            engine_piece piece = worker_piece(options, files, rank - 1, children);
+
+            hand_to_parent(options, piece, rank);
+        }
+
+        return 0;
+    }
+
+    engine_output output;
+
+    open_output(options, true, output);
+
+    std::vector<int> counts(children + 1, 1);
+
+    for (int k = 1; k <= children && streamed; k++)
+    {
+        std::vector<std::string> childFiles;
+
+        assign_blocks(files, k - 1, children, childFiles);
+
+        counts[k] = (int) childFiles.size();
+    }
+
+    // streamed, the pieces in the order they come, each one written while
+    // the workers still at it go on
+    for (int k = 1; k <= children; k++)
+    {
+        for (int n = 0; n < counts[k]; n++)
+            add_output_piece(output, take_from_worker(options,
+                                                      output.Streamed ? next_sender() : k));
+    }
+
+    return finish_output(output);
+}
+
+/**
+ * Writes stats to options.Output as text, a line per contour value: the
+ * value, and its triangles, area and enclosed volume. Returns the
+ * triangles, or -1 if it could not be written.
+*/
+static long long write_stats(const engine_options& options, const contour_stats& stats)
+{
+    TRACE_STAGE(write);
+
+    FILE* file = fopen(options.Output.c_str(), "w");
+
+    if (file == NULL)
+        return -1;
+
+    fprintf(file, "# value triangles area volume, at %d values over the range %.9g %.9g of "
+                  "all the blocks\n", (int) stats.Values.size(), stats.Range[0], stats.Range[1]);
+
+    for (size_t v = 0; v < stats.Values.size(); v++)
+        fprintf(file, "%.9g %lld %.9g %.9g\n", stats.Values[v], stats.Triangles[v],
+                stats.Area[v], stats.Volume[v]);
+
+    if (fclose(file) != 0)
+        return -1;
+
+    return contour_stats_triangles(stats);
+}
+
+/**
+ * Sets stats to the values every block is measured at: StatsValues values
+ * over range, the range of all the blocks (0 0 if there were none).
+*/
+static void init_engine_stats(contour_stats& stats, const double range[2])
+{
+    double values[2] = { range[0], range[1] };
+
+    if (values[0] > values[1])
+        values[0] = values[1] = 0.0;
+
+    init_contour_stats(stats, StatsValues, values);
+}
+
+/**
+ * Analytics mode: measures the files with the backend rather than
+ * contouring them, in two passes. The first one finds the range of all
+ * the blocks: every worker thread takes in the range of its files, the
+ * threads of a process are widened to one as they are joined, and the
+ * processes with MPI_Allreduce. The second one measures every block at
+ * the same values over that range: every worker thread measures its files
+ * into stats of its own, the threads of a process are added up as they
+ * are joined, and the processes with MPI_Reduce to the parent, which
+ * writes them with write_stats(). No piece is made, sent or written.
+*/
+static long long run_analytics(const engine_options& options,
+                               const std::vector<std::string>& files)
+{
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    double range[2];
+
+    empty_range(range);
+
+    contour_stats stats;
+
+    if (options.Backend != ENGINE_MPI && options.Backend != ENGINE_HYBRID)
+    {
+        thread_placement placement;
+
+        place_engine(options, 0, options.Backend == ENGINE_THREADS ? numThreads : 0, false,
+                     placement);
+
+        if (options.Backend == ENGINE_THREADS)
+            threads_analytics(options, placement, files, 0, 0, numThreads, range, NULL);
+        else
+            serial_analytics(options, files, range, NULL);
+
+        init_engine_stats(stats, range);
+
+        if (options.Backend == ENGINE_THREADS)
+            threads_analytics(options, placement, files, 0, 0, numThreads, range, &stats);
+        else
+            serial_analytics(options, files, range, &stats);
+
+        return write_stats(options, stats);
+    }
+
+    vtkMultiProcessController* controller = options.Controller;
+
+    if (controller == NULL || controller->GetNumberOfProcesses() < 2)
+    {
+        fprintf(stderr, "The %s backend needs at least 2 MPI processes\n",
+                engine_backend_name(options.Backend));
+        return -1;
+    }
+
+    int rank = controller->GetLocalProcessId();
+    int children = controller->GetNumberOfProcesses() - 1;
+
+    bool hybrid = options.Backend == ENGINE_HYBRID;
+
+    thread_placement placement;
+
+    place_engine(options, rank, hybrid && rank != 0 ? numThreads : 0, true, placement);
+
+    // the parent adds nothing of its own, to the range or to the stats
+    double mine[2];
+
+    empty_range(mine);
+
+    if (rank != 0 && hybrid)
+        threads_analytics(options, placement, files, rank, (rank - 1) * numThreads,
+                          children * numThreads, mine, NULL);
+    else if (rank != 0)
+        worker_analytics(options, files, rank - 1, children, mine, NULL);
+
+    {
+        TRACE_STAGE(reduce);
+
+        MPI_Allreduce(&mine[0], &range[0], 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+        MPI_Allreduce(&mine[1], &range[1], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+
+    init_engine_stats(stats, range);
+
+    contour_stats measured;
+
+    init_engine_stats(measured, range);
+
+    if (rank != 0 && hybrid)
+        threads_analytics(options, placement, files, rank, (rank - 1) * numThreads,
+                          children * numThreads, range, &measured);
+    else if (rank != 0)
+        worker_analytics(options, files, rank - 1, children, range, &measured);
+
+    {
+        TRACE_STAGE(reduce);
+
+        MPI_Reduce(&measured.Triangles[0], &stats.Triangles[0], StatsValues, MPI_LONG_LONG,
+                   MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&measured.Area[0], &stats.Area[0], StatsValues, MPI_DOUBLE, MPI_SUM, 0,
+                   MPI_COMM_WORLD);
+        MPI_Reduce(&measured.Volume[0], &stats.Volume[0], StatsValues, MPI_DOUBLE, MPI_SUM, 0,
+                   MPI_COMM_WORLD);
+    }
+
+    if (rank != 0)
+        return 0;
+
+    return write_stats(options, stats);
+}
+
+/**
+ * Contours the files once, at the stride of options.Preview, with the
+ * backend, and writes the output.
+*/
+static long long run_pass(const engine_options& options, const std::vector<std::string>& files)
+{
+    if (options.Analytics)
+        return run_analytics(options, files);
+
+    if (options.Backend == ENGINE_MPI || options.Backend == ENGINE_HYBRID)
+        return run_processes(options, files);
+
+    int numThreads = options.Threads > 0 ? options.Threads : 1;
+
+    thread_placement placement;
+
+    place_engine(options, 0, options.Backend == ENGINE_THREADS ? numThreads : 0, false,
+                 placement);
+
+    engine_output output;
+
+    open_output(options, true, output);
+
+    if (options.Backend == ENGINE_THREADS)
+        run_worker_threads(options, placement, files, 0, 0, numThreads, options.Handoff, output);
+    else
+        add_output_piece(output, serial_piece(options, files));
+
+    return finish_output(output);
+}
+
+long long run_contour_engine(const engine_options& options,
+                             const std::vector<std::string>& files)
+{
+    if (options.Preview <= 1)
+        return run_pass(options, files);
+
+    // the serial and threads backends only run in the first process
+    bool writer = options.Controller == NULL || options.Controller->GetLocalProcessId() == 0;
+
+    double start = MPI_Wtime();
+
+    long long previewed;
+
+    // every process keeps the files it reads for the preview, for the full
+    // resolution to parse them from memory rather than read them again
+    keep_loaded_files(true);
+
+    {
+        TRACE_STAGE(preview);
+
+        previewed = run_pass(options, files);
+    }
+
+    keep_loaded_files(false);
+
+    MEMORY_RECORD(kept, kept_file_bytes());
+
+    if (writer && previewed >= 0)
+    {
+        printf("The preview at a stride of %d made %lld triangles, written after %f s\n",
+               options.Preview, previewed, MPI_Wtime() - start);
+        fflush(stdout);
+    }
+
+    // every process goes on to the full resolution even if the preview
+    // could not be written, so that none of them waits for the others
+    engine_options refined = options;
+    refined.Preview = 1;
+    refined.Output = options.Output + ".refining";
+
+    long long triangles;
+
+    {
+        TRACE_STAGE(refine);
+
+        triangles = run_pass(refined, files);
+    }
+
+    // the files the full resolution did not load, had it dealt them out
+    // differently
+    forget_loaded_files();
+
+    if (!writer)
+        return triangles;
+
+    // the full resolution output and its products take the place of the
+    // preview at once, so each file is always one or the other whole
+    for (int p = -1; p < NUM_BLOCK_PRODUCTS; p++)
+    {
+        if (p >= 0 && !block_product_enabled(options.Operators, p))
+            continue;
+
+        std::string from = p < 0 ? refined.Output : block_product_path(refined.Output, p);
+        std::string to = p < 0 ? options.Output : block_product_path(options.Output, p);
+
+        if (triangles < 0)
+        {
+            remove(from.c_str());
+        }
+        else if (rename(from.c_str(), to.c_str()) != 0)
+        {
+            fprintf(stderr, "Could not replace the preview %s with %s\n", to.c_str(),
+                    from.c_str());
+            triangles = -1;
+        }
+    }
+
+    return triangles;
+}
@@ -0,0 +1,235 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ContourEngine.h
+* @author Naoki Eto
+* @brief The contour engine: the read, contour, normals and append work of
+*        the variants, once, with the way it is run in parallel chosen at
+*        run time. The same block pipeline (see BlockPipeline.h) does the
+*        work of every worker whatever the backend, so a change to it
+*        shows up in every backend, and the backends can be compared on
+*        the same work:
+*
+*        serial   every file in turn in the calling thread, with no pipeline
+*                 threads (the baseline)
+*        threads  a number of worker threads, each running the pipeline on
+*                 its share of the files
+*        mpi      every process but the parent is a worker running the
+*                 pipeline, the parent gathers
+*        hybrid   every process but the parent runs a number of worker
+*                 threads, the parent gathers
+*
+*        The pieces of the workers go to the one that writes the output in
+*        memory (sent with the controller, or handed between threads), or
+*        through temporary files, like the files variants.
+*
+*        The pieces are vtkPolyData made by vtkContourFilter and
+*        vtkPolyDataNormals (the vtk mesh), or soa_mesh made by the contour
+*        kernel (the soa mesh, see SoaMesh.h and ContourKernel.h), which
+*        stay soa_mesh through merging and sending and are only turned into
+*        a vtkPolyData if the output is written with the vtk writer.
+*
+*        With the vtk mesh, the block operators (see BlockOperators.h) can
+*        run on every block while it is loaded for the contour; their
+*        products go along with the contoured pieces to the one writing the
+*        output, which writes each of them to a file of its own.
+*
+*        In analytics mode the blocks are only measured by the contour
+*        kernel, at the same values over the range of all of them (found
+*        first with MPI_Allreduce), and what the workers measured is added
+*        up with MPI_Reduce rather than their meshes being gathered.
+*/
+
+#ifndef CONTOURENGINE_H
+#define CONTOURENGINE_H
+
+#include <string>
+#include <vector>
+
+#include "BlockOperators.h"
+#include "ContourKernel.h"
+#include "ThreadPlacement.h"
+
+class vtkMultiProcessController;
+
+/**
+ * How the work is run in parallel.
+*/
+typedef enum Engine_Backend
+{
+    ENGINE_SERIAL,
+    ENGINE_THREADS,
+    ENGINE_MPI,
+    ENGINE_HYBRID
+} engine_backend;
+
+/**
+ * How the pieces go from the workers to the one that writes the output.
+*/
+typedef enum Engine_Handoff
+{
+    HANDOFF_MEMORY,
+    HANDOFF_FILES
+} engine_handoff;
+
+/**
+ * What the pieces are made of.
+*/
+typedef enum Engine_Mesh
+{
+    MESH_VTK,
+    MESH_SOA
+} engine_mesh;
+
+/**
+ * How the pieces of the processes get to the parent with the mpi and
+ * hybrid backends: every process sends its own, or the processes of a
+ * machine merge theirs in shared memory first and only one of them sends
+ * (the soa mesh in memory only, see NodeMerge.h).
+*/
+typedef enum Engine_Gather
+{
+    GATHER_FLAT,
+    GATHER_NODE
+} engine_gather;
+
+/**
+ * How the output is written: by vtkPolyDataWriter (ASCII), or, for the soa
+ * mesh, as a binary vtk file straight from its arrays, once every piece is
+ * in; or streamed, every piece written as a binary vtk file as soon as it
+ * comes in, the counts being put in once the last one has (see
+ * PolyStreamWriter.h).
+*/
+typedef enum Engine_Writer
+{
+    WRITER_VTK,
+    WRITER_DIRECT,
+    WRITER_STREAM
+} engine_writer;
+
+/**
+ * How to run the engine. Controller is needed by the mpi and hybrid
+ * backends, and Threads by the threads and hybrid ones (worker threads per
+ * process). Component is what the soa mesh contours of "grad" (the vtk mesh
+ * always contours x), Placement how the processes and worker threads are
+ * pinned to cpus and NUMA nodes (see ThreadPlacement.h), and Gather how the
+ * pieces of the processes go to the parent. Preview, if more than 1, is the
+ * stride of a coarse preview written before the full resolution output (see
+ * run_contour_engine()), and Operators what else is made of every block
+ * besides the contour (the vtk mesh only). With Analytics the contour is
+ * only measured (see run_contour_engine()). Depth is how many files may wait
+ * between two stages of the pipeline, LoaderDepth how many files the reader
+ * stage reads at once, and TempDir where the pieces go with the files
+ * handoff.
+*/
+typedef struct Engine_Options
+{
+    engine_backend Backend;
+    engine_handoff Handoff;
+    engine_mesh Mesh;
+    engine_writer Writer;
+    kernel_component Component;
+    placement_mode Placement;
+    engine_gather Gather;
+    int Preview;
+    block_operators Operators;
+    bool Analytics;
+    int Threads;
+    int Depth;
+    int LoaderDepth;
+    std::string Output;
+    std::string TempDir;
+    vtkMultiProcessController* Controller;
+} engine_options;
+
+/**
+ * Fills options with the defaults: the serial backend, in memory, the vtk
+ * mesh and writer, the x component, no pinning, the flat gather, no
+ * preview, no operators, no analytics, one thread, a pipeline depth of 2,
+ * the loader depth of loader_queue_depth(), and temporary files in the
+ * current directory.
+*/
+void default_engine_options(engine_options& options);
+
+/**
+ * Reads a backend name (serial, threads, mpi, hybrid). Returns false if it
+ * is not one.
+*/
+bool parse_engine_backend(const std::string& name, engine_backend& backend);
+
+/**
+ * Reads a handoff name (memory, files). Returns false if it is not one.
+*/
+bool parse_engine_handoff(const std::string& name, engine_handoff& handoff);
+
+/**
+ * Reads a mesh name (vtk, soa). Returns false if it is not one.
+*/
+bool parse_engine_mesh(const std::string& name, engine_mesh& mesh);
+
+/**
+ * Reads a writer name (vtk, direct, stream). Returns false if it is not
+ * one.
+*/
+bool parse_engine_writer(const std::string& name, engine_writer& writer);
+
+/**
+ * Reads a gather name (flat, node). Returns false if it is not one.
+*/
+bool parse_engine_gather(const std::string& name, engine_gather& gather);
+
+/**
+ * Returns the name of the backend.
+*/
+const char* engine_backend_name(engine_backend backend);
+
+/**
+ * Contours the files with the backend and writes the appended pieces to
+ * options.Output, and the products of the operators next to it (see
+ * block_product_path()). The mpi and hybrid backends have to be called by
+ * every process of the controller, and the parent (process 0) writes the
+ * output; they need at least 2 processes. Returns the number of triangles
+ * of the output in the process that wrote it, 0 in the others, or -1 if it
+ * failed.
+ *
+ * With a Preview stride, every block is first contoured at that stride
+ * (every Preview-th point along each axis, see stride_block()) and the
+ * preview is written to options.Output as soon as it is done, for a first
+ * look; then the files are contoured again at full resolution, into files
+ * next to it that replace the preview and its products once written. Each
+ * process keeps the files it reads for the preview in memory (see
+ * keep_loaded_files() in BlockLoader.h), so the full resolution parses
+ * them again without reading them again. The triangles returned are those
+ * of the full resolution output.
+ *
+ * With Analytics, the files are measured rather than contoured (see
+ * contour_stats in ContourKernel.h, whatever the mesh), in two passes: the
+ * first finds the range of the component over all the files (the worker
+ * threads of a process widened when they are joined, the processes with
+ * MPI_Allreduce), the second adds up, for each of 50 values over that
+ * range, the triangles, area and enclosed volume of the blocks of every
+ * worker, the worker threads of a process added up when they are joined
+ * and the processes with MPI_Reduce. The parent writes the sums to
+ * options.Output as text, a line per isovalue. No mesh is made, sent or
+ * written, and the triangles returned are those measured.
+*/
+long long run_contour_engine(const engine_options& options,
+                             const std::vector<std::string>& files);
+
+#endif
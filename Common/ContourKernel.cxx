@@ -0,0 +1,854 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ContourKernel.cxx
+* @author Naoki Eto
+* @brief Marching cubes of a rectilinear grid into a soa_mesh.
+*/
+
+#include "ContourKernel.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <vtkDataArray.h>
+#include <vtkMarchingCubesTriangleCases.h>
+#include <vtkPointData.h>
+#include <vtkRectilinearGrid.h>
+
+/**
+ * The corners of a cell, as offsets in i, j and k, in the order of the
+ * cases of vtkMarchingCubes.
+*/
+static const int CellCorners[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                                       {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+
+/**
+ * The two corners of every edge of a cell, in the order of the cases,
+ * always from the lower to the higher index.
+*/
+static const int CellEdges[12][2] = { {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6},
+                                      {7,6}, {4,7}, {0,4}, {1,5}, {3,7}, {2,6} };
+
+/**
+ * Where the point of every edge of a cell is kept: the axis of the edge
+ * (0 x, 1 y, 2 z), whether it is on the upper plane of the cell, and the
+ * offsets in i and j of its first corner.
+*/
+static const int EdgeSlots[12][4] = { {0,0,0,0}, {1,0,1,0}, {0,0,0,1}, {1,0,0,0},
+                                      {0,1,0,0}, {1,1,1,0}, {0,1,0,1}, {1,1,0,0},
+                                      {2,0,0,0}, {2,0,1,0}, {2,0,0,1}, {2,0,1,1} };
+
+/**
+ * The points made on the edges of the slab being contoured: the x and y
+ * edges of its two planes (PlaneIds, by the parity of the plane) and the z
+ * edges between them (ZIds), for the values that can cross them only,
+ * PlaneFirst and ZFirst being the first of those values. A plane only has
+ * slots for the values in the range of its scalars, and the z edges for
+ * those in the range of the slab, so a cache is as large as the most
+ * values any plane has rather than all of them. An entry is the point
+ * id + 1, and only counts if the point was made while the plane it is on
+ * was being contoured, which the ids tell since they only go up: so the
+ * entries left from older planes never have to be cleared.
+*/
+typedef struct Kernel_Slab
+{
+    int Nx;
+    int PlaneSize;
+    int K;
+    uint32_t SlabFirst;
+    uint32_t PreviousFirst;
+    std::vector<uint32_t> PlaneIds[2];
+    std::vector<uint32_t> ZIds;
+    int PlaneFirst[2];
+    int ZFirst;
+    const float* Coords[3];
+    soa_mesh* Mesh;
+} kernel_slab;
+
+/**
+ * Returns the id of the point of value on edge e of cell (i, j), making it
+ * if the cell next to it has not already.
+*/
+static uint32_t edge_point(kernel_slab& slab, int v, int e, int i, int j, const double* s,
+                           double value)
+{
+    const int* where = EdgeSlots[e];
+
+    int parity = (slab.K + where[1]) & 1;
+
+    // the lower plane was started with the slab before
+    uint32_t first = (where[0] != 2 && where[1] == 0) ? slab.PreviousFirst : slab.SlabFirst;
+
+    size_t at = (size_t) (i + where[2]) + slab.Nx * (j + where[3]);
+
+    uint32_t& entry = where[0] == 2 ?
+        slab.ZIds[(size_t) (v - slab.ZFirst) * slab.PlaneSize + at] :
+        slab.PlaneIds[parity][(size_t) (2 * (v - slab.PlaneFirst[parity]) + where[0]) *
+                              slab.PlaneSize + at];
+
+    if (entry > first)
+        return entry - 1;
+
+    const int* a = CellCorners[CellEdges[e][0]];
+    const int* b = CellCorners[CellEdges[e][1]];
+
+    double t = (value - s[CellEdges[e][0]]) / (s[CellEdges[e][1]] - s[CellEdges[e][0]]);
+
+    soa_mesh& mesh = *slab.Mesh;
+
+    uint32_t id = (uint32_t) mesh.X.size();
+
+    int corner[3] = { i, j, slab.K };
+
+    std::vector<float>* axes[3] = { &mesh.X, &mesh.Y, &mesh.Z };
+
+    for (int d = 0; d < 3; d++)
+    {
+        float pa = slab.Coords[d][corner[d] + a[d]];
+        float pb = slab.Coords[d][corner[d] + b[d]];
+
+        axes[d]->push_back((float) (pa + t * (pb - pa)));
+    }
+
+    entry = id + 1;
+
+    return id;
+}
+
+/**
+ * Returns the coordinates of an axis of the grid as floats.
+*/
+static void axis_coords(vtkDataArray* array, int count, std::vector<float>& coords)
+{
+    coords.resize(count);
+
+    for (int i = 0; i < count; i++)
+        coords[i] = (float) array->GetComponent(i, 0);
+}
+
+/**
+ * The values to contour at, spread over a range like GenerateValues: value
+ * v is First + v * Step.
+*/
+typedef struct Kernel_Values
+{
+    const double* Values;
+    int NumValues;
+    double First;
+    double Step;
+} kernel_values;
+
+/**
+ * Returns the scalar of a point from its tuple: one of its components, or
+ * the magnitude of the 3 of them. Component is known when compiling, so the
+ * choice costs nothing in the loop.
+*/
+template <class T, int Component>
+static inline double select_scalar(const T* tuple)
+{
+    if (Component == COMPONENT_MAGNITUDE)
+        return sqrt((double) tuple[0] * tuple[0] + (double) tuple[1] * tuple[1] +
+                    (double) tuple[2] * tuple[2]);
+
+    return tuple[Component];
+}
+
+/**
+ * Reads the scalars of the 8 corners of cell (i, j, k) into s, and their
+ * smallest and largest.
+*/
+template <class T, int Component>
+static inline void cell_scalars(const T* scalars, int stride, int nx, int ny, int i, int j,
+                                int k, double s[8], double& low, double& high)
+{
+    for (int c = 0; c < 8; c++)
+    {
+        vtkIdType p = (vtkIdType) (i + CellCorners[c][0]) +
+                      (vtkIdType) nx * ((j + CellCorners[c][1]) +
+                                        (vtkIdType) ny * (k + CellCorners[c][2]));
+
+        s[c] = select_scalar<T, Component>(scalars + stride * p);
+
+        if (c == 0 || s[c] < low)
+            low = s[c];
+        if (c == 0 || s[c] > high)
+            high = s[c];
+    }
+}
+
+/**
+ * Finds the values that cross a cell of scalars from low to high, the ones
+ * in (low, high], from first to last (none if last < first). The values up
+ * to low, before first, have the whole cell on their upper side.
+*/
+static inline void crossing_values(const kernel_values& values, double low, double high,
+                                   int& first, int& last)
+{
+    int numValues = values.NumValues;
+    double step = values.Step;
+
+    first = 0;
+    last = numValues - 1;
+
+    if (step <= 0.0)
+        return;
+
+    first = (int) floor((low - values.First) / step);
+    last = (int) floor((high - values.First) / step);
+
+    if (first < 0)
+        first = 0;
+    if (last > numValues - 1)
+        last = numValues - 1;
+
+    while (first > 0 && values.Values[first - 1] > low)
+        first--;
+    while (first < numValues && values.Values[first] <= low)
+        first++;
+    while (last >= 0 && values.Values[last] > high)
+        last--;
+    while (last < numValues - 1 && values.Values[last + 1] <= high)
+        last++;
+}
+
+/**
+ * Returns the marching cubes case of a cell at value: a bit for every
+ * corner at or above it.
+*/
+static inline int cell_case(const double s[8], double value)
+{
+    int index = 0;
+
+    for (int c = 0; c < 8; c++)
+    {
+        if (s[c] >= value)
+            index |= 1 << c;
+    }
+
+    return index;
+}
+
+/**
+ * Finds the smallest and largest scalar of plane k.
+*/
+template <class T, int Component>
+static void plane_range(const T* scalars, int stride, int nx, int ny, int k, double& low,
+                        double& high)
+{
+    vtkIdType start = (vtkIdType) nx * ny * k;
+
+    for (vtkIdType p = 0; p < (vtkIdType) nx * ny; p++)
+    {
+        double s = select_scalar<T, Component>(scalars + stride * (start + p));
+
+        if (p == 0 || s < low)
+            low = s;
+        if (p == 0 || s > high)
+            high = s;
+    }
+}
+
+/**
+ * Makes room in ids for the slots of the values crossing (low, high],
+ * slotsPerValue planes of slots each, and returns the first of them in
+ * first. The slots are only ever grown.
+*/
+static void size_edge_slots(const kernel_values& values, double low, double high,
+                            int slotsPerValue, int planeSize, std::vector<uint32_t>& ids,
+                            int& first)
+{
+    int last;
+
+    crossing_values(values, low, high, first, last);
+
+    size_t size = last >= first ? (size_t) (last - first + 1) * slotsPerValue * planeSize : 0;
+
+    if (ids.size() < size)
+        ids.resize(size, 0);
+}
+
+/**
+ * Marching cubes of every cell of the grid, with the scalars read in place
+ * as T, stride values apart, and selected by Component. There is one of
+ * these for every type and component (see CellKernels), so the loop has no
+ * virtual call and no switch on the type.
+*/
+template <class T, int Component>
+static void contour_cells(const void* data, int stride, const int dims[3],
+                          const kernel_values& values, kernel_slab& slab)
+{
+    const T* scalars = (const T*) data;
+
+    int nx = dims[0];
+    int ny = dims[1];
+    int nz = dims[2];
+
+    soa_mesh& mesh = *slab.Mesh;
+
+    const vtkMarchingCubesTriangleCases* cases = vtkMarchingCubesTriangleCases::GetCases();
+
+    slab.SlabFirst = (uint32_t) mesh.X.size();
+
+    // the ranges of the lower and upper plane of the slab
+    double planeLow[2], planeHigh[2];
+
+    if (nz > 1)
+    {
+        plane_range<T, Component>(scalars, stride, nx, ny, 0, planeLow[0], planeHigh[0]);
+
+        size_edge_slots(values, planeLow[0], planeHigh[0], 2, slab.PlaneSize, slab.PlaneIds[0],
+                        slab.PlaneFirst[0]);
+    }
+
+    for (int k = 0; k < nz - 1; k++)
+    {
+        slab.K = k;
+        slab.PreviousFirst = k == 0 ? (uint32_t) mesh.X.size() : slab.SlabFirst;
+        slab.SlabFirst = (uint32_t) mesh.X.size();
+
+        // the upper plane is new, its slots are those of the plane 2 below
+        int lower = k & 1;
+        int upper = (k + 1) & 1;
+
+        plane_range<T, Component>(scalars, stride, nx, ny, k + 1, planeLow[upper],
+                                  planeHigh[upper]);
+
+        size_edge_slots(values, planeLow[upper], planeHigh[upper], 2, slab.PlaneSize,
+                        slab.PlaneIds[upper], slab.PlaneFirst[upper]);
+
+        size_edge_slots(values, std::min(planeLow[lower], planeLow[upper]),
+                        std::max(planeHigh[lower], planeHigh[upper]), 1, slab.PlaneSize,
+                        slab.ZIds, slab.ZFirst);
+
+        for (int j = 0; j < ny - 1; j++)
+        {
+            for (int i = 0; i < nx - 1; i++)
+            {
+                double s[8];
+                double low, high;
+
+                cell_scalars<T, Component>(scalars, stride, nx, ny, i, j, k, s, low, high);
+
+                // only the values in (low, high] cross the cell
+                int first, last;
+
+                crossing_values(values, low, high, first, last);
+
+                for (int v = first; v <= last; v++)
+                {
+                    double value = values.Values[v];
+
+                    int index = cell_case(s, value);
+
+                    if (index == 0 || index == 255)
+                        continue;
+
+                    for (const int* edge = cases[index].edges; edge[0] > -1; edge += 3)
+                    {
+                        for (int e = 0; e < 3; e++)
+                            mesh.Triangles.push_back(edge_point(slab, v, edge[e], i, j, s,
+                                                                value));
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Measures the contour of every cell of the grid like contour_cells()
+ * makes it: the triangles of the case of a cell are made in place, their
+ * points interpolated again for every triangle rather than shared, and
+ * only their number and area are kept. The volume on the upper side of a
+ * value is the share of the corners of a cell at or above it times the
+ * volume of the cell; the cells entirely above a value are counted in
+ * whole, by adding the cell to above[first], the values before the first
+ * one crossing it having it whole (see run_measure()).
+*/
+template <class T, int Component>
+static void measure_cells(const void* data, int stride, const int dims[3], const float* coords[3],
+                          const kernel_values& values, contour_stats& stats,
+                          std::vector<double>& above)
+{
+    const T* scalars = (const T*) data;
+
+    int nx = dims[0];
+    int ny = dims[1];
+    int nz = dims[2];
+
+    const vtkMarchingCubesTriangleCases* cases = vtkMarchingCubesTriangleCases::GetCases();
+
+    for (int k = 0; k < nz - 1; k++)
+    {
+        for (int j = 0; j < ny - 1; j++)
+        {
+            for (int i = 0; i < nx - 1; i++)
+            {
+                double s[8];
+                double low, high;
+
+                cell_scalars<T, Component>(scalars, stride, nx, ny, i, j, k, s, low, high);
+
+                int corner[3] = { i, j, k };
+
+                double volume = 1.0;
+
+                for (int d = 0; d < 3; d++)
+                    volume *= coords[d][corner[d] + 1] - coords[d][corner[d]];
+
+                int first, last;
+
+                crossing_values(values, low, high, first, last);
+
+                above[first] += volume;
+
+                for (int v = first; v <= last; v++)
+                {
+                    double value = values.Values[v];
+
+                    int index = cell_case(s, value);
+
+                    int inside = 0;
+
+                    for (int c = 0; c < 8; c++)
+                        inside += (index >> c) & 1;
+
+                    stats.Volume[v] += volume * inside / 8.0;
+
+                    if (index == 0 || index == 255)
+                        continue;
+
+                    for (const int* edge = cases[index].edges; edge[0] > -1; edge += 3)
+                    {
+                        double p[3][3];
+
+                        for (int e = 0; e < 3; e++)
+                        {
+                            const int* a = CellCorners[CellEdges[edge[e]][0]];
+                            const int* b = CellCorners[CellEdges[edge[e]][1]];
+
+                            double sa = s[CellEdges[edge[e]][0]];
+                            double sb = s[CellEdges[edge[e]][1]];
+
+                            double t = (value - sa) / (sb - sa);
+
+                            for (int d = 0; d < 3; d++)
+                            {
+                                float pa = coords[d][corner[d] + a[d]];
+                                float pb = coords[d][corner[d] + b[d]];
+
+                                // rounded like the points of the mesh
+                                p[e][d] = (float) (pa + t * (pb - pa));
+                            }
+                        }
+
+                        double u[3], w[3];
+
+                        for (int d = 0; d < 3; d++)
+                        {
+                            u[d] = p[1][d] - p[0][d];
+                            w[d] = p[2][d] - p[0][d];
+                        }
+
+                        double nxw = u[1] * w[2] - u[2] * w[1];
+                        double nyw = u[2] * w[0] - u[0] * w[2];
+                        double nzw = u[0] * w[1] - u[1] * w[0];
+
+                        stats.Triangles[v]++;
+                        stats.Area[v] += 0.5 * sqrt(nxw * nxw + nyw * nyw + nzw * nzw);
+                    }
+                }
+            }
+        }
+    }
+}
+
+typedef void (*cell_kernel)(const void* data, int stride, const int dims[3],
+                            const kernel_values& values, kernel_slab& slab);
+
+typedef void (*measure_kernel)(const void* data, int stride, const int dims[3],
+                               const float* coords[3], const kernel_values& values,
+                               contour_stats& stats, std::vector<double>& above);
+
+/**
+ * The kernels of the types read in place (float, double) by component (x,
+ * y, z, magnitude), picked once per block.
+*/
+static const cell_kernel CellKernels[2][4] = {
+    { contour_cells<float, 0>, contour_cells<float, 1>, contour_cells<float, 2>,
+      contour_cells<float, COMPONENT_MAGNITUDE> },
+    { contour_cells<double, 0>, contour_cells<double, 1>, contour_cells<double, 2>,
+      contour_cells<double, COMPONENT_MAGNITUDE> } };
+
+/**
+ * The measuring kernels, like CellKernels.
+*/
+static const measure_kernel MeasureKernels[2][4] = {
+    { measure_cells<float, 0>, measure_cells<float, 1>, measure_cells<float, 2>,
+      measure_cells<float, COMPONENT_MAGNITUDE> },
+    { measure_cells<double, 0>, measure_cells<double, 1>, measure_cells<double, 2>,
+      measure_cells<double, COMPONENT_MAGNITUDE> } };
+
+/**
+ * Returns which kernels read the array in place (0 for float, 1 for
+ * double), or -1 if the array is of another type, or does not have the
+ * component (the magnitude needs 3 of them).
+*/
+static int find_kernel(vtkDataArray* array, kernel_component component)
+{
+    int numComponents = array->GetNumberOfComponents();
+
+    if (component == COMPONENT_MAGNITUDE ? numComponents != 3 : component >= numComponents)
+        return -1;
+
+    switch (array->GetDataType())
+    {
+    case VTK_FLOAT:
+        return 0;
+    case VTK_DOUBLE:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Copies the scalars of an array the kernels do not read in place into
+ * floats, one per point.
+*/
+static void copy_scalars(vtkDataArray* array, kernel_component component,
+                         std::vector<float>& copy)
+{
+    vtkIdType numPoints = array->GetNumberOfTuples();
+
+    copy.resize(numPoints);
+
+    for (vtkIdType p = 0; p < numPoints; p++)
+    {
+        if (component != COMPONENT_MAGNITUDE)
+        {
+            copy[p] = (float) array->GetComponent(p, component);
+            continue;
+        }
+
+        double sum = 0.0;
+
+        for (int c = 0; c < array->GetNumberOfComponents(); c++)
+        {
+            double x = array->GetComponent(p, c);
+            sum += x * x;
+        }
+
+        copy[p] = (float) sqrt(sum);
+    }
+}
+
+/**
+ * Fills values with numValues values spread over range like GenerateValues,
+ * and contourValues with them.
+*/
+static void spread_values(int numValues, const double range[2], std::vector<double>& values,
+                          kernel_values& contourValues)
+{
+    values.resize(numValues);
+
+    double step = numValues > 1 ? (range[1] - range[0]) / (numValues - 1) : 0.0;
+
+    for (int v = 0; v < numValues; v++)
+        values[v] = range[0] + v * step;
+
+    contourValues.Values = &values[0];
+    contourValues.NumValues = numValues;
+    contourValues.First = range[0];
+    contourValues.Step = step;
+}
+
+/**
+ * Contours the scalars of a grid with numValues values over range, with the
+ * kernel, and appends the triangles and their cell normals to the mesh.
+ * Returns the number of triangles added.
+*/
+static long long run_kernel(cell_kernel kernel, const void* data, int stride, const int dims[3],
+                            const float* coords[3], int numValues, const double range[2],
+                            soa_mesh& mesh)
+{
+    TRACE_BEGIN(contour);
+
+    // the values of GenerateValues
+    std::vector<double> values;
+    kernel_values contourValues;
+
+    spread_values(numValues, range, values, contourValues);
+
+    // the edge slots are made as the planes need them
+    kernel_slab slab;
+    slab.Nx = dims[0];
+    slab.PlaneSize = dims[0] * dims[1];
+    slab.PlaneFirst[0] = slab.PlaneFirst[1] = slab.ZFirst = 0;
+    slab.Mesh = &mesh;
+
+    for (int d = 0; d < 3; d++)
+        slab.Coords[d] = coords[d];
+
+    long long firstTriangle = soa_mesh_triangles(mesh);
+
+    kernel(data, stride, dims, contourValues, slab);
+
+    TRACE_END(contour);
+
+    MEMORY_RECORD(edges, (slab.PlaneIds[0].capacity() + slab.PlaneIds[1].capacity() +
+                          slab.ZIds.capacity()) * sizeof(uint32_t));
+
+    TRACE_BEGIN(normals);
+
+    compute_soa_normals(mesh, firstTriangle);
+
+    TRACE_END(normals);
+
+    return soa_mesh_triangles(mesh) - firstTriangle;
+}
+
+/**
+ * Measures the contour of the scalars of a grid at the values of stats,
+ * with the kernel, into stats. Returns the number of triangles measured.
+*/
+static long long run_measure(measure_kernel kernel, const void* data, int stride,
+                             const int dims[3], const float* coords[3], contour_stats& stats)
+{
+    TRACE_STAGE(measure);
+
+    int numValues = (int) stats.Values.size();
+
+    std::vector<double> values;
+    kernel_values contourValues;
+
+    spread_values(numValues, stats.Range, values, contourValues);
+
+    long long before = contour_stats_triangles(stats);
+
+    // above[f] is the volume of the cells first crossed by value f (or by
+    // none, f = numValues), which are whole above the values before f
+    std::vector<double> above(numValues + 1, 0.0);
+
+    kernel(data, stride, dims, coords, contourValues, stats, above);
+
+    double whole = 0.0;
+
+    for (int v = numValues - 1; v >= 0; v--)
+    {
+        whole += above[v + 1];
+        stats.Volume[v] += whole;
+    }
+
+    return contour_stats_triangles(stats) - before;
+}
+
+/**
+ * Contours the component of the grid into mesh, or measures it into stats
+ * if stats is not NULL.
+*/
+static long long kernel_grid(vtkRectilinearGrid* grid, kernel_component component,
+                             int numValues, const double range[2], soa_mesh* mesh,
+                             contour_stats* stats)
+{
+    int dims[3];
+
+    grid->GetDimensions(dims);
+
+    vtkDataArray* array = grid->GetPointData()->GetArray("grad");
+
+    if (array == NULL || numValues < 1 || dims[0] < 2 || dims[1] < 2 || dims[2] < 2)
+        return 0;
+
+    if (component != COMPONENT_MAGNITUDE && component >= array->GetNumberOfComponents())
+        return 0;
+
+    std::vector<float> axes[3];
+
+    axis_coords(grid->GetXCoordinates(), dims[0], axes[0]);
+    axis_coords(grid->GetYCoordinates(), dims[1], axes[1]);
+    axis_coords(grid->GetZCoordinates(), dims[2], axes[2]);
+
+    const float* coords[3] = { &axes[0][0], &axes[1][0], &axes[2][0] };
+
+    // float and double arrays are read in place, the others copied once
+    int type = find_kernel(array, component);
+    const void* data = array->GetVoidPointer(0);
+    int stride = array->GetNumberOfComponents();
+    std::vector<float> copy;
+
+    if (type < 0)
+    {
+        copy_scalars(array, component, copy);
+
+        data = &copy[0];
+        stride = 1;
+    }
+
+    if (stats != NULL)
+        return run_measure(type < 0 ? MeasureKernels[0][COMPONENT_X] :
+                                      MeasureKernels[type][component],
+                           data, stride, dims, coords, *stats);
+
+    return run_kernel(type < 0 ? CellKernels[0][COMPONENT_X] : CellKernels[type][component],
+                      data, stride, dims, coords, numValues, range, *mesh);
+}
+
+long long contour_soa(vtkRectilinearGrid* grid, kernel_component component, int numValues,
+                      const double range[2], soa_mesh& mesh)
+{
+    return kernel_grid(grid, component, numValues, range, &mesh, NULL);
+}
+
+long long contour_soa_scalars(const grid_scalars& scalars, int numValues, const double range[2],
+                              soa_mesh& mesh)
+{
+    const int* dims = scalars.Dims;
+
+    if (numValues < 1 || dims[0] < 2 || dims[1] < 2 || dims[2] < 2)
+        return 0;
+
+    const float* coords[3] = { &scalars.Coords[0][0], &scalars.Coords[1][0],
+                               &scalars.Coords[2][0] };
+
+    return run_kernel(CellKernels[0][COMPONENT_X], &scalars.Values[0], 1, dims, coords,
+                      numValues, range, mesh);
+}
+
+long long contour_scalars_block(const grid_scalars& scalars, soa_mesh& mesh)
+{
+    if (scalars.Values.empty())
+        return 0;
+
+    // woo 50 contours, over the range found when loading
+    return contour_soa_scalars(scalars, 50, scalars.Range, mesh);
+}
+
+void init_contour_stats(contour_stats& stats, int numValues, const double range[2])
+{
+    kernel_values contourValues;
+
+    stats.Range[0] = range[0];
+    stats.Range[1] = range[1];
+
+    spread_values(numValues, range, stats.Values, contourValues);
+
+    stats.Triangles.assign(numValues, 0);
+    stats.Area.assign(numValues, 0.0);
+    stats.Volume.assign(numValues, 0.0);
+}
+
+void add_contour_stats(contour_stats& into, const contour_stats& from)
+{
+    for (size_t v = 0; v < into.Triangles.size() && v < from.Triangles.size(); v++)
+    {
+        into.Triangles[v] += from.Triangles[v];
+        into.Area[v] += from.Area[v];
+        into.Volume[v] += from.Volume[v];
+    }
+}
+
+long long contour_stats_triangles(const contour_stats& stats)
+{
+    long long triangles = 0;
+
+    for (size_t v = 0; v < stats.Triangles.size(); v++)
+        triangles += stats.Triangles[v];
+
+    return triangles;
+}
+
+long long measure_soa_scalars(const grid_scalars& scalars, contour_stats& stats)
+{
+    const int* dims = scalars.Dims;
+
+    if (stats.Values.empty() || dims[0] < 2 || dims[1] < 2 || dims[2] < 2)
+        return 0;
+
+    const float* coords[3] = { &scalars.Coords[0][0], &scalars.Coords[1][0],
+                               &scalars.Coords[2][0] };
+
+    return run_measure(MeasureKernels[0][COMPONENT_X], &scalars.Values[0], 1, dims, coords,
+                       stats);
+}
+
+long long measure_soa(vtkRectilinearGrid* grid, kernel_component component,
+                      contour_stats& stats)
+{
+    return kernel_grid(grid, component, (int) stats.Values.size(), stats.Range, NULL, &stats);
+}
+
+/**
+ * The names of the components, in the order of kernel_component.
+*/
+static const char* ComponentNames[] = { "x", "y", "z", "magnitude" };
+
+bool parse_kernel_component(const std::string& name, kernel_component& component)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        if (name == ComponentNames[c])
+        {
+            component = (kernel_component) c;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool grid_component_range(vtkRectilinearGrid* grid, kernel_component component,
+                          double range[2])
+{
+    if (grid->GetNumberOfPoints() == 0)
+        return false;
+
+    vtkDataArray* array = grid->GetPointData()->GetArray("grad");
+
+    if (array == NULL)
+        return false;
+
+    if (component != COMPONENT_MAGNITUDE && component >= array->GetNumberOfComponents())
+        return false;
+
+    TRACE_BEGIN(range);
+
+    // vtkDataArray's component -1 is the magnitude
+    array->GetRange(range, component == COMPONENT_MAGNITUDE ? -1 : (int) component);
+
+    TRACE_END(range);
+
+    return true;
+}
+
+long long contour_soa_block(vtkRectilinearGrid* grid, kernel_component component,
+                            soa_mesh& mesh)
+{
+    double range[2];
+
+    if (!grid_component_range(grid, component, range))
+        return 0;
+
+    // woo 50 contours
+    return kernel_grid(grid, component, 50, range, &mesh, NULL);
+}
@@ -0,0 +1,164 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ContourKernel.h
+* @author Naoki Eto
+* @brief Marching cubes on a rectilinear grid, straight into a soa_mesh
+*        (see SoaMesh.h), for the engine. It contours a component of the
+*        "grad" array, or its magnitude, at values spread over a range like
+*        vtkContourFilter's GenerateValues, cell by cell with the triangle
+*        cases of vtkMarchingCubes, and only tries the values between the
+*        smallest and the largest scalar of a cell. The point on an edge
+*        is made once per value and shared by the triangles on both sides
+*        of it, and the cell normals of a block are computed right after
+*        its triangles. The surfaces are those of vtkContourFilter; the
+*        triangles are oriented by the cases rather than made consistent
+*        by vtkPolyDataNormals, and no points are split along sharp edges.
+*
+*        The cell loop is a template on the type of the array and the
+*        component, picked once per block: float and double arrays are read
+*        in place, with no vtkDataArray call per value, and the arrays of
+*        other types are copied into floats first. A grid loaded with
+*        load_grid_scalars or parse_grid_scalars (see StreamingContour.h)
+*        already has the scalar picked out, and its range, so it goes
+*        straight to the float kernel with no vtk grid at all.
+*
+*        The same cells can also be measured rather than contoured (see
+*        contour_stats): the triangles of every case are made only to add up
+*        their number and area, and the part of every cell on the upper side
+*        of every value is added up for the volume the surface encloses,
+*        without keeping a point or a triangle.
+*/
+
+#ifndef CONTOURKERNEL_H
+#define CONTOURKERNEL_H
+
+#include "SoaMesh.h"
+#include "StreamingContour.h"
+
+#include <string>
+#include <vector>
+
+class vtkRectilinearGrid;
+
+/**
+ * What is contoured of the tuples of "grad": a component, or the magnitude.
+*/
+typedef enum Kernel_Component
+{
+    COMPONENT_X,
+    COMPONENT_Y,
+    COMPONENT_Z,
+    COMPONENT_MAGNITUDE
+} kernel_component;
+
+/**
+ * Reads a component name (x, y, z, magnitude). Returns false if it is not
+ * one.
+*/
+bool parse_kernel_component(const std::string& name, kernel_component& component);
+
+/**
+ * Contours the component of the grid with numValues values over range and
+ * appends the triangles, and their cell normals, to the mesh. A component
+ * the array does not have adds nothing. Returns the number of triangles
+ * added.
+*/
+long long contour_soa(vtkRectilinearGrid* grid, kernel_component component, int numValues,
+                      const double range[2], soa_mesh& mesh);
+
+/**
+ * Contours the component of the grid with 50 values over its range, like
+ * the pipeline does (which contours x), and appends the triangles to the
+ * mesh. An empty grid adds nothing. Returns the number of triangles added.
+*/
+long long contour_soa_block(vtkRectilinearGrid* grid, kernel_component component,
+                            soa_mesh& mesh);
+
+/**
+ * Contours the scalars picked out of "grad" when the grid was loaded with
+ * numValues values over range, and appends the triangles and their cell
+ * normals to the mesh. Returns the number of triangles added.
+*/
+long long contour_soa_scalars(const grid_scalars& scalars, int numValues, const double range[2],
+                              soa_mesh& mesh);
+
+/**
+ * Contours the scalars with 50 values over the range found when they were
+ * loaded, like contour_soa_block, and appends the triangles to the mesh.
+ * Returns the number of triangles added.
+*/
+long long contour_scalars_block(const grid_scalars& scalars, soa_mesh& mesh);
+
+/**
+ * Returns in range the range of the component of the grid's "grad", like
+ * contour_soa_block contours it over. Returns false if the grid has no
+ * points, or "grad" is missing or has no such component.
+*/
+bool grid_component_range(vtkRectilinearGrid* grid, kernel_component component,
+                          double range[2]);
+
+/**
+ * What the contour of blocks measures, for every contour value: how many
+ * triangles it has, their area, and the volume it encloses (the volume of
+ * the cells, counting for a cell the surface goes through the share of its
+ * corners at or above the value). Every block is measured at the same
+ * values, spread over Range, so the stats of blocks add up value by value.
+*/
+typedef struct Contour_Stats
+{
+    double Range[2];
+    std::vector<double> Values;
+    std::vector<long long> Triangles;
+    std::vector<double> Area;
+    std::vector<double> Volume;
+} contour_stats;
+
+/**
+ * Sets stats to numValues values over range, spread like GenerateValues
+ * spreads them, with all measures 0.
+*/
+void init_contour_stats(contour_stats& stats, int numValues, const double range[2]);
+
+/**
+ * Adds the measures of from to those of into, which has the same values.
+*/
+void add_contour_stats(contour_stats& into, const contour_stats& from);
+
+/**
+ * Returns the triangles of all values of stats.
+*/
+long long contour_stats_triangles(const contour_stats& stats);
+
+/**
+ * Measures the contour of the scalars at the values of stats into stats,
+ * like contour_soa_scalars would make it but with no mesh. Returns the
+ * number of triangles measured.
+*/
+long long measure_soa_scalars(const grid_scalars& scalars, contour_stats& stats);
+
+/**
+ * Measures the contour of the component of the grid at the values of
+ * stats into stats, like contour_soa would make it. Returns the number of
+ * triangles measured.
+*/
+long long measure_soa(vtkRectilinearGrid* grid, kernel_component component,
+                      contour_stats& stats);
+
+#endif
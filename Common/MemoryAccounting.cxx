@@ -0,0 +1,302 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file MemoryAccounting.cxx
+* @author Naoki Eto
+* @brief Per-thread accounts of the bytes of every stage, and the summary
+*        of a process. Empty unless built with MEMORY_ACCOUNTING.
+*/
+
+#include "MemoryAccounting.h"
+
+#ifdef MEMORY_ACCOUNTING
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+#include <vtkDataObject.h>
+
+/**
+ * What one stage of one thread made.
+*/
+typedef struct Stage_Usage
+{
+    const char* Stage;
+    unsigned long long Count;
+    unsigned long long Bytes;
+    unsigned long long Largest;
+} stage_usage;
+
+/**
+ * The account of one thread: its stages, and the largest resident set of
+ * the process it has seen when recording.
+*/
+typedef struct Memory_Account
+{
+    int ThreadId;
+    std::vector<stage_usage> Stages;
+    unsigned long long PeakRss;
+} memory_account;
+
+static pthread_once_t AccountOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t AccountKey;
+static pthread_mutex_t AccountsMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<memory_account*>* Accounts = NULL;
+static std::vector<memory_account*>* Retired = NULL;
+static int Rank = 0;
+
+/**
+ * Called when a thread with an account exits. The next new thread carries
+ * on in its account, like the rings of the stage tracer, so the server of
+ * the pthreads variant does not grow an account per request.
+*/
+static void retire_account(void* account)
+{
+    pthread_mutex_lock(&AccountsMutex);
+
+    Retired->push_back((memory_account*) account);
+
+    pthread_mutex_unlock(&AccountsMutex);
+}
+
+static void make_key()
+{
+    pthread_key_create(&AccountKey, retire_account);
+
+    Accounts = new std::vector<memory_account*>;
+    Retired = new std::vector<memory_account*>;
+}
+
+/**
+ * Returns the account of the calling thread, taking the one of a thread
+ * that has exited, or making a new one, the first time.
+*/
+static memory_account* thread_account()
+{
+    pthread_once(&AccountOnce, make_key);
+
+    memory_account* account = (memory_account*) pthread_getspecific(AccountKey);
+
+    if (account != NULL)
+        return account;
+
+    pthread_mutex_lock(&AccountsMutex);
+
+    if (!Retired->empty())
+    {
+        account = Retired->back();
+        Retired->pop_back();
+    }
+    else
+    {
+        account = new memory_account;
+        account->ThreadId = (int) Accounts->size();
+        account->PeakRss = 0;
+
+        Accounts->push_back(account);
+    }
+
+    pthread_mutex_unlock(&AccountsMutex);
+
+    pthread_setspecific(AccountKey, account);
+
+    return account;
+}
+
+/**
+ * Returns the resident set of the process now, in bytes (0 if it cannot
+ * be read).
+*/
+static unsigned long long current_rss()
+{
+    FILE* in = fopen("/proc/self/statm", "r");
+
+    if (in == NULL)
+        return 0;
+
+    unsigned long long size = 0, resident = 0;
+
+    if (fscanf(in, "%llu %llu", &size, &resident) != 2)
+        resident = 0;
+
+    fclose(in);
+
+    return resident * (unsigned long long) sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Returns the peak resident set of the process from /proc/self/status
+ * (VmHWM), in bytes, or 0 if there is none.
+*/
+static unsigned long long peak_rss()
+{
+    FILE* in = fopen("/proc/self/status", "r");
+
+    if (in == NULL)
+        return 0;
+
+    char line[256];
+    unsigned long long kilobytes = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (sscanf(line, "VmHWM: %llu kB", &kilobytes) == 1)
+            break;
+    }
+
+    fclose(in);
+
+    return kilobytes * 1024;
+}
+
+/**
+ * Returns the bytes as MiB.
+*/
+static double mebibytes(unsigned long long bytes)
+{
+    return (double) bytes / (1024.0 * 1024.0);
+}
+
+/**
+ * Adds what a stage made to the stages, adding the stage if it is new.
+*/
+static void add_usage(std::vector<stage_usage>& stages, const stage_usage& usage)
+{
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        if (strcmp(stages[s].Stage, usage.Stage) == 0)
+        {
+            stages[s].Count += usage.Count;
+            stages[s].Bytes += usage.Bytes;
+
+            if (usage.Largest > stages[s].Largest)
+                stages[s].Largest = usage.Largest;
+
+            return;
+        }
+    }
+
+    stages.push_back(usage);
+}
+
+void memory_account_record(const char* stage, unsigned long long bytes)
+{
+    memory_account* account = thread_account();
+
+    stage_usage usage;
+
+    usage.Stage = stage;
+    usage.Count = 1;
+    usage.Bytes = bytes;
+    usage.Largest = bytes;
+
+    add_usage(account->Stages, usage);
+
+    unsigned long long rss = current_rss();
+
+    if (rss > account->PeakRss)
+        account->PeakRss = rss;
+}
+
+unsigned long long memory_data_bytes(vtkDataObject* data)
+{
+    // GetActualMemorySize() is in kibibytes
+    return data != NULL ? (unsigned long long) data->GetActualMemorySize() * 1024 : 0;
+}
+
+void memory_account_set_rank(int rank)
+{
+    Rank = rank;
+}
+
+void memory_account_report()
+{
+    pthread_once(&AccountOnce, make_key);
+
+    struct rusage usage;
+
+    // ru_maxrss is in kibibytes on Linux
+    unsigned long long maxrss = getrusage(RUSAGE_SELF, &usage) == 0
+                                ? (unsigned long long) usage.ru_maxrss * 1024 : 0;
+
+    // the whole summary goes out in one write, so that the summaries of
+    // the ranks do not get mixed up
+    std::string summary;
+    char line[256];
+
+    sprintf(line, "Memory of rank %d: peak resident set %.1f MiB (VmHWM), %.1f MiB (getrusage)\n",
+            Rank, mebibytes(peak_rss()), mebibytes(maxrss));
+    summary += line;
+
+    pthread_mutex_lock(&AccountsMutex);
+
+    std::vector<stage_usage> stages;
+
+    for (size_t a = 0; a < Accounts->size(); a++)
+    {
+        for (size_t s = 0; s < (*Accounts)[a]->Stages.size(); s++)
+            add_usage(stages, (*Accounts)[a]->Stages[s]);
+    }
+
+    if (!stages.empty())
+    {
+        sprintf(line, "  %-10s %8s %12s %12s %12s\n", "stage", "count", "total MiB", "mean MiB",
+                "largest MiB");
+        summary += line;
+    }
+
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        sprintf(line, "  %-10s %8llu %12.2f %12.3f %12.3f\n", stages[s].Stage, stages[s].Count,
+                mebibytes(stages[s].Bytes), mebibytes(stages[s].Bytes) / stages[s].Count,
+                mebibytes(stages[s].Largest));
+        summary += line;
+    }
+
+    for (size_t a = 0; a < Accounts->size(); a++)
+    {
+        const memory_account* account = (*Accounts)[a];
+
+        sprintf(line, "  thread %d: resident set up to %.1f MiB;", account->ThreadId,
+                mebibytes(account->PeakRss));
+        summary += line;
+
+        for (size_t s = 0; s < account->Stages.size(); s++)
+        {
+            sprintf(line, " %s %.2f MiB (largest %.3f)", account->Stages[s].Stage,
+                    mebibytes(account->Stages[s].Bytes), mebibytes(account->Stages[s].Largest));
+            summary += line;
+        }
+
+        summary += "\n";
+    }
+
+    pthread_mutex_unlock(&AccountsMutex);
+
+    fputs(summary.c_str(), stderr);
+    fflush(stderr);
+}
+
+#endif
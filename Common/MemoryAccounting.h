@@ -0,0 +1,80 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file MemoryAccounting.h
+* @author Naoki Eto
+* @brief Accounting of the memory the stages of the programs make: every
+*        thread adds up, per stage, how many bytes of data the stage made
+*        (the files read, the grids parsed, the pieces contoured, the 
+*        pieces sent and received, the appended output, ...), the largest
+*        of them, and the largest resident set of the process it has seen.
+*        At the end every process prints a summary of its stages and
+*        threads to stderr, with its peak resident set (VmHWM, and 
+*        getrusage), which is where the memory of the parent process of
+*        the MPI variants goes, gathering every piece.
+*
+*        Build with -DMEMORY_ACCOUNTING (cmake -DMEMORY_ACCOUNTING=ON) to
+*        account; without it the macros below are empty.
+*
+*        MEMORY_RECORD(read, size); records size bytes for the stage, and
+*        MEMORY_RECORD_DATA(contour, piece); the memory of a vtkDataObject.
+*/
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#ifdef MEMORY_ACCOUNTING
+
+class vtkDataObject;
+
+/**
+ * Records that the calling thread's stage made bytes of data.
+*/
+void memory_account_record(const char* stage, unsigned long long bytes);
+
+/**
+ * Returns the bytes of memory the data object holds.
+*/
+unsigned long long memory_data_bytes(vtkDataObject* data);
+
+/**
+ * Sets the rank of this process in the summary.
+*/
+void memory_account_set_rank(int rank);
+
+/**
+ * Prints the summary of this process to stderr.
+*/
+void memory_account_report();
+
+#define MEMORY_RECORD(stage, bytes) memory_account_record(#stage, bytes)
+#define MEMORY_RECORD_DATA(stage, data) memory_account_record(#stage, memory_data_bytes(data))
+#define MEMORY_SET_RANK(rank) memory_account_set_rank(rank)
+#define MEMORY_REPORT() memory_account_report()
+
+#else
+
+#define MEMORY_RECORD(stage, bytes)
+#define MEMORY_RECORD_DATA(stage, data)
+#define MEMORY_SET_RANK(rank)
+#define MEMORY_REPORT()
+
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file NodeMerge.cxx
+* @author Naoki Eto
+* @brief Merging of soa meshes in a shared memory window per machine.
+*/
+
+#include "NodeMerge.h"
+
+#include <string.h>
+
+#include <vector>
+
+MPI_Comm split_machine(MPI_Comm comm)
+{
+    MPI_Comm machine;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &machine);
+
+    return machine;
+}
+
+void merge_on_node(MPI_Comm machine, soa_mesh& mesh, node_mesh& merged)
+{
+    int rank, size;
+
+    MPI_Comm_rank(machine, &rank);
+    MPI_Comm_size(machine, &size);
+
+    long long counts[2];
+    counts[0] = soa_mesh_points(mesh);
+    counts[1] = soa_mesh_triangles(mesh);
+
+    std::vector<long long> all(2 * size);
+
+    MPI_Allgather(counts, 2, MPI_LONG_LONG, &all[0], 2, MPI_LONG_LONG, machine);
+
+    // where the arrays of this process go
+    long long firstPoint = 0;
+    long long firstTriangle = 0;
+
+    merged.NumPoints = 0;
+    merged.NumTriangles = 0;
+
+    for (int r = 0; r < size; r++)
+    {
+        if (r == rank)
+        {
+            firstPoint = merged.NumPoints;
+            firstTriangle = merged.NumTriangles;
+        }
+
+        merged.NumPoints += all[2 * r];
+        merged.NumTriangles += all[2 * r + 1];
+    }
+
+    // x, y, z, then the ids and the normals of the triangles, all 4 bytes
+    MPI_Aint bytes = (MPI_Aint) (3 * merged.NumPoints + 6 * merged.NumTriangles) * 4;
+
+    char* base = NULL;
+
+    MPI_Win_allocate_shared(rank == 0 ? bytes : 0, 4, MPI_INFO_NULL, machine, &base,
+                            &merged.Window);
+
+    MPI_Aint leaderBytes;
+    int unit;
+
+    MPI_Win_shared_query(merged.Window, 0, &leaderBytes, &unit, &base);
+
+    merged.X = (float*) base;
+    merged.Y = merged.X + merged.NumPoints;
+    merged.Z = merged.Y + merged.NumPoints;
+    merged.Triangles = (uint32_t*) (merged.Z + merged.NumPoints);
+    merged.Normals = (float*) (merged.Triangles + 3 * merged.NumTriangles);
+
+    MPI_Win_fence(0, merged.Window);
+
+    // every array is let go of once it is in the window, so that only one
+    // array of the mesh is ever in memory twice
+    if (counts[0] > 0)
+    {
+        memcpy(merged.X + firstPoint, &mesh.X[0], counts[0] * sizeof(float));
+        std::vector<float>().swap(mesh.X);
+
+        memcpy(merged.Y + firstPoint, &mesh.Y[0], counts[0] * sizeof(float));
+        std::vector<float>().swap(mesh.Y);
+
+        memcpy(merged.Z + firstPoint, &mesh.Z[0], counts[0] * sizeof(float));
+        std::vector<float>().swap(mesh.Z);
+    }
+
+    if (counts[1] > 0)
+    {
+        uint32_t* ids = merged.Triangles + 3 * firstTriangle;
+
+        for (long long i = 0; i < 3 * counts[1]; i++)
+            ids[i] = mesh.Triangles[i] + (uint32_t) firstPoint;
+
+        std::vector<uint32_t>().swap(mesh.Triangles);
+
+        memcpy(merged.Normals + 3 * firstTriangle, &mesh.Normals[0],
+               3 * counts[1] * sizeof(float));
+        std::vector<float>().swap(mesh.Normals);
+    }
+
+    clear_soa_mesh(mesh);
+
+    MPI_Win_fence(0, merged.Window);
+}
+
+soa_view node_mesh_view(const node_mesh& merged)
+{
+    soa_view view;
+
+    view.NumPoints = merged.NumPoints;
+    view.NumTriangles = merged.NumTriangles;
+    view.X = merged.X;
+    view.Y = merged.Y;
+    view.Z = merged.Z;
+    view.Triangles = merged.Triangles;
+    view.Normals = merged.Normals;
+
+    return view;
+}
+
+void free_node_mesh(node_mesh& merged)
+{
+    MPI_Win_free(&merged.Window);
+}
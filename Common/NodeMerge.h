@@ -0,0 +1,91 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file NodeMerge.h
+* @author Naoki Eto
+* @brief Merging of the soa meshes (see SoaMesh.h) of the processes of one
+*        machine in a shared memory window (MPI_Win_allocate_shared), so
+*        that they are gathered in two levels: the processes of a machine
+*        into the window of the first of them, its leader, with no
+*        message, then only the leaders to the parent. What goes between
+*        machines is one merged mesh per machine rather than one per
+*        process.
+*
+*        The processes first tell each other how many points and triangles
+*        they have, so that every one knows where its arrays go in the
+*        merged mesh; the leader allocates the window for all of them, and
+*        every process copies its own arrays into their place (its point
+*        ids moved by the points of the processes before it) at the same
+*        time as the others, letting go of each one once it is copied.
+*        That one copy stays: the window is allocated once, collectively,
+*        with its final size, which is only known once every process has
+*        contoured its blocks (a block's triangles are only counted by
+*        contouring it). The leader then writes or sends the merged mesh
+*        straight from the window.
+*/
+
+#ifndef NODEMERGE_H
+#define NODEMERGE_H
+
+#include <mpi.h>
+
+#include "SoaMesh.h"
+
+/**
+ * The merged mesh of a machine: the window holding it, and its arrays in
+ * the window (the same memory in every process of the machine).
+*/
+typedef struct Node_Mesh
+{
+    MPI_Win Window;
+    long long NumPoints;
+    long long NumTriangles;
+    float* X;
+    float* Y;
+    float* Z;
+    uint32_t* Triangles;
+    float* Normals;
+} node_mesh;
+
+/**
+ * Returns the processes of comm on the same machine as this one, in the
+ * order of comm, which the caller has to MPI_Comm_free().
+*/
+MPI_Comm split_machine(MPI_Comm comm);
+
+/**
+ * Merges the mesh of every process of machine into merged, in order of
+ * their ranks, and empties mesh, letting go of its memory. All of them
+ * have to call it; the merged mesh is there for all of them once it
+ * returns.
+*/
+void merge_on_node(MPI_Comm machine, soa_mesh& mesh, node_mesh& merged);
+
+/**
+ * Returns a view of the merged mesh.
+*/
+soa_view node_mesh_view(const node_mesh& merged);
+
+/**
+ * Lets go of the window. All the processes of the machine have to call it,
+ * after the leader is done with the merged mesh.
+*/
+void free_node_mesh(node_mesh& merged);
+
+#endif
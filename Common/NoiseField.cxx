@@ -0,0 +1,162 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file NoiseField.cxx
+* @author Naoki Eto
+* @brief The waves of a seeded noise field and its gradient on a grid.
+*/
+
+#include "NoiseField.h"
+
+#include <math.h>
+
+/**
+ * The next number of the splitmix64 sequence of state, which only depends
+ * on the seed, unlike rand().
+*/
+static unsigned long long next_random(unsigned long long& state)
+{
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+/**
+ * Returns a number in [0, 1).
+*/
+static double next_uniform(unsigned long long& state)
+{
+    return (double) (next_random(state) >> 11) / 9007199254740992.0;
+}
+
+void make_noise_field(unsigned long long seed, double edge, noise_field& field)
+{
+    const int octaves = 4;
+    const int wavesPerOctave = 8;
+
+    field.Seed = seed;
+    field.Waves.clear();
+
+    unsigned long long state = seed;
+
+    for (int o = 0; o < octaves; o++)
+    {
+        // the longest wavelength is half the edge, then a quarter, ...
+        double wavenumber = 2.0 * M_PI * (2 << o) / edge;
+
+        for (int w = 0; w < wavesPerOctave; w++)
+        {
+            noise_wave wave;
+
+            // a direction uniformly on the sphere
+            double cosTheta = 2.0 * next_uniform(state) - 1.0;
+            double sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+            double phi = 2.0 * M_PI * next_uniform(state);
+
+            wave.K[0] = wavenumber * sinTheta * cos(phi);
+            wave.K[1] = wavenumber * sinTheta * sin(phi);
+            wave.K[2] = wavenumber * cosTheta;
+
+            wave.Phase = 2.0 * M_PI * next_uniform(state);
+
+            // gradients of about 0.1 for the first octave, like the
+            // datasets in the repository, halving every octave
+            wave.Amplitude = 0.1 / (wavenumber * sqrt((double) wavesPerOctave) * (1 << o));
+
+            field.Waves.push_back(wave);
+        }
+    }
+}
+
+void noise_gradient(const noise_field& field, const std::vector<double>& x,
+                    const std::vector<double>& y, const std::vector<double>& z,
+                    std::vector<float>& grad)
+{
+    size_t nx = x.size();
+    size_t ny = y.size();
+    size_t nz = z.size();
+    size_t numWaves = field.Waves.size();
+
+    grad.assign(3 * nx * ny * nz, 0.0f);
+
+    // cos(k.x + phase) = Re(exp(i kx x) exp(i (ky y + kz z + phase))), so
+    // the x part is worked out once per column and the rest once per row
+    std::vector<double> cosX(numWaves * nx);
+    std::vector<double> sinX(numWaves * nx);
+
+    for (size_t w = 0; w < numWaves; w++)
+    {
+        for (size_t i = 0; i < nx; i++)
+        {
+            cosX[w * nx + i] = cos(field.Waves[w].K[0] * x[i]);
+            sinX[w * nx + i] = sin(field.Waves[w].K[0] * x[i]);
+        }
+    }
+
+    std::vector<double> cosYZ(numWaves);
+    std::vector<double> sinYZ(numWaves);
+    std::vector<double> row(3 * nx);
+
+    for (size_t k = 0; k < nz; k++)
+    {
+        for (size_t j = 0; j < ny; j++)
+        {
+            for (size_t w = 0; w < numWaves; w++)
+            {
+                const noise_wave& wave = field.Waves[w];
+
+                double angle = wave.K[1] * y[j] + wave.K[2] * z[k] + wave.Phase;
+
+                cosYZ[w] = cos(angle);
+                sinYZ[w] = sin(angle);
+            }
+
+            row.assign(3 * nx, 0.0);
+
+            for (size_t w = 0; w < numWaves; w++)
+            {
+                const noise_wave& wave = field.Waves[w];
+
+                double ax = wave.Amplitude * wave.K[0];
+                double ay = wave.Amplitude * wave.K[1];
+                double az = wave.Amplitude * wave.K[2];
+
+                const double* cx = &cosX[w * nx];
+                const double* sx = &sinX[w * nx];
+
+                for (size_t i = 0; i < nx; i++)
+                {
+                    double c = cx[i] * cosYZ[w] - sx[i] * sinYZ[w];
+
+                    row[3 * i] += ax * c;
+                    row[3 * i + 1] += ay * c;
+                    row[3 * i + 2] += az * c;
+                }
+            }
+
+            float* out = &grad[3 * nx * (j + ny * k)];
+
+            for (size_t i = 0; i < 3 * nx; i++)
+                out[i] = (float) row[i];
+        }
+    }
+}
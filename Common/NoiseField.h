@@ -0,0 +1,68 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file NoiseField.h
+* @author Naoki Eto
+* @brief A smooth noise field made from a seed: a sum of plane waves
+*        A sin(k.x + phase) with random directions and phases, over a few
+*        octaves of wavelengths, and its gradient, which is what goes into
+*        the "grad" array of a generated dataset. The same seed gives the
+*        same field on every machine and with any number of processes.
+*/
+
+#ifndef NOISEFIELD_H
+#define NOISEFIELD_H
+
+#include <vector>
+
+/**
+ * One plane wave of the field.
+*/
+typedef struct Noise_Wave
+{
+    double K[3];
+    double Phase;
+    double Amplitude;
+} noise_wave;
+
+/**
+ * The waves of a field.
+*/
+typedef struct Noise_Field
+{
+    unsigned long long Seed;
+    std::vector<noise_wave> Waves;
+} noise_field;
+
+/**
+ * Makes the field of the seed over a cube of the given edge length: 8
+ * waves in each of 4 octaves, the longest being half the edge long, each
+ * octave with half the gradient of the one before.
+*/
+void make_noise_field(unsigned long long seed, double edge, noise_field& field);
+
+/**
+ * Fills grad (3 floats per point, x fastest) with the gradient of the field
+ * on the rectilinear grid of the coordinates x, y and z.
+*/
+void noise_gradient(const noise_field& field, const std::vector<double>& x,
+                    const std::vector<double>& y, const std::vector<double>& z,
+                    std::vector<float>& grad);
+
+#endif
@@ -0,0 +1,326 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file PolyStreamWriter.cxx
+* @author Naoki Eto
+* @brief Piece by piece writing of legacy binary vtk polydata files.
+*/
+
+#include "PolyStreamWriter.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+/**
+ * Returns true on little endian machines, whose values have to be swapped
+ * since legacy binary vtk files are big endian.
+*/
+static bool little_endian()
+{
+    const uint16_t one = 1;
+
+    return *(const unsigned char*) &one == 1;
+}
+
+/**
+ * Writes count 4 byte values big endian.
+*/
+static bool write_big_endian(FILE* file, const void* values, size_t count)
+{
+    if (!little_endian())
+        return fwrite(values, 4, count, file) == count;
+
+    std::vector<unsigned char> swapped(4 * count);
+    const unsigned char* bytes = (const unsigned char*) values;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        swapped[4 * i + 0] = bytes[4 * i + 3];
+        swapped[4 * i + 1] = bytes[4 * i + 2];
+        swapped[4 * i + 2] = bytes[4 * i + 1];
+        swapped[4 * i + 3] = bytes[4 * i + 0];
+    }
+
+    return fwrite(&swapped[0], 4, count, file) == count;
+}
+
+/**
+ * Copies the whole spool file to the end of the output file.
+*/
+static bool copy_spool(FILE* spool, FILE* out)
+{
+    char buffer[1 << 16];
+    size_t got;
+
+    rewind(spool);
+
+    while ((got = fread(buffer, 1, sizeof(buffer), spool)) > 0)
+    {
+        if (fwrite(buffer, 1, got, out) != got)
+            return false;
+    }
+
+    return !ferror(spool);
+}
+
+/**
+ * The width the count of points is padded to in the POINTS line, so that
+ * the final count fits where the header was written before the points.
+*/
+static const int CountWidth = 20;
+
+poly_stream* poly_stream_open(const char* path)
+{
+    poly_stream* stream = new poly_stream;
+
+    stream->Path = path;
+    stream->Out = fopen(path, "wb");
+    stream->Polys = fopen((stream->Path + ".polys").c_str(), "w+b");
+    stream->Normals = fopen((stream->Path + ".normals").c_str(), "w+b");
+    stream->CountOffset = -1;
+    stream->NumPoints = 0;
+    stream->NumPolys = 0;
+    stream->PolysSize = 0;
+    stream->NumNormals = 0;
+    stream->Failed = false;
+
+    if (stream->Out != NULL)
+    {
+        fprintf(stream->Out, "# vtk DataFile Version 3.0\nvtk output\nBINARY\n"
+                             "DATASET POLYDATA\nPOINTS ");
+
+        stream->CountOffset = ftell(stream->Out);
+
+        // the count is written over these spaces once it is known
+        fprintf(stream->Out, "%*s float\n", CountWidth, "");
+    }
+
+    if (stream->Out == NULL || stream->Polys == NULL || stream->Normals == NULL ||
+        stream->CountOffset < 0)
+    {
+        stream->Failed = true;
+        poly_stream_close(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+bool poly_stream_append(poly_stream* stream, vtkPolyData* piece)
+{
+    if (stream->Failed)
+        return false;
+
+    vtkPoints* points = piece->GetPoints();
+    vtkCellArray* polys = piece->GetPolys();
+
+    if (points == NULL || polys == NULL || polys->GetNumberOfCells() == 0)
+        return true;
+
+    vtkIdType numPoints = points->GetNumberOfPoints();
+
+    std::vector<float>& coords = stream->Coords;
+
+    coords.resize(3 * numPoints);
+
+    for (vtkIdType p = 0; p < numPoints; p++)
+    {
+        double point[3];
+
+        points->GetPoint(p, point);
+
+        coords[3 * p + 0] = (float) point[0];
+        coords[3 * p + 1] = (float) point[1];
+        coords[3 * p + 2] = (float) point[2];
+    }
+
+    bool ok = write_big_endian(stream->Out, &coords[0], coords.size());
+
+    // point ids of this piece come after the points of the pieces before;
+    // a count and the ids of every cell, 4 entries a triangle
+    std::vector<int32_t>& cells = stream->Cells;
+
+    cells.clear();
+    cells.reserve(polys->GetNumberOfConnectivityEntries());
+
+    vtkIdType numIds;
+    vtkIdType* ids;
+
+    polys->InitTraversal();
+
+    while (polys->GetNextCell(numIds, ids))
+    {
+        cells.push_back((int32_t) numIds);
+
+        for (vtkIdType i = 0; i < numIds; i++)
+            cells.push_back((int32_t) (ids[i] + stream->NumPoints));
+    }
+
+    ok = ok && write_big_endian(stream->Polys, &cells[0], cells.size());
+
+    // polygons are the only cells, so the cell normals are theirs
+    vtkDataArray* normals = piece->GetCellData()->GetNormals();
+    vtkIdType numPolys = polys->GetNumberOfCells();
+
+    if (normals != NULL && normals->GetNumberOfTuples() == numPolys &&
+        piece->GetNumberOfCells() == numPolys)
+    {
+        std::vector<float>& values = stream->Values;
+
+        values.resize(3 * numPolys);
+
+        for (vtkIdType c = 0; c < numPolys; c++)
+        {
+            double* normal = normals->GetTuple3(c);
+
+            values[3 * c + 0] = (float) normal[0];
+            values[3 * c + 1] = (float) normal[1];
+            values[3 * c + 2] = (float) normal[2];
+        }
+
+        ok = ok && write_big_endian(stream->Normals, &values[0], values.size());
+
+        stream->NumNormals += numPolys;
+    }
+
+    stream->NumPoints += numPoints;
+    stream->NumPolys += numPolys;
+    stream->PolysSize += (long long) cells.size();
+
+    if (!ok)
+        stream->Failed = true;
+
+    return ok;
+}
+
+bool poly_stream_append_mesh(poly_stream* stream, const soa_mesh& mesh)
+{
+    return poly_stream_append_view(stream, soa_mesh_view(mesh));
+}
+
+bool poly_stream_append_view(poly_stream* stream, const soa_view& view)
+{
+    if (stream->Failed)
+        return false;
+
+    long long numPoints = view.NumPoints;
+    long long numPolys = view.NumTriangles;
+
+    if (numPolys == 0)
+        return true;
+
+    std::vector<float>& coords = stream->Coords;
+
+    coords.resize(3 * numPoints);
+
+    for (long long p = 0; p < numPoints; p++)
+    {
+        coords[3 * p + 0] = view.X[p];
+        coords[3 * p + 1] = view.Y[p];
+        coords[3 * p + 2] = view.Z[p];
+    }
+
+    bool ok = write_big_endian(stream->Out, &coords[0], coords.size());
+
+    std::vector<int32_t>& cells = stream->Cells;
+
+    cells.resize(4 * numPolys);
+
+    for (long long t = 0; t < numPolys; t++)
+    {
+        cells[4 * t + 0] = 3;
+        cells[4 * t + 1] = (int32_t) (view.Triangles[3 * t + 0] + stream->NumPoints);
+        cells[4 * t + 2] = (int32_t) (view.Triangles[3 * t + 1] + stream->NumPoints);
+        cells[4 * t + 3] = (int32_t) (view.Triangles[3 * t + 2] + stream->NumPoints);
+    }
+
+    ok = ok && write_big_endian(stream->Polys, &cells[0], cells.size());
+
+    // the normals are packed already
+    if (view.Normals != NULL)
+    {
+        ok = ok && write_big_endian(stream->Normals, view.Normals, 3 * numPolys);
+
+        stream->NumNormals += numPolys;
+    }
+
+    stream->NumPoints += numPoints;
+    stream->NumPolys += numPolys;
+    stream->PolysSize += (long long) cells.size();
+
+    if (!ok)
+        stream->Failed = true;
+
+    return ok;
+}
+
+bool poly_stream_close(poly_stream* stream)
+{
+    bool ok = !stream->Failed;
+
+    FILE* out = stream->Out;
+
+    if (ok)
+    {
+        fprintf(out, "\nPOLYGONS %lld %lld\n", stream->NumPolys, stream->PolysSize);
+        ok = copy_spool(stream->Polys, out);
+
+        if (stream->NumPolys > 0 && stream->NumNormals == stream->NumPolys)
+        {
+            fprintf(out, "\nCELL_DATA %lld\nNORMALS Normals float\n", stream->NumPolys);
+            ok = ok && copy_spool(stream->Normals, out);
+        }
+
+        fprintf(out, "\n");
+
+        // the count of points, padded with spaces to the width left for it
+        ok = ok && fseek(out, stream->CountOffset, SEEK_SET) == 0 &&
+             fprintf(out, "%-*lld", CountWidth, stream->NumPoints) == CountWidth;
+    }
+
+    if (out != NULL)
+    {
+        ok = fclose(out) == 0 && ok;
+
+        // no half written output left behind
+        if (!ok)
+            remove(stream->Path.c_str());
+    }
+
+    if (stream->Polys != NULL)
+        fclose(stream->Polys);
+    if (stream->Normals != NULL)
+        fclose(stream->Normals);
+
+    remove((stream->Path + ".polys").c_str());
+    remove((stream->Path + ".normals").c_str());
+
+    delete stream;
+
+    return ok;
+}
@@ -0,0 +1,102 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file PolyStreamWriter.h
+* @author Naoki Eto
+* @brief Writes a legacy binary vtk polydata file piece by piece, without
+*        keeping the pieces around. The points of every piece go straight
+*        into the output file as the piece comes in, after a POINTS line
+*        whose count is left blank (spaces, of a fixed width) and written
+*        over on close. The polygons and cell normals, which have to come
+*        after all the points, go to spool files next to the output (its
+*        path with .polys and .normals), which closing the writer copies
+*        to the end of the output and removes. Only the polygons of the
+*        pieces are written (contours of volumes have nothing else), and
+*        the cell normals only if every piece had them.
+*/
+
+#ifndef POLYSTREAMWRITER_H
+#define POLYSTREAMWRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "SoaMesh.h"
+
+class vtkPolyData;
+
+/**
+ * The output file, where its count of points goes, the spool files of the
+ * sections after the points, and what has been written so far. Coords,
+ * Cells and Values hold the sections of a piece on their way to the files,
+ * and are kept from one piece to the next so that they only grow when a
+ * piece is bigger than all before it.
+*/
+typedef struct Poly_Stream
+{
+    std::string Path;
+    FILE* Out;
+    FILE* Polys;
+    FILE* Normals;
+    long CountOffset;
+    long long NumPoints;
+    long long NumPolys;
+    long long PolysSize;
+    long long NumNormals;
+    bool Failed;
+    std::vector<float> Coords;
+    std::vector<int32_t> Cells;
+    std::vector<float> Values;
+} poly_stream;
+
+/**
+ * Starts writing the polydata file at path, with its header. Returns NULL
+ * if it or the spool files next to it cannot be created.
+*/
+poly_stream* poly_stream_open(const char* path);
+
+/**
+ * Appends the points, polygons and cell normals of the piece. Returns
+ * false once a write has failed.
+*/
+bool poly_stream_append(poly_stream* stream, vtkPolyData* piece);
+
+/**
+ * Appends the points, triangles and cell normals of a mesh of the engine,
+ * straight from its arrays. Returns false once a write has failed.
+*/
+bool poly_stream_append_mesh(poly_stream* stream, const soa_mesh& mesh);
+
+/**
+ * Same as poly_stream_append_mesh(), from the arrays of a view (i.e. in a
+ * shared memory window).
+*/
+bool poly_stream_append_view(poly_stream* stream, const soa_view& view);
+
+/**
+ * Puts the spooled sections at the end of the output file, writes its
+ * count of points, removes the spool files and frees the writer. Returns
+ * false if anything could not be written.
+*/
+bool poly_stream_close(poly_stream* stream);
+
+#endif
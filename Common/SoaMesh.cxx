@@ -0,0 +1,382 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file SoaMesh.cxx
+* @author Naoki Eto
+* @brief Merging, sending, saving and converting the structure of arrays
+*        mesh of the engine.
+*/
+
+#include "SoaMesh.h"
+#include "PolyStreamWriter.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMultiProcessController.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+long long soa_mesh_points(const soa_mesh& mesh)
+{
+    return (long long) mesh.X.size();
+}
+
+long long soa_mesh_triangles(const soa_mesh& mesh)
+{
+    return (long long) mesh.Triangles.size() / 3;
+}
+
+unsigned long soa_mesh_bytes(const soa_mesh& mesh)
+{
+    return (unsigned long) ((mesh.X.size() + mesh.Y.size() + mesh.Z.size() +
+                             mesh.Normals.size()) * sizeof(float) +
+                            mesh.Triangles.size() * sizeof(uint32_t));
+}
+
+void clear_soa_mesh(soa_mesh& mesh)
+{
+    mesh.X.clear();
+    mesh.Y.clear();
+    mesh.Z.clear();
+    mesh.Triangles.clear();
+    mesh.Normals.clear();
+}
+
+void append_soa_mesh(soa_mesh& mesh, const soa_mesh& from)
+{
+    uint32_t offset = (uint32_t) mesh.X.size();
+
+    mesh.X.insert(mesh.X.end(), from.X.begin(), from.X.end());
+    mesh.Y.insert(mesh.Y.end(), from.Y.begin(), from.Y.end());
+    mesh.Z.insert(mesh.Z.end(), from.Z.begin(), from.Z.end());
+
+    size_t first = mesh.Triangles.size();
+
+    mesh.Triangles.insert(mesh.Triangles.end(), from.Triangles.begin(), from.Triangles.end());
+
+    if (offset > 0)
+    {
+        for (size_t t = first; t < mesh.Triangles.size(); t++)
+            mesh.Triangles[t] += offset;
+    }
+
+    mesh.Normals.insert(mesh.Normals.end(), from.Normals.begin(), from.Normals.end());
+}
+
+void compute_soa_normals(soa_mesh& mesh, long long firstTriangle)
+{
+    long long numTriangles = soa_mesh_triangles(mesh);
+
+    mesh.Normals.resize(3 * numTriangles);
+
+    for (long long t = firstTriangle; t < numTriangles; t++)
+    {
+        const uint32_t* ids = &mesh.Triangles[3 * t];
+
+        float ux = mesh.X[ids[1]] - mesh.X[ids[0]];
+        float uy = mesh.Y[ids[1]] - mesh.Y[ids[0]];
+        float uz = mesh.Z[ids[1]] - mesh.Z[ids[0]];
+
+        float vx = mesh.X[ids[2]] - mesh.X[ids[0]];
+        float vy = mesh.Y[ids[2]] - mesh.Y[ids[0]];
+        float vz = mesh.Z[ids[2]] - mesh.Z[ids[0]];
+
+        float nx = uy * vz - uz * vy;
+        float ny = uz * vx - ux * vz;
+        float nz = ux * vy - uy * vx;
+
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+
+        // a degenerate triangle keeps a zero normal
+        if (length > 0.0f)
+        {
+            nx /= length;
+            ny /= length;
+            nz /= length;
+        }
+
+        mesh.Normals[3 * t + 0] = nx;
+        mesh.Normals[3 * t + 1] = ny;
+        mesh.Normals[3 * t + 2] = nz;
+    }
+}
+
+vtkPolyData* soa_mesh_to_polydata(const soa_mesh& mesh)
+{
+    return soa_views_to_polydata(std::vector<soa_view>(1, soa_mesh_view(mesh)));
+}
+
+vtkPolyData* soa_views_to_polydata(const std::vector<soa_view>& views)
+{
+    vtkIdType numPoints = 0;
+    vtkIdType numTriangles = 0;
+
+    // the normals only if every view with triangles has them
+    bool withNormals = true;
+
+    for (size_t v = 0; v < views.size(); v++)
+    {
+        numPoints += (vtkIdType) views[v].NumPoints;
+        numTriangles += (vtkIdType) views[v].NumTriangles;
+
+        if (views[v].NumTriangles > 0 && views[v].Normals == NULL)
+            withNormals = false;
+    }
+
+    vtkPolyData* polydata = vtkPolyData::New();
+
+    vtkFloatArray* coords = vtkFloatArray::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+
+    float* xyz = coords->GetPointer(0);
+
+    vtkIdTypeArray* cells = vtkIdTypeArray::New();
+    vtkIdType* ids = cells->WritePointer(0, 4 * numTriangles);
+
+    vtkFloatArray* normals = NULL;
+    float* values = NULL;
+
+    if (withNormals && numTriangles > 0)
+    {
+        normals = vtkFloatArray::New();
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(numTriangles);
+
+        values = normals->GetPointer(0);
+    }
+
+    // the point ids of a view come after the points of the views before it
+    vtkIdType firstPoint = 0;
+    vtkIdType firstTriangle = 0;
+
+    for (size_t v = 0; v < views.size(); v++)
+    {
+        const soa_view& view = views[v];
+
+        for (vtkIdType p = 0; p < (vtkIdType) view.NumPoints; p++)
+        {
+            xyz[3 * (firstPoint + p) + 0] = view.X[p];
+            xyz[3 * (firstPoint + p) + 1] = view.Y[p];
+            xyz[3 * (firstPoint + p) + 2] = view.Z[p];
+        }
+
+        for (vtkIdType t = 0; t < (vtkIdType) view.NumTriangles; t++)
+        {
+            vtkIdType* cell = ids + 4 * (firstTriangle + t);
+
+            cell[0] = 3;
+            cell[1] = firstPoint + view.Triangles[3 * t + 0];
+            cell[2] = firstPoint + view.Triangles[3 * t + 1];
+            cell[3] = firstPoint + view.Triangles[3 * t + 2];
+        }
+
+        for (vtkIdType n = 0; values != NULL && n < 3 * (vtkIdType) view.NumTriangles; n++)
+            values[3 * firstTriangle + n] = view.Normals[n];
+
+        firstPoint += (vtkIdType) view.NumPoints;
+        firstTriangle += (vtkIdType) view.NumTriangles;
+    }
+
+    vtkPoints* points = vtkPoints::New();
+    points->SetData(coords);
+    coords->Delete();
+
+    polydata->SetPoints(points);
+    points->Delete();
+
+    vtkCellArray* polys = vtkCellArray::New();
+    polys->SetCells(numTriangles, cells);
+    cells->Delete();
+
+    polydata->SetPolys(polys);
+    polys->Delete();
+
+    if (normals != NULL)
+    {
+        polydata->GetCellData()->SetNormals(normals);
+        normals->Delete();
+    }
+
+    return polydata;
+}
+
+soa_view soa_mesh_view(const soa_mesh& mesh)
+{
+    soa_view view;
+
+    view.NumPoints = soa_mesh_points(mesh);
+    view.NumTriangles = soa_mesh_triangles(mesh);
+    view.X = mesh.X.empty() ? NULL : &mesh.X[0];
+    view.Y = mesh.Y.empty() ? NULL : &mesh.Y[0];
+    view.Z = mesh.Z.empty() ? NULL : &mesh.Z[0];
+    view.Triangles = mesh.Triangles.empty() ? NULL : &mesh.Triangles[0];
+    view.Normals = mesh.Normals.empty() ? NULL : &mesh.Normals[0];
+
+    return view;
+}
+
+void send_soa_mesh(vtkMultiProcessController* controller, const soa_mesh& mesh, int remote,
+                   int tag)
+{
+    send_soa_view(controller, soa_mesh_view(mesh), remote, tag);
+}
+
+void send_soa_view(vtkMultiProcessController* controller, const soa_view& view, int remote,
+                   int tag)
+{
+    int counts[2];
+    counts[0] = (int) view.NumPoints;
+    counts[1] = (int) view.NumTriangles;
+
+    controller->Send(counts, 2, remote, tag);
+
+    if (counts[0] > 0)
+    {
+        controller->Send(view.X, counts[0], remote, tag);
+        controller->Send(view.Y, counts[0], remote, tag);
+        controller->Send(view.Z, counts[0], remote, tag);
+    }
+
+    if (counts[1] > 0)
+    {
+        // the ids go as ints, a mesh never has 2^31 points
+        controller->Send((const int*) view.Triangles, 3 * counts[1], remote, tag);
+        controller->Send(view.Normals, 3 * counts[1], remote, tag);
+    }
+}
+
+void receive_soa_mesh(vtkMultiProcessController* controller, soa_mesh& mesh, int remote,
+                      int tag)
+{
+    int counts[2];
+
+    controller->Receive(counts, 2, remote, tag);
+
+    mesh.X.resize(counts[0]);
+    mesh.Y.resize(counts[0]);
+    mesh.Z.resize(counts[0]);
+    mesh.Triangles.resize(3 * counts[1]);
+    mesh.Normals.resize(3 * counts[1]);
+
+    if (counts[0] > 0)
+    {
+        controller->Receive(&mesh.X[0], counts[0], remote, tag);
+        controller->Receive(&mesh.Y[0], counts[0], remote, tag);
+        controller->Receive(&mesh.Z[0], counts[0], remote, tag);
+    }
+
+    if (counts[1] > 0)
+    {
+        controller->Receive((int*) &mesh.Triangles[0], 3 * counts[1], remote, tag);
+        controller->Receive(&mesh.Normals[0], 3 * counts[1], remote, tag);
+    }
+}
+
+/**
+ * Writes the values of an array as they are in memory.
+*/
+template <class T>
+static bool save_array(FILE* file, const std::vector<T>& values)
+{
+    long long count = (long long) values.size();
+
+    if (fwrite(&count, sizeof(count), 1, file) != 1)
+        return false;
+
+    return count == 0 || fwrite(&values[0], sizeof(T), values.size(), file) == values.size();
+}
+
+/**
+ * Reads back an array written by save_array().
+*/
+template <class T>
+static bool load_array(FILE* file, std::vector<T>& values)
+{
+    long long count;
+
+    if (fread(&count, sizeof(count), 1, file) != 1 || count < 0)
+        return false;
+
+    values.resize(count);
+
+    return count == 0 || fread(&values[0], sizeof(T), values.size(), file) == values.size();
+}
+
+bool save_soa_mesh(const soa_mesh& mesh, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (file == NULL)
+        return false;
+
+    bool ok = save_array(file, mesh.X) && save_array(file, mesh.Y) &&
+              save_array(file, mesh.Z) && save_array(file, mesh.Triangles) &&
+              save_array(file, mesh.Normals);
+
+    return fclose(file) == 0 && ok;
+}
+
+bool load_soa_mesh(const std::string& path, soa_mesh& mesh)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL)
+    {
+        clear_soa_mesh(mesh);
+        return false;
+    }
+
+    bool ok = load_array(file, mesh.X) && load_array(file, mesh.Y) &&
+              load_array(file, mesh.Z) && load_array(file, mesh.Triangles) &&
+              load_array(file, mesh.Normals);
+
+    fclose(file);
+
+    if (!ok)
+        clear_soa_mesh(mesh);
+
+    return ok;
+}
+
+bool write_soa_mesh(const soa_mesh& mesh, const std::string& path)
+{
+    return write_soa_views(std::vector<soa_view>(1, soa_mesh_view(mesh)), path);
+}
+
+bool write_soa_views(const std::vector<soa_view>& views, const std::string& path)
+{
+    poly_stream* stream = poly_stream_open(path.c_str());
+
+    if (stream == NULL)
+        return false;
+
+    bool ok = true;
+
+    for (size_t v = 0; v < views.size(); v++)
+        ok = poly_stream_append_view(stream, views[v]) && ok;
+
+    return poly_stream_close(stream) && ok;
+}
@@ -0,0 +1,165 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file SoaMesh.h
+* @author Naoki Eto
+* @brief The triangle mesh of the engine, as structure of arrays: the X, Y
+*        and Z of the points in arrays of their own, the triangles as three
+*        32 bit point ids each in one flat array, and the cell normals
+*        packed three floats a triangle. It takes half the memory of a
+*        vtkPolyData with 64 bit vtkIdType connectivity, the count of
+*        every cell and its cell array offsets, and merging, sending or
+*        writing it goes through a few flat arrays rather than cell by
+*        cell. It is only turned into a vtkPolyData where VTK needs one.
+*/
+
+#ifndef SOAMESH_H
+#define SOAMESH_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class vtkMultiProcessController;
+class vtkPolyData;
+
+/**
+ * The points, triangles and cell normals of a mesh.
+*/
+typedef struct Soa_Mesh
+{
+    std::vector<float> X;
+    std::vector<float> Y;
+    std::vector<float> Z;
+    std::vector<uint32_t> Triangles;
+    std::vector<float> Normals;
+} soa_mesh;
+
+/**
+ * The arrays of a mesh kept somewhere else than in a soa_mesh (i.e. in a
+ * shared memory window, see NodeMerge.h), laid out like those of a
+ * soa_mesh, to be sent or written without going through one.
+*/
+typedef struct Soa_View
+{
+    long long NumPoints;
+    long long NumTriangles;
+    const float* X;
+    const float* Y;
+    const float* Z;
+    const uint32_t* Triangles;
+    const float* Normals;
+} soa_view;
+
+/**
+ * Returns the number of points of the mesh.
+*/
+long long soa_mesh_points(const soa_mesh& mesh);
+
+/**
+ * Returns the number of triangles of the mesh.
+*/
+long long soa_mesh_triangles(const soa_mesh& mesh);
+
+/**
+ * Returns the bytes the arrays of the mesh hold.
+*/
+unsigned long soa_mesh_bytes(const soa_mesh& mesh);
+
+/**
+ * Empties the mesh, keeping the memory of its arrays for the next one.
+*/
+void clear_soa_mesh(soa_mesh& mesh);
+
+/**
+ * Appends the points, triangles and normals of from to mesh, the point ids
+ * of from coming after the points already in mesh.
+*/
+void append_soa_mesh(soa_mesh& mesh, const soa_mesh& from);
+
+/**
+ * Computes the cell normals of the triangles from the first one on (the
+ * ones before already have theirs), from the order of their points.
+*/
+void compute_soa_normals(soa_mesh& mesh, long long firstTriangle);
+
+/**
+ * Returns a new vtkPolyData of the mesh, with its normals as the cell
+ * normals, which the caller has to Delete().
+*/
+vtkPolyData* soa_mesh_to_polydata(const soa_mesh& mesh);
+
+/**
+ * Returns a new vtkPolyData of the meshes of the views one after the
+ * other, like soa_mesh_to_polydata() of them appended but straight from
+ * where they are, which the caller has to Delete().
+*/
+vtkPolyData* soa_views_to_polydata(const std::vector<soa_view>& views);
+
+/**
+ * Returns a view of the arrays of the mesh, good until the mesh changes.
+*/
+soa_view soa_mesh_view(const soa_mesh& mesh);
+
+/**
+ * Sends the mesh to a process: its counts, then its arrays.
+*/
+void send_soa_mesh(vtkMultiProcessController* controller, const soa_mesh& mesh, int remote,
+                   int tag);
+
+/**
+ * Sends the arrays of a view to a process, like send_soa_mesh() does, to be
+ * received with receive_soa_mesh().
+*/
+void send_soa_view(vtkMultiProcessController* controller, const soa_view& view, int remote,
+                   int tag);
+
+/**
+ * Receives a mesh sent with send_soa_mesh() into mesh.
+*/
+void receive_soa_mesh(vtkMultiProcessController* controller, soa_mesh& mesh, int remote,
+                      int tag);
+
+/**
+ * Saves the arrays of the mesh as they are in memory, to be loaded back by
+ * the same machine. Returns false if the file could not be written.
+*/
+bool save_soa_mesh(const soa_mesh& mesh, const std::string& path);
+
+/**
+ * Loads a mesh saved with save_soa_mesh() into mesh. Returns false, with
+ * mesh empty, if the file could not be read.
+*/
+bool load_soa_mesh(const std::string& path, soa_mesh& mesh);
+
+/**
+ * Writes the mesh as a legacy binary vtk polydata file, straight from its
+ * arrays. Returns false if the file could not be written.
+*/
+bool write_soa_mesh(const soa_mesh& mesh, const std::string& path);
+
+/**
+ * Writes the meshes of the views one after the other as one polydata
+ * file, like write_soa_mesh() of them appended but straight from where
+ * they are. Returns false if the file could not be written.
+*/
+bool write_soa_views(const std::vector<soa_view>& views, const std::string& path);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StageTraceSummary.cxx
+* @author Naoki Eto
+* @brief Adds up the stages of the Chrome traces of the stage tracer.
+*/
+
+#include "StageTraceSummary.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Returns true if the file is a stage trace.
+*/
+static bool is_stage_trace(const std::string& name)
+{
+    return name.compare(0, 12, "stage_trace.") == 0;
+}
+
+/**
+ * Adds the seconds to the stage, adding the stage if it is new.
+*/
+static void add_stage(std::vector<std::string>& names, std::vector<double>& seconds,
+                      const std::string& name, double add)
+{
+    for (size_t s = 0; s < names.size(); s++)
+    {
+        if (names[s] == name)
+        {
+            seconds[s] += add;
+            return;
+        }
+    }
+
+    names.push_back(name);
+    seconds.push_back(add);
+}
+
+void remove_stage_traces(const std::string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+
+    if (dir == NULL)
+        return;
+
+    struct dirent* entry;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (is_stage_trace(entry->d_name))
+            remove((directory + "/" + entry->d_name).c_str());
+    }
+
+    closedir(dir);
+}
+
+bool read_stage_traces(const std::string& directory, std::vector<std::string>& names,
+                       std::vector<double>& seconds)
+{
+    DIR* dir = opendir(directory.c_str());
+
+    if (dir == NULL)
+        return false;
+
+    bool found = false;
+    struct dirent* entry;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!is_stage_trace(entry->d_name))
+            continue;
+
+        FILE* in = fopen((directory + "/" + entry->d_name).c_str(), "r");
+
+        if (in == NULL)
+            continue;
+
+        found = true;
+
+        // the tracer writes one event per line
+        char line[512];
+
+        while (fgets(line, sizeof(line), in) != NULL)
+        {
+            if (strstr(line, "\"ph\": \"X\"") == NULL)
+                continue;
+
+            char stage[64];
+            const char* dur = strstr(line, "\"dur\": ");
+            double microseconds;
+
+            if (sscanf(line, "{\"name\": \"%63[^\"]\"", stage) == 1 && dur != NULL &&
+                sscanf(dur + 7, "%lf", &microseconds) == 1)
+                add_stage(names, seconds, stage, microseconds / 1.0e6);
+        }
+
+        fclose(in);
+    }
+
+    closedir(dir);
+
+    return found;
+}
@@ -0,0 +1,49 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StageTraceSummary.h
+* @author Naoki Eto
+* @brief Reads back the stage traces (stage_trace.RANK.json) a run of a
+*        variant built with STAGE_TRACING leaves in its directory, for the
+*        tools that run the variants (the benchmark harness, the regression
+*        tests), and adds up the time of every stage.
+*/
+
+#ifndef STAGETRACESUMMARY_H
+#define STAGETRACESUMMARY_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Removes the stage traces in the directory, so that the next run does
+ * not add up the ones of the last run.
+*/
+void remove_stage_traces(const std::string& directory);
+
+/**
+ * Adds the time of every stage in the stage traces in the directory, over
+ * all the threads and processes, to seconds, adding the stages that are
+ * not in names yet. Returns false if there are none, when the variant was
+ * built without STAGE_TRACING.
+*/
+bool read_stage_traces(const std::string& directory, std::vector<std::string>& names,
+                       std::vector<double>& seconds);
+
+#endif
@@ -0,0 +1,232 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StageTracer.cxx
+* @author Naoki Eto
+* @brief Per-thread ring buffers of stages and their Chrome trace output.
+*        Empty unless built with STAGE_TRACING.
+*/
+
+#include "StageTracer.h"
+
+#ifdef STAGE_TRACING
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * One stage run by a thread.
+*/
+typedef struct Stage_Event
+{
+    const char* Stage;
+    double Begin;
+    double End;
+} stage_event;
+
+/**
+ * The ring buffer of one thread: its last Capacity stages, Next being
+ * where the next one goes.
+*/
+typedef struct Stage_Ring
+{
+    int ThreadId;
+    std::vector<stage_event> Events;
+    unsigned long Next;
+} stage_ring;
+
+static pthread_once_t TracerOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t RingKey;
+static pthread_mutex_t RingsMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<stage_ring*>* Rings = NULL;
+static std::vector<stage_ring*>* Retired = NULL;
+static int Rank = 0;
+
+/**
+ * Called when a thread with a ring buffer exits. The buffer keeps its 
+ * stages for the trace, and the next new thread carries on in it, so a
+ * program that makes threads over and over (the server of the pthreads 
+ * variant) does not grow a buffer per thread.
+*/
+static void retire_ring(void* ring)
+{
+    pthread_mutex_lock(&RingsMutex);
+
+    Retired->push_back((stage_ring*) ring);
+
+    pthread_mutex_unlock(&RingsMutex);
+}
+
+static void make_key()
+{
+    pthread_key_create(&RingKey, retire_ring);
+
+    Rings = new std::vector<stage_ring*>;
+    Retired = new std::vector<stage_ring*>;
+}
+
+/**
+ * Returns the ring buffer of the calling thread, taking the one of a
+ * thread that has exited, or making a new one, the first time.
+*/
+static stage_ring* thread_ring()
+{
+    pthread_once(&TracerOnce, make_key);
+
+    stage_ring* ring = (stage_ring*) pthread_getspecific(RingKey);
+
+    if (ring != NULL)
+        return ring;
+
+    pthread_mutex_lock(&RingsMutex);
+
+    if (!Retired->empty())
+    {
+        ring = Retired->back();
+        Retired->pop_back();
+    }
+
+    pthread_mutex_unlock(&RingsMutex);
+
+    if (ring != NULL)
+    {
+        pthread_setspecific(RingKey, ring);
+        return ring;
+    }
+
+    unsigned long capacity = 65536;
+
+    const char* events = getenv("STAGE_TRACE_EVENTS");
+
+    if (events != NULL && atol(events) > 0)
+        capacity = (unsigned long) atol(events);
+
+    ring = new stage_ring;
+    ring->Events.resize(capacity);
+    ring->Next = 0;
+
+    pthread_mutex_lock(&RingsMutex);
+
+    ring->ThreadId = (int) Rings->size();
+    Rings->push_back(ring);
+
+    pthread_mutex_unlock(&RingsMutex);
+
+    pthread_setspecific(RingKey, ring);
+
+    return ring;
+}
+
+double stage_tracer_now()
+{
+    struct timespec now;
+
+    // the real time clock, so that the ranks of a run line up
+    clock_gettime(CLOCK_REALTIME,&now);
+
+    return (double) now.tv_sec * 1.0e6 + (double) now.tv_nsec / 1.0e3;
+}
+
+void stage_tracer_record(const char* stage, double begin, double end)
+{
+    stage_ring* ring = thread_ring();
+
+    stage_event& event = ring->Events[ring->Next % ring->Events.size()];
+
+    event.Stage = stage;
+    event.Begin = begin;
+    event.End = end;
+
+    ring->Next++;
+}
+
+void stage_tracer_set_rank(int rank)
+{
+    Rank = rank;
+}
+
+bool stage_tracer_dump()
+{
+    pthread_once(&TracerOnce, make_key);
+
+    const char* pattern = getenv("STAGE_TRACE");
+
+    if (pattern == NULL || *pattern == '\0')
+        pattern = "stage_trace.%d.json";
+
+    // put the rank in place of "%d"
+    std::string path = pattern;
+    std::string::size_type at = path.find("%d");
+
+    if (at != std::string::npos)
+    {
+        char rank[16];
+
+        sprintf(rank, "%d", Rank);
+
+        path.replace(at, 2, rank);
+    }
+
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+                 "\"args\": {\"name\": \"rank %d\"}}", Rank, Rank);
+
+    pthread_mutex_lock(&RingsMutex);
+
+    for (size_t r = 0; r < Rings->size(); r++)
+    {
+        stage_ring* ring = (*Rings)[r];
+
+        unsigned long capacity = ring->Events.size();
+        unsigned long first = ring->Next > capacity ? ring->Next - capacity : 0;
+
+        for (unsigned long e = first; e < ring->Next; e++)
+        {
+            const stage_event& event = ring->Events[e % capacity];
+
+            fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                         "\"ts\": %.3f, \"dur\": %.3f}",
+                    event.Stage, Rank, ring->ThreadId, event.Begin, event.End - event.Begin);
+        }
+
+        if (first > 0)
+            fprintf(stderr, "Stage tracer: thread %d of rank %d lost its first %lu stages\n",
+                    ring->ThreadId, Rank, first);
+    }
+
+    pthread_mutex_unlock(&RingsMutex);
+
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StageTracer.h
+* @author Naoki Eto
+* @brief A small tracer of the stages of the programs (read, range,
+*        contour, normals, send, receive, append, write). Every thread
+*        records the stages it runs into a ring buffer of its own, and at
+*        the end every process writes its buffers as a Chrome trace (JSON),
+*        which chrome://tracing and Perfetto open, with the MPI rank as the
+*        process and the threads as threads.
+*
+*        Build with -DSTAGE_TRACING (cmake -DSTAGE_TRACING=ON) to trace;
+*        without it the macros below are empty and nothing is recorded. The
+*        trace goes to the file named by the STAGE_TRACE environment
+*        variable, in which "%d" is replaced by the rank (by default
+*        stage_trace.%d.json). Each thread keeps its last STAGE_TRACE_EVENTS
+*        stages (65536 by default).
+*
+*        TRACE_STAGE(contour); times from there to the end of the enclosing
+*        block; TRACE_BEGIN(write); ... TRACE_END(write); times the lines in
+*        between, for a stage whose results are used after it.
+*/
+
+#ifndef STAGETRACER_H
+#define STAGETRACER_H
+
+#ifdef STAGE_TRACING
+
+/**
+ * Returns the current time in microseconds.
+*/
+double stage_tracer_now();
+
+/**
+ * Records that the calling thread ran the stage from begin to end
+ * (microseconds).
+*/
+void stage_tracer_record(const char* stage, double begin, double end);
+
+/**
+ * Sets the rank of this process in the trace.
+*/
+void stage_tracer_set_rank(int rank);
+
+/**
+ * Writes the stages of every thread of this process to the trace file.
+ * Returns false if it cannot be written.
+*/
+bool stage_tracer_dump();
+
+/**
+ * Times a stage from where it is made to the end of the enclosing block.
+*/
+class StageScope
+{
+public:
+    StageScope(const char* stage) : Stage(stage), Begin(stage_tracer_now()) {}
+
+    ~StageScope() { stage_tracer_record(Stage, Begin, stage_tracer_now()); }
+
+private:
+    const char* Stage;
+    double Begin;
+};
+
+#define TRACE_STAGE(stage) StageScope stage##Scope(#stage)
+#define TRACE_BEGIN(stage) double stage##Begin = stage_tracer_now()
+#define TRACE_END(stage) stage_tracer_record(#stage, stage##Begin, stage_tracer_now())
+#define TRACE_SET_RANK(rank) stage_tracer_set_rank(rank)
+#define TRACE_DUMP() stage_tracer_dump()
+
+#else
+
+#define TRACE_STAGE(stage)
+#define TRACE_BEGIN(stage)
+#define TRACE_END(stage)
+#define TRACE_SET_RANK(rank)
+#define TRACE_DUMP()
+
+#endif
+
+#endif
@@ -0,0 +1,890 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StreamingContour.cxx
+* @author Naoki Eto
+* @brief Slab by slab contouring of legacy vtk rectilinear grid files.
+*/
+
+#include "StreamingContour.h"
+#include "MemoryAccounting.h"
+#include "PolyStreamWriter.h"
+#include "StageTracer.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <vtkContourFilter.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkRectilinearGrid.h>
+
+/**
+ * The header of the grid file, and where its "grad" values start.
+*/
+typedef struct Stream_Grid
+{
+    FILE* file;
+    bool Binary;
+    int Dims[3];
+    std::vector<float> X;
+    std::vector<float> Y;
+    std::vector<float> Z;
+    std::string Type;
+    int Components;
+    off_t DataStart;
+} stream_grid;
+
+/**
+ * Returns the size in bytes of a value of the legacy type, or 0 if the
+ * type is not known.
+*/
+static int type_size(const std::string& type)
+{
+    if (type == "unsigned_char" || type == "char")
+        return 1;
+    if (type == "short" || type == "unsigned_short")
+        return 2;
+    if (type == "int" || type == "unsigned_int" || type == "float")
+        return 4;
+    if (type == "long" || type == "unsigned_long" || type == "double" || type == "vtkIdType")
+        return 8;
+
+    return 0;
+}
+
+/**
+ * Reads the next line that is not blank. Returns false at the end of the
+ * file.
+*/
+static bool read_keyword_line(stream_grid& grid, std::string& line)
+{
+    char buffer[1024];
+
+    while (fgets(buffer, sizeof(buffer), grid.file) != NULL)
+    {
+        line = buffer;
+
+        size_t start = line.find_first_not_of(" \t\r\n");
+
+        if (start == std::string::npos)
+            continue;
+
+        size_t end = line.find_last_not_of(" \t\r\n");
+
+        line = line.substr(start, end - start + 1);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Reads the next ASCII value.
+*/
+static bool read_ascii_value(FILE* file, double& value)
+{
+    int c;
+
+    do
+        c = getc(file);
+    while (c != EOF && isspace(c));
+
+    char token[64];
+    int n = 0;
+
+    while (c != EOF && !isspace(c) && n < 63)
+    {
+        token[n++] = (char) c;
+        c = getc(file);
+    }
+
+    token[n] = '\0';
+
+    char* end;
+
+    value = strtod(token, &end);
+
+    return n > 0 && end != token;
+}
+
+/**
+ * Turns count big endian values of size bytes into the byte order of this
+ * machine.
+*/
+static void from_big_endian(void* values, int size, size_t count)
+{
+    const uint16_t one = 1;
+
+    if (*(const unsigned char*) &one == 0)
+        return;
+
+    unsigned char* bytes = (unsigned char*) values;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int b = 0; b < size / 2; b++)
+        {
+            unsigned char swap = bytes[i * size + b];
+            bytes[i * size + b] = bytes[i * size + size - 1 - b];
+            bytes[i * size + size - 1 - b] = swap;
+        }
+    }
+}
+
+/**
+ * Reads count values of the type (float or double) into values.
+*/
+static bool read_values(stream_grid& grid, const std::string& type, float* values, size_t count)
+{
+    if (!grid.Binary)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            double value;
+
+            if (!read_ascii_value(grid.file, value))
+                return false;
+
+            values[i] = (float) value;
+        }
+
+        return true;
+    }
+
+    if (type == "float")
+    {
+        if (fread(values, sizeof(float), count, grid.file) != count)
+            return false;
+
+        from_big_endian(values, sizeof(float), count);
+
+        return true;
+    }
+
+    if (type == "double")
+    {
+        double chunk[4096];
+
+        for (size_t done = 0; done < count; )
+        {
+            size_t n = count - done < 4096 ? count - done : 4096;
+
+            if (fread(chunk, sizeof(double), n, grid.file) != n)
+                return false;
+
+            from_big_endian(chunk, sizeof(double), n);
+
+            for (size_t i = 0; i < n; i++)
+                values[done + i] = (float) chunk[i];
+
+            done += n;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Skips count values of the type.
+*/
+static bool skip_values(stream_grid& grid, const std::string& type, long long count)
+{
+    if (!grid.Binary)
+    {
+        double value;
+
+        for (long long i = 0; i < count; i++)
+        {
+            if (!read_ascii_value(grid.file, value))
+                return false;
+        }
+
+        return true;
+    }
+
+    int size = type_size(type);
+
+    return size > 0 && fseeko(grid.file, (off_t) (count * size), SEEK_CUR) == 0;
+}
+
+/**
+ * Reads the coordinates that follow an X_COORDINATES, Y_COORDINATES or
+ * Z_COORDINATES line.
+*/
+static bool read_coordinates(stream_grid& grid, std::istringstream& words,
+                             std::vector<float>& coords)
+{
+    long long n;
+    std::string type;
+
+    if (!(words >> n >> type) || n < 1)
+        return false;
+
+    coords.resize(n);
+
+    return read_values(grid, type, &coords[0], n);
+}
+
+/**
+ * Goes through the arrays of a FIELD, skipping them until "grad". Returns
+ * true with found set if "grad" is the next thing in the file.
+*/
+static bool read_field(stream_grid& grid, int numArrays, bool& found)
+{
+    found = false;
+
+    for (int a = 0; a < numArrays; a++)
+    {
+        std::string line;
+
+        if (!read_keyword_line(grid, line))
+            return false;
+
+        std::istringstream words(line);
+        std::string name, type;
+        int components;
+        long long tuples;
+
+        if (!(words >> name >> components >> tuples >> type))
+            return false;
+
+        if (name == "grad")
+        {
+            grid.Type = type;
+            grid.Components = components;
+            found = true;
+            return true;
+        }
+
+        if (!skip_values(grid, type, (long long) components * tuples))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reads the header of the grid in grid.file up to the "grad" values of its
+ * point data. Returns false if it is not a rectilinear grid file with a
+ * float or double "grad" point array.
+*/
+static bool read_header(stream_grid& grid)
+{
+    char title[1024];
+    std::string line;
+
+    // version line, title, and ASCII or BINARY
+    if (fgets(title, sizeof(title), grid.file) == NULL || strncmp(title, "# vtk", 5) != 0 ||
+        fgets(title, sizeof(title), grid.file) == NULL ||
+        !read_keyword_line(grid, line))
+        return false;
+
+    grid.Binary = line == "BINARY";
+
+    long long numPoints = -1;
+    bool found = false;
+
+    grid.Dims[0] = grid.Dims[1] = grid.Dims[2] = 0;
+
+    while (!found && read_keyword_line(grid, line))
+    {
+        std::istringstream words(line);
+        std::string keyword;
+
+        words >> keyword;
+
+        if (keyword == "DATASET")
+        {
+            std::string type;
+
+            if (!(words >> type) || type != "RECTILINEAR_GRID")
+                return false;
+        }
+        else if (keyword == "DIMENSIONS")
+        {
+            if (!(words >> grid.Dims[0] >> grid.Dims[1] >> grid.Dims[2]))
+                return false;
+        }
+        else if (keyword == "X_COORDINATES")
+        {
+            if (!read_coordinates(grid, words, grid.X))
+                return false;
+        }
+        else if (keyword == "Y_COORDINATES")
+        {
+            if (!read_coordinates(grid, words, grid.Y))
+                return false;
+        }
+        else if (keyword == "Z_COORDINATES")
+        {
+            if (!read_coordinates(grid, words, grid.Z))
+                return false;
+        }
+        else if (keyword == "FIELD")
+        {
+            std::string name;
+            int numArrays;
+
+            if (!(words >> name >> numArrays) || !read_field(grid, numArrays, found))
+                return false;
+
+            // a "grad" in the field data of the dataset is not point data
+            if (found && numPoints < 0)
+                return false;
+        }
+        else if (keyword == "POINT_DATA")
+        {
+            if (!(words >> numPoints))
+                return false;
+        }
+        else if (keyword == "SCALARS" && numPoints >= 0)
+        {
+            std::string name, type;
+            int components = 1;
+
+            if (!(words >> name >> type))
+                return false;
+
+            words >> components;
+
+            // the lookup table line
+            if (!read_keyword_line(grid, line))
+                return false;
+
+            found = name == "grad";
+
+            if (found)
+            {
+                grid.Type = type;
+                grid.Components = components;
+            }
+            else if (!skip_values(grid, type, numPoints * components))
+                return false;
+        }
+        else if ((keyword == "VECTORS" || keyword == "NORMALS" || keyword == "TENSORS") &&
+                 numPoints >= 0)
+        {
+            std::string name, type;
+            int components = keyword == "TENSORS" ? 9 : 3;
+
+            if (!(words >> name >> type))
+                return false;
+
+            found = name == "grad";
+
+            if (found)
+            {
+                grid.Type = type;
+                grid.Components = components;
+            }
+            else if (!skip_values(grid, type, numPoints * components))
+                return false;
+        }
+        else
+        {
+            // CELL_DATA and the attributes this reader does not know
+            return false;
+        }
+    }
+
+    if (!found || (grid.Type != "float" && grid.Type != "double") ||
+        grid.Dims[0] < 1 || grid.Dims[1] < 1 || grid.Dims[2] < 1 ||
+        (int) grid.X.size() != grid.Dims[0] || (int) grid.Y.size() != grid.Dims[1] ||
+        (int) grid.Z.size() != grid.Dims[2] ||
+        numPoints != (long long) grid.Dims[0] * grid.Dims[1] * grid.Dims[2])
+        return false;
+
+    grid.DataStart = ftello(grid.file);
+
+    return true;
+}
+
+/**
+ * Opens the grid file and reads its header (see read_header).
+*/
+static bool open_grid(const char* path, stream_grid& grid)
+{
+    grid.file = fopen(path, "rb");
+
+    return grid.file != NULL && read_header(grid);
+}
+
+bool read_grid_header(const char* path, int dims[3], std::vector<float> coords[3])
+{
+    stream_grid grid;
+    grid.file = NULL;
+
+    bool ok = open_grid(path, grid);
+
+    if (grid.file != NULL)
+        fclose(grid.file);
+
+    if (!ok)
+        return false;
+
+    for (int a = 0; a < 3; a++)
+        dims[a] = grid.Dims[a];
+
+    coords[0].swap(grid.X);
+    coords[1].swap(grid.Y);
+    coords[2].swap(grid.Z);
+
+    return true;
+}
+
+/**
+ * Reads all the "grad" values of the grid, a chunk of tuples at a time,
+ * keeping the scalar of every tuple (a component, or the magnitude if
+ * component is -1) and its range while the chunk is still in the cache.
+*/
+static bool read_scalars(stream_grid& grid, int component, grid_scalars& scalars)
+{
+    const size_t chunk = 4096;
+
+    int numComponents = grid.Components;
+    size_t numPoints = (size_t) grid.Dims[0] * grid.Dims[1] * grid.Dims[2];
+
+    std::vector<float> raw(chunk * numComponents);
+
+    scalars.Values.resize(numPoints);
+    scalars.Range[0] = 1.0e300;
+    scalars.Range[1] = -1.0e300;
+
+    for (size_t done = 0; done < numPoints; )
+    {
+        size_t n = numPoints - done < chunk ? numPoints - done : chunk;
+
+        if (!read_values(grid, grid.Type, &raw[0], n * numComponents))
+            return false;
+
+        float* values = &scalars.Values[done];
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const float* tuple = &raw[i * numComponents];
+            float value;
+
+            if (component < 0)
+            {
+                double sum = 0.0;
+
+                for (int c = 0; c < numComponents; c++)
+                    sum += (double) tuple[c] * tuple[c];
+
+                value = (float) sqrt(sum);
+            }
+            else
+            {
+                value = tuple[component];
+            }
+
+            values[i] = value;
+
+            if (value < scalars.Range[0])
+                scalars.Range[0] = value;
+            if (value > scalars.Range[1])
+                scalars.Range[1] = value;
+        }
+
+        done += n;
+    }
+
+    return true;
+}
+
+/**
+ * Reads the header and the scalars of the grid in grid.file, and closes it.
+*/
+static bool read_grid_scalars(stream_grid& grid, int component, grid_scalars& scalars)
+{
+    TRACE_STAGE(parse);
+
+    bool ok = read_header(grid) && component < grid.Components &&
+              read_scalars(grid, component, scalars);
+
+    fclose(grid.file);
+
+    if (!ok)
+        return false;
+
+    for (int a = 0; a < 3; a++)
+        scalars.Dims[a] = grid.Dims[a];
+
+    scalars.Coords[0].swap(grid.X);
+    scalars.Coords[1].swap(grid.Y);
+    scalars.Coords[2].swap(grid.Z);
+
+    MEMORY_RECORD(parse, grid_scalars_bytes(scalars));
+
+    return true;
+}
+
+bool load_grid_scalars(const char* path, int component, grid_scalars& scalars)
+{
+    stream_grid grid;
+    grid.file = fopen(path, "rb");
+
+    return grid.file != NULL && read_grid_scalars(grid, component, scalars);
+}
+
+bool parse_grid_scalars(const char* data, unsigned long size, int component,
+                        grid_scalars& scalars)
+{
+    if (data == NULL || size == 0)
+        return false;
+
+    stream_grid grid;
+    grid.file = fmemopen((void*) data, size, "rb");
+
+    return grid.file != NULL && read_grid_scalars(grid, component, scalars);
+}
+
+/**
+ * Fills kept with every stride-th index of an axis of count points, and
+ * the last one.
+*/
+static void stride_axis(int count, int stride, std::vector<int>& kept)
+{
+    kept.clear();
+
+    for (int i = 0; i < count; i += stride)
+        kept.push_back(i);
+
+    if (count > 0 && kept.back() != count - 1)
+        kept.push_back(count - 1);
+}
+
+void stride_grid_scalars(grid_scalars& scalars, int stride)
+{
+    if (stride <= 1)
+        return;
+
+    TRACE_STAGE(stride);
+
+    std::vector<int> kept[3];
+
+    for (int a = 0; a < 3; a++)
+    {
+        stride_axis(scalars.Dims[a], stride, kept[a]);
+
+        for (size_t i = 0; i < kept[a].size(); i++)
+            scalars.Coords[a][i] = scalars.Coords[a][kept[a][i]];
+
+        scalars.Coords[a].resize(kept[a].size());
+    }
+
+    size_t nx = scalars.Dims[0];
+    size_t nxy = nx * scalars.Dims[1];
+
+    scalars.Range[0] = 1.0e300;
+    scalars.Range[1] = -1.0e300;
+
+    // every point kept is at or after the one it goes to, so the values
+    // can be moved down in place
+    size_t to = 0;
+
+    for (size_t k = 0; k < kept[2].size(); k++)
+        for (size_t j = 0; j < kept[1].size(); j++)
+            for (size_t i = 0; i < kept[0].size(); i++)
+            {
+                float value = scalars.Values[kept[2][k] * nxy + kept[1][j] * nx + kept[0][i]];
+
+                scalars.Values[to++] = value;
+
+                if (value < scalars.Range[0])
+                    scalars.Range[0] = value;
+                if (value > scalars.Range[1])
+                    scalars.Range[1] = value;
+            }
+
+    scalars.Values.resize(to);
+
+    for (int a = 0; a < 3; a++)
+        scalars.Dims[a] = (int) kept[a].size();
+}
+
+unsigned long long grid_scalars_bytes(const grid_scalars& scalars)
+{
+    return (unsigned long long) (scalars.Values.size() + scalars.Coords[0].size() +
+                                 scalars.Coords[1].size() + scalars.Coords[2].size()) *
+           sizeof(float);
+}
+
+/**
+ * Reads the next Z-plane of "grad" and keeps its first component in plane.
+*/
+static bool read_plane(stream_grid& grid, std::vector<float>& raw, float* plane)
+{
+    TRACE_STAGE(read);
+
+    size_t values = (size_t) grid.Dims[0] * grid.Dims[1];
+
+    if (!read_values(grid, grid.Type, &raw[0], values * grid.Components))
+        return false;
+
+    for (size_t i = 0; i < values; i++)
+        plane[i] = raw[i * grid.Components];
+
+    MEMORY_RECORD(read, values * grid.Components * sizeof(float));
+
+    return true;
+}
+
+/**
+ * Returns the seconds since t0.
+*/
+static double seconds_since(const struct timespec& t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_REALTIME,&t1);
+
+    return (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+}
+
+/**
+ * Finds the range of the first component of "grad", two planes' worth of
+ * memory at a time, and goes back to the start of the values.
+*/
+static bool scan_range(stream_grid& grid, std::vector<float>& raw,
+                       std::vector<float>& plane, double range[2])
+{
+    TRACE_STAGE(range);
+
+    range[0] = 1.0e300;
+    range[1] = -1.0e300;
+
+    for (int k = 0; k < grid.Dims[2]; k++)
+    {
+        if (!read_plane(grid, raw, &plane[0]))
+            return false;
+
+        for (size_t i = 0; i < plane.size(); i++)
+        {
+            if (plane[i] < range[0])
+                range[0] = plane[i];
+            if (plane[i] > range[1])
+                range[1] = plane[i];
+        }
+    }
+
+    return fseeko(grid.file, grid.DataStart, SEEK_SET) == 0;
+}
+
+/**
+ * Returns a float array with the values.
+*/
+static vtkFloatArray* coordinate_array(const float* values, int count)
+{
+    vtkFloatArray* array = vtkFloatArray::New();
+
+    array->SetNumberOfTuples(count);
+
+    for (int i = 0; i < count; i++)
+        array->SetValue(i, values[i]);
+
+    return array;
+}
+
+int stream_contour_file(const char* inFile, const char* outFile, int numValues,
+                        const double* range, stream_stats* stats)
+{
+    stream_stats local;
+
+    if (stats == NULL)
+        stats = &local;
+
+    memset(stats, 0, sizeof(stream_stats));
+
+    stream_grid grid;
+    grid.file = NULL;
+
+    if (!open_grid(inFile, grid))
+    {
+        if (grid.file != NULL)
+            fclose(grid.file);
+
+        return -1;
+    }
+
+    int nx = grid.Dims[0];
+    int ny = grid.Dims[1];
+    size_t planeSize = (size_t) nx * ny;
+
+    stats->Dims[0] = nx;
+    stats->Dims[1] = ny;
+    stats->Dims[2] = grid.Dims[2];
+    stats->PlaneBytes = (long long) planeSize * (grid.Components + 2) * sizeof(float);
+
+    std::vector<float> raw(planeSize * grid.Components);
+    std::vector<float> plane(planeSize);
+
+    struct timespec t0;
+
+    clock_gettime(CLOCK_REALTIME,&t0);
+
+    if (range != NULL)
+    {
+        stats->Range[0] = range[0];
+        stats->Range[1] = range[1];
+    }
+    else if (!scan_range(grid, raw, plane, stats->Range))
+    {
+        fclose(grid.file);
+        return -1;
+    }
+
+    stats->ScanSeconds = seconds_since(t0);
+
+    clock_gettime(CLOCK_REALTIME,&t0);
+
+    // a grid of two Z-planes, whose values and Z coordinates move up the
+    // file slab by slab
+    vtkRectilinearGrid* slab = vtkRectilinearGrid::New();
+    slab->SetDimensions(nx, ny, 2);
+
+    vtkFloatArray* x = coordinate_array(&grid.X[0], nx);
+    vtkFloatArray* y = coordinate_array(&grid.Y[0], ny);
+    vtkFloatArray* z = coordinate_array(&grid.Z[0], 2);
+
+    slab->SetXCoordinates(x);
+    slab->SetYCoordinates(y);
+    slab->SetZCoordinates(z);
+
+    vtkFloatArray* scalars = vtkFloatArray::New();
+    scalars->SetName("grad");
+    scalars->SetNumberOfTuples(2 * planeSize);
+
+    slab->GetPointData()->SetScalars(scalars);
+
+    float* planes = scalars->GetPointer(0);
+
+    vtkContourFilter* contour = vtkContourFilter::New();
+
+    // name of array is "grad"
+    contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+
+    // better than setinput
+    contour->SetInputConnection(slab->GetProducerPort());
+
+    contour->GenerateValues(numValues, stats->Range);
+
+    contour->ComputeNormalsOn();
+
+    // calc cell normal
+    vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
+
+    triangleCellNormals->SetInputConnection(contour->GetOutputPort());
+
+    triangleCellNormals->ComputeCellNormalsOn();
+    triangleCellNormals->ComputePointNormalsOff();
+    triangleCellNormals->ConsistencyOn();
+    triangleCellNormals->AutoOrientNormalsOn();
+
+    poly_stream* writer = poly_stream_open(outFile);
+
+    bool ok = writer != NULL && read_plane(grid, raw, planes);
+
+    for (int k = 1; ok && k < grid.Dims[2]; k++)
+    {
+        // the upper plane of the last slab is the lower plane of this one
+        if (k > 1)
+            memcpy(planes, planes + planeSize, planeSize * sizeof(float));
+
+        ok = read_plane(grid, raw, planes + planeSize);
+
+        if (!ok)
+            break;
+
+        z->SetValue(0, grid.Z[k - 1]);
+        z->SetValue(1, grid.Z[k]);
+
+        z->Modified();
+        scalars->Modified();
+        slab->Modified();
+
+        TRACE_BEGIN(contour);
+
+        contour->Update();
+
+        TRACE_END(contour);
+
+        MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+        TRACE_BEGIN(normals);
+
+        triangleCellNormals->Update(); // creates vtkPolyData
+
+        TRACE_END(normals);
+
+        vtkPolyData* piece = triangleCellNormals->GetOutput();
+
+        // only one slab is held at a time
+        MEMORY_RECORD_DATA(normals, piece);
+
+        stats->Slabs++;
+        stats->Triangles += piece->GetNumberOfPolys();
+
+        TRACE_BEGIN(write);
+
+        ok = poly_stream_append(writer, piece);
+
+        TRACE_END(write);
+    }
+
+    if (writer != NULL)
+    {
+        TRACE_STAGE(write);
+
+        ok = poly_stream_close(writer) && ok;
+    }
+
+    triangleCellNormals->Delete();
+    contour->Delete();
+    scalars->Delete();
+    x->Delete();
+    y->Delete();
+    z->Delete();
+    slab->Delete();
+
+    fclose(grid.file);
+
+    // no half written surfaces
+    if (!ok)
+        remove(outFile);
+
+    stats->ContourSeconds = seconds_since(t0);
+
+    return ok ? 0 : -1;
+}
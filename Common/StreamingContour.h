@@ -0,0 +1,126 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file StreamingContour.h
+* @author Naoki Eto
+* @brief Out-of-core contouring of a legacy vtk rectilinear grid file that
+*        may not fit in memory. The POINT_DATA section is read two Z-planes
+*        at a time: each slab of cells between two planes is contoured
+*        (vtkContourFilter and vtkPolyDataNormals on a grid of only those
+*        two planes) as soon as both planes are in, and its triangles are
+*        handed to a PolyStreamWriter right away. Only two planes of the
+*        "grad" array (its first component, which is what the contour runs
+*        on) are ever in memory, so memory goes with nx*ny instead of
+*        nx*ny*nz.
+*
+*        The contour values are spread over the range of the array like
+*        GenerateValues does. Unless the range is given, it takes an extra
+*        pass over the file to find it, again two planes at a time.
+*
+*        The surface is the same as contouring the whole grid, except that
+*        the points on the planes between slabs are written once per slab,
+*        like they are between blocks, and that the normals are oriented
+*        slab by slab.
+*
+*        The same reader also loads a whole grid for the contour kernel
+*        (see grid_scalars): the scalar the kernel contours is picked out of
+*        "grad", and its range found, as the values are parsed, so the
+*        block is gone through once rather than parsed into a vtk grid and
+*        gone through again for the range.
+*/
+
+#ifndef STREAMINGCONTOUR_H
+#define STREAMINGCONTOUR_H
+
+#include <vector>
+
+/**
+ * What the streaming contour did.
+*/
+typedef struct Stream_Stats
+{
+    int Dims[3];
+    int Slabs;
+    long long Triangles;
+    long long PlaneBytes;
+    double Range[2];
+    double ScanSeconds;
+    double ContourSeconds;
+} stream_stats;
+
+/**
+ * Contours the "grad" array of the rectilinear grid file with numValues
+ * values over range (or over the range of the array if range is NULL),
+ * and writes the cell normals of the surface to outFile, slab by slab.
+ * stats may be NULL. Returns -1 if the file cannot be read or the output
+ * cannot be written.
+*/
+int stream_contour_file(const char* inFile, const char* outFile, int numValues,
+                        const double* range, stream_stats* stats);
+
+/**
+ * The scalar of every point of a grid, picked out of "grad" when it was
+ * read, with the range of the values and the coordinates of the grid.
+*/
+typedef struct Grid_Scalars
+{
+    int Dims[3];
+    std::vector<float> Coords[3];
+    std::vector<float> Values;
+    double Range[2];
+} grid_scalars;
+
+/**
+ * Reads the rectilinear grid file and keeps, for every point, the component
+ * of "grad" (or its magnitude if component is -1, like vtkDataArray's
+ * GetRange) along with the range of those values, in one pass over the
+ * values. The values of scalars are reused, so a grid_scalars kept from one
+ * file to the next only allocates for a bigger grid. Returns false if the
+ * file cannot be read or "grad" does not have the component.
+*/
+bool load_grid_scalars(const char* path, int component, grid_scalars& scalars);
+
+/**
+ * Same as load_grid_scalars, from the size bytes of a grid file in memory
+ * (i.e. the buffer of the block loader).
+*/
+bool parse_grid_scalars(const char* data, unsigned long size, int component,
+                        grid_scalars& scalars);
+
+/**
+ * Keeps only every stride-th point of the grid along each axis, and the
+ * last one, so that the grid still covers the whole block, like
+ * stride_block() does to a vtk grid; the range is that of the points
+ * kept. A stride of 1 leaves the grid as it is.
+*/
+void stride_grid_scalars(grid_scalars& scalars, int stride);
+
+/**
+ * Returns the bytes held by the values and the coordinates.
+*/
+unsigned long long grid_scalars_bytes(const grid_scalars& scalars);
+
+/**
+ * Reads only the dimensions and the X, Y and Z coordinates of a rectilinear
+ * grid file with a "grad" point array, stopping where its values start.
+ * Returns false if the file cannot be read.
+*/
+bool read_grid_header(const char* path, int dims[3], std::vector<float> coords[3]);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file SurfaceCache.cxx
+* @author Naoki Eto
+* @brief Cache of contoured surfaces per file and contour value.
+*/
+
+#include "SurfaceCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkPolyDataWriter.h>
+
+surface_cache* surface_cache_create(cache_budget* budget, const char* directory)
+{
+    surface_cache* cache = new surface_cache;
+
+    if (directory != NULL)
+        cache->Directory = directory;
+
+    cache->Bytes = 0;
+    cache->Budget = budget;
+    cache->Hits = 0;
+    cache->DiskHits = 0;
+    cache->Misses = 0;
+
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    return cache;
+}
+
+/**
+ * Returns the name of the surface on disk. The path of the file is
+ * escaped like in a URL ('%' and '/' as %25 and %2F), so that no two files
+ * share a name, and the contour value is written with all of its bits, so
+ * that it comes back exactly.
+*/
+static std::string disk_name(const surface_cache* cache, const std::string& file, double value)
+{
+    std::string name;
+
+    for (std::string::size_type c = 0; c < file.size(); c++)
+    {
+        if (file[c] == '%')
+            name += "%25";
+        else if (file[c] == '/')
+            name += "%2F";
+        else
+            name += file[c];
+    }
+
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    char buf[32];
+    sprintf(buf, ".%016llx.vtk", bits);
+
+    return cache->Directory + "/" + name + buf;
+}
+
+/**
+ * Puts the surface in memory and drops the least recently used surfaces
+ * while the caches charged to the budget are over it. The mutex must be
+ * held.
+*/
+static void remember(surface_cache* cache, const surface_key& key, vtkPolyData* surface)
+{
+    if (cache->Entries.find(key) != cache->Entries.end())
+        return;
+
+    surface_entry entry;
+
+    entry.surface = surface;
+    surface->Register(NULL);
+
+    // GetActualMemorySize is in kilobytes
+    entry.Bytes = surface->GetActualMemorySize() * 1024;
+
+    cache->Order.push_front(key);
+    entry.Use = cache->Order.begin();
+
+    cache->Entries[key] = entry;
+    cache->Bytes += entry.Bytes;
+
+    bool over = cache_budget_charge(cache->Budget, (long) entry.Bytes);
+
+    while (over && cache->Order.size() > 1)
+    {
+        std::map<surface_key, surface_entry>::iterator oldest =
+            cache->Entries.find(cache->Order.back());
+
+        cache->Bytes -= oldest->second.Bytes;
+
+        over = cache_budget_charge(cache->Budget, -(long) oldest->second.Bytes);
+        oldest->second.surface->Delete();
+
+        cache->Order.pop_back();
+        cache->Entries.erase(oldest);
+    }
+}
+
+vtkPolyData* surface_cache_find(surface_cache* cache, const std::string& file, double value)
+{
+    surface_key key(file, value);
+
+    pthread_mutex_lock(&cache->mutex);
+
+    std::map<surface_key, surface_entry>::iterator found = cache->Entries.find(key);
+
+    if (found != cache->Entries.end())
+    {
+        cache->Order.splice(cache->Order.begin(), cache->Order, found->second.Use);
+
+        vtkPolyData* surface = found->second.surface;
+        surface->Register(NULL);
+
+        cache->Hits++;
+
+        pthread_mutex_unlock(&cache->mutex);
+
+        return surface;
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (!cache->Directory.empty())
+    {
+        std::string name = disk_name(cache, file, value);
+
+        if (access(name.c_str(), R_OK) == 0)
+        {
+            vtkPolyDataReader *reader = vtkPolyDataReader::New();
+
+            reader->SetFileName(name.c_str());
+            reader->Update();
+
+            vtkPolyData* surface = vtkPolyData::New();
+            surface->ShallowCopy(reader->GetOutput());
+            reader->Delete();
+
+            pthread_mutex_lock(&cache->mutex);
+            cache->DiskHits++;
+            remember(cache, key, surface);
+            pthread_mutex_unlock(&cache->mutex);
+
+            return surface;
+        }
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    cache->Misses++;
+    pthread_mutex_unlock(&cache->mutex);
+
+    return NULL;
+}
+
+void surface_cache_store(surface_cache* cache, const std::string& file, double value,
+                         vtkPolyData* surface)
+{
+    if (!cache->Directory.empty())
+    {
+        std::string name = disk_name(cache, file, value);
+
+        // write under a temporary name first, so that a reader never sees
+        // half a file
+        std::string partial = name + ".part";
+
+        vtkPolyDataWriter *writer = vtkPolyDataWriter::New();
+
+        writer->SetFileName(partial.c_str());
+        writer->SetInput(surface);
+        writer->SetFileTypeToBinary();
+        writer->Write();
+        writer->Delete();
+
+        rename(partial.c_str(), name.c_str());
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    remember(cache, surface_key(file, value), surface);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void generate_values(int numContours, const double range[2], std::vector<double>& values)
+{
+    values.clear();
+
+    if (numContours == 1)
+    {
+        values.push_back((range[0] + range[1]) / 2.0);
+        return;
+    }
+
+    double incr = (range[1] - range[0]) / (numContours - 1);
+
+    double value = range[0];
+
+    for (int i = 0; i < numContours; i++, value += incr)
+        values.push_back(value);
+}
+
+void surface_cache_destroy(surface_cache* cache)
+{
+    std::map<surface_key, surface_entry>::iterator it;
+
+    for (it = cache->Entries.begin(); it != cache->Entries.end(); ++it)
+        it->second.surface->Delete();
+
+    cache_budget_charge(cache->Budget, -(long) cache->Bytes);
+
+    pthread_mutex_destroy(&cache->mutex);
+
+    delete cache;
+}
@@ -0,0 +1,113 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file SurfaceCache.h
+* @author Naoki Eto
+* @brief A cache of contoured surfaces, one vtk polydata per file and
+*        contour value, so that a new set of contour values only needs the
+*        values that were not contoured before. Surfaces are kept in memory
+*        under a budget, which may be shared with the block cache (see
+*        cache_budget in BlockCache.h; least recently used ones are dropped
+*        first) and,
+*        if a directory is given, also written to disk so that they outlive
+*        the program. It can be used from several threads at the same time.
+*/
+
+#ifndef SURFACECACHE_H
+#define SURFACECACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+#include "BlockCache.h"
+
+class vtkPolyData;
+
+/**
+ * A surface is known by its file and its contour value.
+*/
+typedef std::pair<std::string, double> surface_key;
+
+/**
+ * One surface in memory, with its size and its place in the least
+ * recently used order.
+*/
+typedef struct Surface_Cache_Entry
+{
+    vtkPolyData* surface;
+    unsigned long Bytes;
+    std::list<surface_key>::iterator Use;
+} surface_entry;
+
+/**
+ * The cache itself. Most recently used surfaces are at the front of Order.
+ * Directory is empty when surfaces are only kept in memory. Bytes is what
+ * it holds in memory, charged to Budget.
+*/
+typedef struct Surface_Cache
+{
+    std::map<surface_key, surface_entry> Entries;
+    std::list<surface_key> Order;
+    std::string Directory;
+    unsigned long Bytes;
+    cache_budget* Budget;
+    long Hits;
+    long DiskHits;
+    long Misses;
+    pthread_mutex_t mutex;
+} surface_cache;
+
+/**
+ * Creates an empty cache whose surfaces in memory are charged to budget,
+ * which it does not own. directory may be NULL to not keep surfaces on
+ * disk.
+*/
+surface_cache* surface_cache_create(cache_budget* budget, const char* directory);
+
+/**
+ * Returns the surface of the file at the contour value, from memory or
+ * else from disk, or NULL if it was never contoured. The returned surface
+ * carries a reference for the caller, who has to Delete() it.
+*/
+vtkPolyData* surface_cache_find(surface_cache* cache, const std::string& file, double value);
+
+/**
+ * Keeps the surface of the file at the contour value, in memory and on
+ * disk. The cache takes its own reference to the surface.
+*/
+void surface_cache_store(surface_cache* cache, const std::string& file, double value,
+                         vtkPolyData* surface);
+
+/**
+ * Fills values with the contour values vtkContourFilter::GenerateValues
+ * would use for numContours values over the range.
+*/
+void generate_values(int numContours, const double range[2], std::vector<double>& values);
+
+/**
+ * Drops every surface from memory (not from disk) and frees the cache.
+*/
+void surface_cache_destroy(surface_cache* cache);
+
+#endif
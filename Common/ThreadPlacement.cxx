@@ -0,0 +1,364 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ThreadPlacement.cxx
+* @author Naoki Eto
+* @brief Pinning of the processes and worker threads of the engine to
+*        cpus and NUMA nodes, read from sysfs.
+*/
+
+#include "ThreadPlacement.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+/**
+ * The names of the placements, in the order of placement_mode.
+*/
+static const char* PlacementNames[] = { "none", "cores", "numa" };
+
+bool parse_placement_mode(const std::string& name, placement_mode& mode)
+{
+    for (int m = 0; m < 3; m++)
+    {
+        if (name == PlacementNames[m])
+        {
+            mode = (placement_mode) m;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* placement_mode_name(placement_mode mode)
+{
+    return PlacementNames[mode];
+}
+
+/**
+ * Reads a cpu list of sysfs (i.e. "0-3,8-11") into cpus.
+*/
+static void read_cpu_list(const char* path, std::vector<int>& cpus)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+        return;
+
+    char line[4096];
+
+    if (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* next = line;
+
+        while (*next != '\0' && *next != '\n')
+        {
+            char* end;
+            long first = strtol(next, &end, 10);
+
+            if (end == next)
+                break;
+
+            long last = first;
+
+            if (*end == '-')
+            {
+                next = end + 1;
+                last = strtol(next, &end, 10);
+            }
+
+            for (long cpu = first; cpu <= last; cpu++)
+                cpus.push_back((int) cpu);
+
+            next = *end == ',' ? end + 1 : end;
+        }
+    }
+
+    fclose(file);
+}
+
+/**
+ * Returns the NUMA nodes of the machine, in order, from sysfs.
+*/
+static void list_nodes(std::vector<int>& nodes)
+{
+    DIR* dir = opendir("/sys/devices/system/node");
+
+    if (dir == NULL)
+        return;
+
+    struct dirent* entry;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char* end;
+
+        if (strncmp(entry->d_name, "node", 4) != 0)
+            continue;
+
+        long node = strtol(entry->d_name + 4, &end, 10);
+
+        if (end != entry->d_name + 4 && *end == '\0')
+            nodes.push_back((int) node);
+    }
+
+    closedir(dir);
+
+    std::sort(nodes.begin(), nodes.end());
+}
+
+void allowed_cpus(std::vector<int>& cpus)
+{
+    cpus.clear();
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+        for (long cpu = 0; cpu < online && cpu < CPU_SETSIZE; cpu++)
+            cpus.push_back((int) cpu);
+
+        return;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+            cpus.push_back(cpu);
+    }
+}
+
+void read_cpu_topology(const std::vector<int>& allowed, cpu_topology& topology)
+{
+    topology.Cpus.clear();
+    topology.Nodes.clear();
+    topology.NumNodes = 0;
+
+    std::vector<int> nodes;
+
+    list_nodes(nodes);
+
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        char path[256];
+        std::vector<int> cpus;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[n]);
+
+        read_cpu_list(path, cpus);
+
+        bool used = false;
+
+        for (size_t c = 0; c < cpus.size(); c++)
+        {
+            if (std::find(allowed.begin(), allowed.end(), cpus[c]) == allowed.end())
+                continue;
+
+            topology.Cpus.push_back(cpus[c]);
+            topology.Nodes.push_back(nodes[n]);
+            used = true;
+        }
+
+        if (used)
+            topology.NumNodes++;
+    }
+
+    // no NUMA in sysfs: one node of every cpu allowed
+    if (topology.Cpus.empty() && !allowed.empty())
+    {
+        topology.Cpus = allowed;
+        topology.Nodes.assign(allowed.size(), 0);
+        topology.NumNodes = 1;
+    }
+}
+
+void plan_placement(const cpu_topology& topology, placement_mode mode, int localRank,
+                    int localSize, thread_placement& placement)
+{
+    placement.Mode = mode;
+    placement.Cpus.clear();
+    placement.Nodes.clear();
+    placement.LocalRank = localRank;
+    placement.LocalSize = localSize;
+
+    int numCpus = (int) topology.Cpus.size();
+
+    if (mode == PLACEMENT_NONE || numCpus == 0 || localSize < 1)
+        return;
+
+    int first = localRank % numCpus;
+    int last = first + 1;
+
+    if (localSize <= numCpus)
+    {
+        first = (int) ((long long) localRank * numCpus / localSize);
+        last = (int) ((long long) (localRank + 1) * numCpus / localSize);
+    }
+
+    for (int c = first; c < last; c++)
+    {
+        placement.Cpus.push_back(topology.Cpus[c]);
+        placement.Nodes.push_back(topology.Nodes[c]);
+    }
+}
+
+void placement_thread_cpus(const thread_placement& placement, int thread, int numThreads,
+                           std::vector<int>& cpus)
+{
+    cpus.clear();
+
+    int numCpus = (int) placement.Cpus.size();
+
+    if (placement.Mode == PLACEMENT_NONE || numCpus == 0)
+        return;
+
+    // spread over the share while there are enough cpus, round robin after
+    int index = numThreads <= numCpus ? (int) ((long long) thread * numCpus / numThreads)
+                                      : thread % numCpus;
+
+    if (placement.Mode == PLACEMENT_CORES)
+    {
+        cpus.push_back(placement.Cpus[index]);
+        return;
+    }
+
+    for (int c = 0; c < numCpus; c++)
+    {
+        if (placement.Nodes[c] == placement.Nodes[index])
+            cpus.push_back(placement.Cpus[c]);
+    }
+}
+
+bool pin_calling_thread(const std::vector<int>& cpus)
+{
+    if (cpus.empty())
+        return true;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (size_t c = 0; c < cpus.size(); c++)
+        CPU_SET(cpus[c], &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool place_process(const thread_placement& placement)
+{
+    return pin_calling_thread(placement.Cpus);
+}
+
+/**
+ * Appends the cpus to text as a cpu list of sysfs, with their nodes.
+*/
+static void append_cpus(std::string& text, const std::vector<int>& cpus,
+                        const thread_placement& placement)
+{
+    char item[64];
+
+    for (size_t c = 0; c < cpus.size(); )
+    {
+        size_t end = c;
+
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1)
+            end++;
+
+        if (end > c)
+            snprintf(item, sizeof(item), "%s%d-%d", c > 0 ? "," : "", cpus[c], cpus[end]);
+        else
+            snprintf(item, sizeof(item), "%s%d", c > 0 ? "," : "", cpus[c]);
+
+        text += item;
+        c = end + 1;
+    }
+
+    // the nodes of the cpus, in order
+    std::vector<int> nodes;
+
+    for (size_t c = 0; c < cpus.size(); c++)
+    {
+        for (size_t p = 0; p < placement.Cpus.size(); p++)
+        {
+            if (placement.Cpus[p] == cpus[c] &&
+                std::find(nodes.begin(), nodes.end(), placement.Nodes[p]) == nodes.end())
+                nodes.push_back(placement.Nodes[p]);
+        }
+    }
+
+    text += nodes.size() > 1 ? " (nodes " : " (node ";
+
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        snprintf(item, sizeof(item), "%s%d", n > 0 ? "," : "", nodes[n]);
+        text += item;
+    }
+
+    text += ")";
+}
+
+void print_placement(int rank, const thread_placement& placement, int numThreads)
+{
+    char host[256];
+
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "?");
+
+    host[sizeof(host) - 1] = '\0';
+
+    if (placement.Mode == PLACEMENT_NONE || placement.Cpus.empty())
+    {
+        printf("Placement of rank %d on %s: not pinned\n", rank, host);
+        return;
+    }
+
+    std::string text;
+
+    append_cpus(text, placement.Cpus, placement);
+
+    std::vector<int> cpus;
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        char item[64];
+
+        snprintf(item, sizeof(item), "%s worker %d on cpus ", t > 0 ? "," : ";", t);
+        text += item;
+
+        placement_thread_cpus(placement, t, numThreads, cpus);
+
+        append_cpus(text, cpus, placement);
+    }
+
+    printf("Placement (%s) of rank %d on %s, process %d of %d there: cpus %s\n",
+           placement_mode_name(placement.Mode), rank, host, placement.LocalRank,
+           placement.LocalSize, text.c_str());
+
+    fflush(stdout);
+}
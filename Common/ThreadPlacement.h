@@ -0,0 +1,145 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ThreadPlacement.h
+* @author Naoki Eto
+* @brief Where the processes and the worker threads of the engine run. The
+*        cpus of a machine, and their NUMA nodes, are read from sysfs
+*        (/sys/devices/system/node/nodeN/cpulist), keeping only those the
+*        processes are allowed on (so taskset and the cgroup of the job
+*        still hold); a machine without it is one node. The processes of a
+*        machine share its cpus out in order, node after node, and every
+*        worker thread of a process is pinned to:
+*
+*        cores  one cpu of the share of its process, the threads spread
+*               evenly over the share (and so over its nodes)
+*        numa   every cpu of the share on the NUMA node of that cpu, for
+*               a worker that runs threads of its own (the pipeline of the
+*               vtk mesh), which inherit where the worker may run
+*
+*        A process is pinned to its whole share before it starts any
+*        thread. Memory is put on the node of the thread that touches it
+*        first, so the buffers a pinned worker reads its files into (see
+*        WorkerArena.h), the grids it parses and the pieces it contours
+*        are all on its own node, with no libnuma: io_uring's workers run
+*        where the thread that made them may.
+*
+*        The placement of every process is printed, one line per process,
+*        so that a run can be placed the same way again.
+*/
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * How the threads are placed.
+*/
+typedef enum Placement_Mode
+{
+    PLACEMENT_NONE,
+    PLACEMENT_CORES,
+    PLACEMENT_NUMA
+} placement_mode;
+
+/**
+ * The cpus this process may run on, by NUMA node: Cpus in the order of
+ * their nodes, and the node of every one of them.
+*/
+typedef struct Cpu_Topology
+{
+    std::vector<int> Cpus;
+    std::vector<int> Nodes;
+    int NumNodes;
+} cpu_topology;
+
+/**
+ * The share of the cpus of one process: its cpus and their nodes, in the
+ * order of the topology, which process of the machine it is, and how
+ * many there are.
+*/
+typedef struct Thread_Placement
+{
+    placement_mode Mode;
+    std::vector<int> Cpus;
+    std::vector<int> Nodes;
+    int LocalRank;
+    int LocalSize;
+} thread_placement;
+
+/**
+ * Reads a placement name (none, cores, numa). Returns false if it is not
+ * one.
+*/
+bool parse_placement_mode(const std::string& name, placement_mode& mode);
+
+/**
+ * Returns the name of the placement.
+*/
+const char* placement_mode_name(placement_mode mode);
+
+/**
+ * Returns the cpus this process may run on.
+*/
+void allowed_cpus(std::vector<int>& cpus);
+
+/**
+ * Reads the NUMA nodes of the allowed cpus (i.e. those of allowed_cpus(),
+ * or of every process of a machine, which an MPI launcher may have bound
+ * to cpus of their own).
+*/
+void read_cpu_topology(const std::vector<int>& allowed, cpu_topology& topology);
+
+/**
+ * Shares the cpus of the topology out between the localSize processes of
+ * the machine, and fills the share of process localRank. With more
+ * processes than cpus, a process gets one cpu, shared.
+*/
+void plan_placement(const cpu_topology& topology, placement_mode mode, int localRank,
+                    int localSize, thread_placement& placement);
+
+/**
+ * Returns the cpus worker thread out of numThreads is pinned to, empty if
+ * the placement is none.
+*/
+void placement_thread_cpus(const thread_placement& placement, int thread, int numThreads,
+                           std::vector<int>& cpus);
+
+/**
+ * Pins the calling thread to the cpus; threads it starts afterwards start
+ * on them too. Nothing is done for no cpus. Returns false if the system
+ * refused.
+*/
+bool pin_calling_thread(const std::vector<int>& cpus);
+
+/**
+ * Pins the calling thread to the whole share of the process, before it
+ * starts its workers. Returns false if the system refused.
+*/
+bool place_process(const thread_placement& placement);
+
+/**
+ * Prints where the process and every one of its numThreads worker threads
+ * run on one line, prefixed with the rank and the host.
+*/
+void print_placement(int rank, const thread_placement& placement, int numThreads);
+
+#endif
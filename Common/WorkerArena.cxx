@@ -0,0 +1,113 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file WorkerArena.cxx
+* @author Naoki Eto
+* @brief The free list of the buffers of one worker.
+*/
+
+#include "WorkerArena.h"
+
+#include <stdlib.h>
+
+void init_worker_arena(worker_arena& arena)
+{
+    arena.Free.clear();
+    arena.Largest = 0;
+    arena.HeldBytes = 0;
+    arena.PeakHeldBytes = 0;
+    arena.Taken = 0;
+    arena.Reused = 0;
+}
+
+arena_buffer arena_take(worker_arena& arena, unsigned long size)
+{
+    if (size == 0)
+        size = 1;
+
+    arena.Taken++;
+
+    // the smallest free buffer that is big enough, so that the big ones
+    // are kept for the big blocks
+    int best = -1;
+
+    for (int b = 0; b < (int) arena.Free.size(); b++)
+    {
+        if (arena.Free[b].Capacity >= size &&
+            (best < 0 || arena.Free[b].Capacity < arena.Free[best].Capacity))
+            best = b;
+    }
+
+    if (best >= 0)
+    {
+        arena_buffer buffer = arena.Free[best];
+
+        arena.Free[best] = arena.Free.back();
+        arena.Free.pop_back();
+
+        arena.Reused++;
+
+        return buffer;
+    }
+
+    if (size > arena.Largest)
+        arena.Largest = size;
+
+    // none fits, so make room for the largest block seen so far rather than
+    // for this one only
+    arena_buffer buffer;
+    buffer.Capacity = arena.Largest;
+    buffer.Data = (char*) malloc(buffer.Capacity);
+
+    if (buffer.Data == NULL)
+    {
+        buffer.Capacity = size;
+        buffer.Data = (char*) malloc(buffer.Capacity);
+    }
+
+    if (buffer.Data == NULL)
+    {
+        buffer.Capacity = 0;
+        return buffer;
+    }
+
+    arena.HeldBytes += buffer.Capacity;
+
+    if (arena.HeldBytes > arena.PeakHeldBytes)
+        arena.PeakHeldBytes = arena.HeldBytes;
+
+    return buffer;
+}
+
+void arena_give(worker_arena& arena, arena_buffer buffer)
+{
+    if (buffer.Data != NULL)
+        arena.Free.push_back(buffer);
+}
+
+void free_worker_arena(worker_arena& arena)
+{
+    for (int b = 0; b < (int) arena.Free.size(); b++)
+    {
+        arena.HeldBytes -= arena.Free[b].Capacity;
+        free(arena.Free[b].Data);
+    }
+
+    arena.Free.clear();
+}
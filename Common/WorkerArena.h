@@ -0,0 +1,84 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file WorkerArena.h
+* @author Naoki Eto
+* @brief Buffers owned by one worker and recycled from one block to the
+*        next. A buffer given back goes on the free list of the worker
+*        instead of back to malloc, and the next block takes it again if
+*        it is big enough, so a worker that goes through files of about
+*        the same size allocates its buffers once, and the threads of a
+*        process do not fight over the allocator (or have every big
+*        buffer mmapped and unmapped, page faults and all) once per block.
+*        New buffers are reserved at the largest size asked for so far,
+*        the estimate of what the next block will need. An arena is only
+*        ever used by the thread that owns it, so there are no locks.
+*/
+
+#ifndef WORKERARENA_H
+#define WORKERARENA_H
+
+#include <vector>
+
+/**
+ * A buffer of the arena: its memory, and how much of it there is.
+*/
+typedef struct Arena_Buffer
+{
+    char* Data;
+    unsigned long Capacity;
+} arena_buffer;
+
+/**
+ * The free buffers of a worker, the largest size asked for so far, and how
+ * well the recycling went.
+*/
+typedef struct Worker_Arena
+{
+    std::vector<arena_buffer> Free;
+    unsigned long Largest;
+    unsigned long HeldBytes;
+    unsigned long PeakHeldBytes;
+    int Taken;
+    int Reused;
+} worker_arena;
+
+/**
+ * Starts an empty arena.
+*/
+void init_worker_arena(worker_arena& arena);
+
+/**
+ * Returns a buffer of at least size bytes: the smallest free one that is
+ * big enough, or a new one of the largest size asked for so far. Data is
+ * NULL if it could not be allocated.
+*/
+arena_buffer arena_take(worker_arena& arena, unsigned long size);
+
+/**
+ * Puts a buffer taken from the arena back on its free list.
+*/
+void arena_give(worker_arena& arena, arena_buffer buffer);
+
+/**
+ * Frees every buffer of the arena. Buffers still taken are not freed.
+*/
+void free_worker_arena(worker_arena& arena);
+
+#endif
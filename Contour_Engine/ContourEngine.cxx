@@ -0,0 +1,329 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file ContourEngine.cxx
+* @author Naoki Eto
+* @brief This program contours a dataset with the contour engine (see
+*        Common/ContourEngine.h), the backend and the handoff being chosen
+*        on the command line rather than by building another variant. The
+*        time is printfed into the command line terminal.
+* @param[in] --backend serial|threads|mpi|hybrid - how the work is run in
+*            parallel (serial by default)
+* @param[in] --handoff memory|files - how the pieces go to the one writing
+*            the output (memory by default)
+* @param[in] --mesh vtk|soa - what the pieces are made of: vtkPolyData
+*            from the VTK filters, or soa_mesh from the contour kernel
+*            (vtk by default)
+* @param[in] --writer vtk|direct|stream - how the output is written: by
+*            vtkPolyDataWriter, or a soa mesh in binary straight from its
+*            arrays, once every piece is in; or in binary a piece at a
+*            time, as they come in (vtk by default)
+* @param[in] --component x|y|z|magnitude - what the soa mesh contours of
+*            "grad" (x by default, the only one of the vtk mesh)
+* @param[in] --placement none|cores|numa - whether the processes and worker
+*            threads are pinned, to a cpu or to a NUMA node each (none by
+*            default), the placement being printed (cores needs --mesh soa,
+*            the pipeline threads of the vtk mesh would share one cpu)
+* @param[in] --gather flat|node - whether every process of the mpi and
+*            hybrid backends sends its piece to the parent, or the
+*            processes of a machine merge theirs in shared memory and one
+*            of them sends it (flat by default; node needs --mesh soa and
+*            --handoff memory)
+* @param[in] --preview N - first contours every Nth point of every block
+*            along each axis and writes it to OUTPUT for a first look, then
+*            replaces it with the full resolution output (none by default)
+* @param[in] --slice x|y|z=POSITION - also cuts every block by the plane at
+*            POSITION along the axis, written to OUTPUT's name .slice.vtk
+* @param[in] --threshold LOW:HIGH - also keeps the cells of every block with
+*            the x component of "grad" from LOW to HIGH, written to
+*            OUTPUT's name .threshold.vtk
+* @param[in] --histogram BINS - also writes the statistics and a histogram
+*            of BINS bins of every block to OUTPUT's name .histogram.txt
+*            (the slice, threshold and histogram need --mesh vtk, and are
+*            made from the same read of every block as the contour)
+* @param[in] --analytics - only measures the contour, with the contour
+*            kernel: the triangles, area and enclosed volume of each of 50
+*            values over the range of all the blocks, added up over the
+*            blocks and written to OUTPUT as text, a line per isovalue, no
+*            mesh being gathered (not with --preview, the operators or
+*            --gather node)
+* @param[in] --threads N - worker threads, for the threads and hybrid
+*            backends (per process for hybrid)
+* @param[in] OUTPUT - the output's filename
+* @param[in] DATASET - the prefix of the files (i.e. 27noise.vtk.) or a
+*            ".visit" manifest (i.e. 27noise.vtk.visit)
+* @param[in] NUMFILES - how many files of a prefix to contour, one per
+*            worker by default (like the variants)
+* @param[out] OUTPUT - vtkPolyData file, and the files of the slice,
+*             threshold and histogram next to it, or the text of the
+*             measures with --analytics
+* @return - EXIT_SUCCESS, or EXIT_FAILURE if the arguments are wrong or the
+*           output could not be written
+*/
+
+#include <vtkMPIController.h>
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "BlockManifest.h"
+#include "ContourEngine.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+static void print_usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [--backend serial|threads|mpi|hybrid] [--handoff memory|files]\n"
+                    "       [--mesh vtk|soa] [--writer vtk|direct|stream]\n"
+                    "       [--component x|y|z|magnitude] [--placement none|cores|numa]\n"
+                    "       [--gather flat|node] [--preview N] [--threads N]\n"
+                    "       [--slice x|y|z=POSITION] [--threshold LOW:HIGH] [--histogram BINS]\n"
+                    "       [--analytics]\n"
+                    "       OUTPUT PREFIX|MANIFEST [NUMFILES]\n", program);
+}
+
+/**
+ * Reads the command line into options and the dataset. Returns false if
+ * it is wrong.
+*/
+static bool parse_arguments(int argc, char* argv[], engine_options& options,
+                            std::string& dataset, int& numFiles)
+{
+    std::vector<std::string> positional;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg = argv[a];
+
+        if (arg == "--backend" && a + 1 < argc)
+        {
+            if (!parse_engine_backend(argv[++a], options.Backend))
+                return false;
+        }
+        else if (arg == "--handoff" && a + 1 < argc)
+        {
+            if (!parse_engine_handoff(argv[++a], options.Handoff))
+                return false;
+        }
+        else if (arg == "--mesh" && a + 1 < argc)
+        {
+            if (!parse_engine_mesh(argv[++a], options.Mesh))
+                return false;
+        }
+        else if (arg == "--writer" && a + 1 < argc)
+        {
+            if (!parse_engine_writer(argv[++a], options.Writer))
+                return false;
+        }
+        else if (arg == "--component" && a + 1 < argc)
+        {
+            if (!parse_kernel_component(argv[++a], options.Component))
+                return false;
+        }
+        else if (arg == "--placement" && a + 1 < argc)
+        {
+            if (!parse_placement_mode(argv[++a], options.Placement))
+                return false;
+        }
+        else if (arg == "--gather" && a + 1 < argc)
+        {
+            if (!parse_engine_gather(argv[++a], options.Gather))
+                return false;
+        }
+        else if (arg == "--preview" && a + 1 < argc)
+        {
+            options.Preview = atoi(argv[++a]);
+
+            if (options.Preview < 1)
+                return false;
+        }
+        else if (arg == "--slice" && a + 1 < argc)
+        {
+            if (!parse_slice_operator(argv[++a], options.Operators))
+                return false;
+        }
+        else if (arg == "--threshold" && a + 1 < argc)
+        {
+            if (!parse_threshold_operator(argv[++a], options.Operators))
+                return false;
+        }
+        else if (arg == "--histogram" && a + 1 < argc)
+        {
+            options.Operators.HistogramBins = atoi(argv[++a]);
+
+            if (options.Operators.HistogramBins < 1)
+                return false;
+        }
+        else if (arg == "--analytics")
+        {
+            options.Analytics = true;
+        }
+        else if (arg == "--threads" && a + 1 < argc)
+        {
+            options.Threads = atoi(argv[++a]);
+
+            if (options.Threads < 1)
+                return false;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2 || positional.size() > 3)
+        return false;
+
+    // vtkContourFilter is only given the first component
+    if (options.Mesh == MESH_VTK && options.Component != COMPONENT_X)
+        return false;
+
+    // the operators run on the vtk grid, which the soa mesh never makes
+    if (options.Mesh != MESH_VTK && any_block_operator(options.Operators))
+        return false;
+
+    // analytics makes no mesh to preview, make products with or gather
+    if (options.Analytics && (options.Preview > 1 || any_block_operator(options.Operators) ||
+                              options.Gather == GATHER_NODE))
+        return false;
+
+    // the pipeline threads of a worker would share its one cpu
+    if (options.Placement == PLACEMENT_CORES && options.Mesh == MESH_VTK)
+    {
+        fprintf(stderr, "--placement cores pins a worker and its pipeline to one cpu, "
+                        "use --placement numa with --mesh vtk\n");
+        return false;
+    }
+
+    // only the arrays of a soa mesh in memory go in a shared window
+    if (options.Gather == GATHER_NODE &&
+        (options.Mesh != MESH_SOA || options.Handoff != HANDOFF_MEMORY))
+        return false;
+
+    options.Output = positional[0];
+    dataset = positional[1];
+    numFiles = positional.size() == 3 ? atoi(positional[2].c_str()) : 0;
+
+    return true;
+}
+
+/**
+ * Returns how many workers the backend has: the files of a prefix are one
+ * per worker unless told otherwise.
+*/
+static int count_workers(const engine_options& options, int size)
+{
+    switch (options.Backend)
+    {
+    case ENGINE_THREADS:
+        return options.Threads;
+    case ENGINE_MPI:
+        return size - 1;
+    case ENGINE_HYBRID:
+        return (size - 1) * options.Threads;
+    default:
+        return 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    vtkMPIController* controller = vtkMPIController::New();
+
+    double t1 = MPI_Wtime();
+
+    // Initializing MPI
+    controller->Initialize(&argc, &argv);
+
+    int MPI_rank = controller->GetLocalProcessId();
+    int MPI_size = controller->GetNumberOfProcesses();
+
+    TRACE_SET_RANK(MPI_rank);
+    MEMORY_SET_RANK(MPI_rank);
+
+    engine_options options;
+    default_engine_options(options);
+    options.Controller = controller;
+
+    std::string dataset;
+    int numFiles = 0;
+
+    if (!parse_arguments(argc, argv, options, dataset, numFiles))
+    {
+        if (MPI_rank == 0)
+            print_usage(argv[0]);
+
+        controller->Finalize();
+        controller->Delete();
+
+        return EXIT_FAILURE;
+    }
+
+    if (numFiles <= 0)
+        numFiles = count_workers(options, MPI_size);
+
+    std::vector<std::string> files;
+
+    if (read_block_list(dataset, numFiles, files) < 0)
+    {
+        if (MPI_rank == 0)
+            fprintf(stderr, "Could not read the manifest %s\n", dataset.c_str());
+
+        controller->Finalize();
+        controller->Delete();
+
+        return EXIT_FAILURE;
+    }
+
+    bool parallel = options.Backend == ENGINE_MPI || options.Backend == ENGINE_HYBRID;
+
+    long long triangles = 0;
+
+    // the serial and threads backends only run in the first process
+    if (parallel || MPI_rank == 0)
+        triangles = run_contour_engine(options, files);
+
+    if (MPI_rank == 0 && triangles >= 0)
+    {
+        double t2 = MPI_Wtime();
+
+        double time = t2 - t1;
+
+        printf("The %s backend %s %lld triangles\n", engine_backend_name(options.Backend),
+               options.Analytics ? "measured" : "made", triangles);
+        printf("MPI_Wtime measured the time elapsed to be: %f\n", time);
+    }
+
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
+    controller->Finalize();
+    controller->Delete();
+
+    return triangles < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
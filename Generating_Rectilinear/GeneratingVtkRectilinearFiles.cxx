@@ -0,0 +1,519 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file GeneratingVtkRectilinearFiles.cxx
+* @author Naoki Eto
+* @brief This program generates a dataset like the ones in 27PartVTK,
+*        64PartVtk and 512PartVtk, of any size and number of blocks: a
+*        rectilinear grid over [-10, 10]^3 split into blocks that share
+*        their boundary planes, with the gradient of a smooth noise field
+*        made from a seed as "grad". The processes generate and write the
+*        blocks round robin, and the same seed gives the same dataset with
+*        any number of processes.
+* @param[in] number of processes - number of processes for MPI
+* @param[in] argv[1] - the prefix of the blocks (i.e. 4096noise.vtk.), the
+*            manifest is this prefix + "visit", the packed dataset this
+*            prefix + "vtkpack"
+* @param[in] argv[2] - the number of points, N for N^3 or NXxNYxNZ
+* @param[in] argv[3] - the number of blocks, B for about B^(1/3) blocks
+*            along every axis or BXxBYxBZ
+* @param[in] argv[4] - optional seed, 1 if left out
+* @param[in] argv[5] - optional format: ascii (the default, like the
+*            datasets in the repository), binary (legacy vtk binary) or
+*            pack (a ".vtkpack" packed dataset, written with collective
+*            MPI-IO)
+* @param[out] the blocks and their manifest, or the packed dataset
+* @return - EXIT_SUCCESS at the end, EXIT_FAILURE if a block could not be
+*           written
+*/
+
+#include <mpi.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "BlockManifest.h"
+#include "BlockPack.h"
+#include "BlockPackReader.h"
+#include "NoiseField.h"
+
+/**
+ * Where a block starts in the grid (in points) and how many points it has
+ * along every axis.
+ */
+typedef struct Generated_Block
+{
+    int Start[3];
+    int Dims[3];
+} generated_block;
+
+/**
+ * Reads "N" or "NXxNYxNZ" into values. Returns false if it is neither.
+ */
+static bool parse_triple(const char* arg, int values[3], bool& single)
+{
+    single = sscanf(arg, "%dx%dx%d", &values[0], &values[1], &values[2]) != 3;
+
+    if (single)
+    {
+        char end;
+
+        if (sscanf(arg, "%d%c", &values[0], &end) != 1)
+            return false;
+
+        values[1] = values[2] = values[0];
+    }
+
+    return values[0] > 0 && values[1] > 0 && values[2] > 0;
+}
+
+/**
+ * Splits count blocks into a lattice as close to a cube as it can, the
+ * longest side along Z.
+ */
+static void factor_blocks(int count, int lattice[3])
+{
+    lattice[0] = 1;
+    lattice[1] = 1;
+    lattice[2] = count;
+
+    for (int a = 1; a * a * a <= count; a++)
+    {
+        if (count % a != 0)
+            continue;
+
+        for (int b = a; a * b * b <= count; b++)
+        {
+            if ((count / a) % b != 0)
+                continue;
+
+            int c = count / a / b;
+
+            // the smallest longest side is the closest to a cube
+            if (c < lattice[2] || (c == lattice[2] && a > lattice[0]))
+            {
+                lattice[0] = a;
+                lattice[1] = b;
+                lattice[2] = c;
+            }
+        }
+    }
+}
+
+/**
+ * Fills blocks with the blocks of the lattice, x fastest. The cells along
+ * every axis are shared out as evenly as they go, and neighbouring blocks
+ * share the plane of points between them.
+ */
+static void make_blocks(const int points[3], const int lattice[3],
+                        std::vector<generated_block>& blocks)
+{
+    blocks.clear();
+
+    for (int k = 0; k < lattice[2]; k++)
+    {
+        for (int j = 0; j < lattice[1]; j++)
+        {
+            for (int i = 0; i < lattice[0]; i++)
+            {
+                int place[3] = { i, j, k };
+
+                generated_block block;
+
+                for (int a = 0; a < 3; a++)
+                {
+                    long long cells = points[a] - 1;
+
+                    int first = (int) (cells * place[a] / lattice[a]);
+                    int last = (int) (cells * (place[a] + 1) / lattice[a]);
+
+                    block.Start[a] = first;
+                    block.Dims[a] = last - first + 1;
+                }
+
+                blocks.push_back(block);
+            }
+        }
+    }
+}
+
+/**
+ * Fills coords with the coordinates of count points from start on, of an
+ * axis of points points over [-10, 10]. They only depend on the point's
+ * place in the whole grid, so neighbouring blocks agree on their planes.
+ */
+static void axis_coordinates(int points, int start, int count, std::vector<double>& coords)
+{
+    coords.resize(count);
+
+    for (int i = 0; i < count; i++)
+        coords[i] = -10.0 + 20.0 * (start + i) / (points - 1);
+}
+
+/**
+ * Writes count floats as text, 9 to a line like vtkDataWriter does.
+ */
+static bool write_ascii_values(FILE* out, const float* values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        fprintf(out, "%g ", values[i]);
+
+        if (i % 9 == 8 || i + 1 == count)
+            fputc('\n', out);
+    }
+
+    return !ferror(out);
+}
+
+/**
+ * Writes count floats big endian, as legacy binary vtk files have them,
+ * and the newline that ends them.
+ */
+static bool write_binary_values(FILE* out, const float* values, size_t count)
+{
+    std::vector<uint32_t> swapped(count);
+
+    memcpy(&swapped[0], values, count * sizeof(float));
+
+    uint32_t one = 1;
+
+    if (*(const char*) &one == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t v = swapped[i];
+
+            swapped[i] = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+        }
+    }
+
+    return fwrite(&swapped[0], 4, count, out) == count && fputc('\n', out) != EOF;
+}
+
+/**
+ * Writes one block as a legacy vtk rectilinear grid file with "grad" as
+ * its vectors. Returns false if it cannot be written.
+ */
+static bool write_legacy_block(const std::string& path, bool binary, const int dims[3],
+                               const std::vector<float> coords[3], const std::vector<float>& grad)
+{
+    FILE* out = fopen(path.c_str(), binary ? "wb" : "w");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "# vtk DataFile Version 2.0\nvtk output\n%s\nDATASET RECTILINEAR_GRID\n"
+                 "DIMENSIONS %d %d %d\n", binary ? "BINARY" : "ASCII", dims[0], dims[1], dims[2]);
+
+    const char* names[3] = { "X_COORDINATES", "Y_COORDINATES", "Z_COORDINATES" };
+
+    bool ok = true;
+
+    for (int a = 0; a < 3 && ok; a++)
+    {
+        fprintf(out, "%s %d float\n", names[a], dims[a]);
+
+        ok = binary ? write_binary_values(out, &coords[a][0], dims[a])
+                    : write_ascii_values(out, &coords[a][0], dims[a]);
+    }
+
+    fprintf(out, "POINT_DATA %lu\nVECTORS grad float\n", (unsigned long) (grad.size() / 3));
+
+    ok = ok && (binary ? write_binary_values(out, &grad[0], grad.size())
+                       : write_ascii_values(out, &grad[0], grad.size()));
+
+    ok = fclose(out) == 0 && ok;
+
+    if (!ok)
+        remove(path.c_str());
+
+    return ok;
+}
+
+/**
+ * Works out the coordinates and "grad" of one block.
+ */
+static void generate_block(const noise_field& field, const int points[3],
+                           const generated_block& block, std::vector<float> coords[3],
+                           std::vector<float>& grad)
+{
+    std::vector<double> axes[3];
+
+    for (int a = 0; a < 3; a++)
+    {
+        axis_coordinates(points[a], block.Start[a], block.Dims[a], axes[a]);
+
+        coords[a].assign(axes[a].begin(), axes[a].end());
+    }
+
+    noise_gradient(field, axes[0], axes[1], axes[2], grad);
+}
+
+/**
+ * Writes the blocks of this process into the packed file, together with
+ * the other processes: rank 0 writes the header and index, and then every
+ * process writes one block per round with MPI_File_write_at_all, so that
+ * the MPI-IO layer can gather the writes. Returns false if this process
+ * could not write.
+ */
+static bool write_packed_blocks(MPI_Comm comm, const char* packFile, const noise_field& field,
+                                const int points[3], const std::vector<generated_block>& blocks,
+                                const std::vector<int>& myBlocks, long long& bytes)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    std::vector<int> dims;
+
+    for (int b = 0; b < (int) blocks.size(); b++)
+        dims.insert(dims.end(), blocks[b].Dims, blocks[b].Dims + 3);
+
+    std::vector<pack_entry> index;
+
+    plan_block_pack(dims, index);
+
+    MPI_Info hints = block_pack_hints();
+
+    MPI_File file;
+
+    int opened = MPI_File_open(comm, (char*) packFile, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                               hints, &file);
+
+    if (hints != MPI_INFO_NULL)
+        MPI_Info_free(&hints);
+
+    if (opened != MPI_SUCCESS)
+        return false;
+
+    bool ok = true;
+
+    if (rank == 0)
+    {
+        std::vector<char> header;
+
+        block_pack_header(index, header);
+
+        MPI_Status status;
+
+        ok = MPI_File_write_at(file, 0, &header[0], (int) header.size(), MPI_BYTE,
+                               &status) == MPI_SUCCESS;
+    }
+
+    // every process has to take part in every round
+    int myRounds = (int) myBlocks.size();
+    int rounds;
+
+    MPI_Allreduce(&myRounds, &rounds, 1, MPI_INT, MPI_MAX, comm);
+
+    std::vector<float> data;
+    std::vector<float> coords[3];
+    std::vector<float> grad;
+
+    for (int r = 0; r < rounds; r++)
+    {
+        MPI_Offset offset = 0;
+        int count = 0;
+
+        data.clear();
+
+        if (r < myRounds)
+        {
+            int b = myBlocks[r];
+
+            generate_block(field, points, blocks[b], coords, grad);
+
+            for (int a = 0; a < 3; a++)
+                data.insert(data.end(), coords[a].begin(), coords[a].end());
+
+            data.insert(data.end(), grad.begin(), grad.end());
+
+            // MPI counts are ints, so blocks are written as floats
+            if ((long long) data.size() > INT_MAX)
+            {
+                ok = false;
+                data.clear();
+            }
+            else
+            {
+                offset = (MPI_Offset) index[b].Offset;
+                count = (int) data.size();
+            }
+        }
+
+        MPI_Status status;
+
+        int result = MPI_File_write_at_all(file, offset, data.empty() ? NULL : &data[0],
+                                           count, MPI_FLOAT, &status);
+
+        ok = ok && result == MPI_SUCCESS;
+
+        bytes += (long long) count * sizeof(float);
+    }
+
+    MPI_File_close(&file);
+
+    return ok;
+}
+
+/**
+ * This program generates the blocks of a noise dataset of the asked size
+ * and writes them out in parallel, for scaling runs on more data than the
+ * datasets in the repository.
+ */
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+
+    double t1 = MPI_Wtime();
+
+    int rank, size;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int points[3];
+    int lattice[3];
+    bool cubePoints, totalBlocks;
+
+    std::string format = argc > 5 ? argv[5] : "ascii";
+
+    if (argc < 4 || !parse_triple(argv[2], points, cubePoints) ||
+        !parse_triple(argv[3], lattice, totalBlocks) ||
+        (format != "ascii" && format != "binary" && format != "pack"))
+    {
+        if (rank == 0)
+            fprintf(stderr, "Usage: %s OUTPREFIX POINTS BLOCKS [SEED [ascii|binary|pack]]\n"
+                    "  POINTS is N (N^3) or NXxNYxNZ, BLOCKS is B or BXxBYxBZ\n", argv[0]);
+
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    // a single number of blocks is the total, shared out over the axes
+    if (totalBlocks)
+        factor_blocks(lattice[0], lattice);
+
+    if (lattice[0] >= points[0] || lattice[1] >= points[1] || lattice[2] >= points[2])
+    {
+        if (rank == 0)
+            fprintf(stderr, "%d x %d x %d blocks need more than %d x %d x %d points\n",
+                    lattice[0], lattice[1], lattice[2], points[0], points[1], points[2]);
+
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+
+    std::string outPrefix = argv[1];
+
+    noise_field field;
+
+    make_noise_field(seed, 20.0, field);
+
+    std::vector<generated_block> blocks;
+
+    make_blocks(points, lattice, blocks);
+
+    // this process takes blocks rank, rank + size, ...
+    std::vector<int> myBlocks;
+
+    for (int b = rank; b < (int) blocks.size(); b += size)
+        myBlocks.push_back(b);
+
+    long long bytes = 0;
+    bool ok = true;
+
+    std::vector<std::string> files(blocks.size());
+
+    for (int b = 0; b < (int) blocks.size(); b++)
+    {
+        char name[32];
+
+        sprintf(name, "%d.vtk", b);
+
+        files[b] = outPrefix + name;
+    }
+
+    if (format == "pack")
+    {
+        std::string packFile = outPrefix + "vtkpack";
+
+        ok = write_packed_blocks(MPI_COMM_WORLD, packFile.c_str(), field, points, blocks,
+                                 myBlocks, bytes);
+    }
+    else
+    {
+        std::vector<float> coords[3];
+        std::vector<float> grad;
+
+        for (int m = 0; m < (int) myBlocks.size() && ok; m++)
+        {
+            int b = myBlocks[m];
+
+            generate_block(field, points, blocks[b], coords, grad);
+
+            ok = write_legacy_block(files[b], format == "binary", blocks[b].Dims, coords, grad);
+
+            if (!ok)
+                fprintf(stderr, "Process %d could not write %s\n", rank, files[b].c_str());
+
+            bytes += (long long) (grad.size() + coords[0].size() + coords[1].size() +
+                                  coords[2].size()) * sizeof(float);
+        }
+    }
+
+    int failed = ok ? 0 : 1;
+    int anyFailed;
+    long long totalBytes;
+
+    MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Reduce(&bytes, &totalBytes, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0 && !anyFailed && format != "pack")
+    {
+        std::string manifest = outPrefix + "visit";
+
+        if (!write_block_manifest(manifest, files))
+        {
+            fprintf(stderr, "Could not write the manifest %s\n", manifest.c_str());
+            anyFailed = 1;
+        }
+    }
+
+    double t2 = MPI_Wtime();
+
+    if (rank == 0 && !anyFailed)
+    {
+        printf("Generated %d x %d x %d points (seed %llu) as %d x %d x %d blocks, "
+               "%lld bytes of values, with %d processes in %f s\n",
+               points[0], points[1], points[2], seed, lattice[0], lattice[1], lattice[2],
+               totalBytes, size, t2 - t1);
+    }
+
+    MPI_Finalize();
+
+    return anyFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -28,7 +28,13 @@
 * @param[in] number of processes - number of processes for MPI (look at README 
              for more information)
 * @param[in] argv[1] - the output's filename
-* @param[in] argv[2] - the prefix of the files (i.e. 27noise.vtk.)
+* @param[in] argv[2] - the prefix of the files (i.e. 27noise.vtk.), a
+*            ".visit" manifest (i.e. 27noise.vtk.visit) or a packed dataset
+*            (i.e. 27noise.vtkpack), whose blocks are read with collective
+*            MPI-IO
+* @param[in] argv[3] - optional number of files when argv[2] is a prefix,
+*            one per child process if left out. Child processes with more
+*            than one file read, contour and send them in a pipeline
 * @param[out] pWriter - vtkPolyData file with the output's filename
 * @return - EXIT_SUCCESS at the end
 */
@@ -53,79 +59,150 @@
 
 #include <time.h>
 
-void process(int procRank, int procSize, vtkMPIController* procController, const char* fp)
+#include <string>
+#include <vector>
+
+#include "BlockManifest.h"
+#include "BlockPackReader.h"
+#include "BlockPipeline.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+/**
+ * What the sender stage of a child process needs to send its pieces.
+ */
+typedef struct Send_Target
+{
+    vtkMPIController* procController;
+} send_target;
+
+/**
+ * Sender stage: sends every piece to the parent process as soon as its 
+ * normals are done.
+ */
+static void send_piece(int fileIndex, vtkPolyData* piece, void* user)
+{
+    send_target* target = (send_target*) user;
+
+    TRACE_STAGE(send);
+
+    // send the vtkPolyData to the parent process
+    target->procController->Send(piece, 0, 101);
+
+    MEMORY_RECORD_DATA(send, piece);
+
+    piece->Delete();
+}
+
+/**
+ * Returns how many files the child process of rank procRank takes when the
+ * files are dealt out round robin to the procSize-1 child processes.
+ */
+static int files_of(int procRank, int procSize, int numFiles)
 {
-    /* The vtk file extension we want to search for */
+    int children = procSize - 1;
 
-    int NumOfCharPD = strlen(fp) + 5 + 1;
-    int original = NumOfCharPD;
+    return (numFiles - (procRank - 1) + children - 1) / children;
+}
 
-    // figure out how many characters are in the temporary file name, 
-    if(procRank - 1 > 9)
-        NumOfCharPD += (int) log10(procRank - 1);
+/**
+ * This function is the work of one child process: it reads its vtk 
+ * Rectilinear files, applies vtkContourFilter and vtkPolyDataNormals, and 
+ * sends every vtk polydata to the parent process.
+ */
+void process(int procRank, int procSize, vtkMPIController* procController,
+             const std::vector<std::string>& files)
+{
+    // this child process takes files procRank-1, procRank-1 + procSize-1, ...
+    std::vector<std::string> myFiles;
 
-    char buf[(int) NumOfCharPD - original + 1];
- 
-    sprintf(buf, "%d", procRank-1);
+    assign_blocks(files, procRank - 1, procSize - 1, myFiles);
 
-    const char* suffix = ".vtk";
+    send_target target;
+    target.procController = procController;
 
-    const char* prefix = fp;
+    loader_stats stats;
 
-    char prefix_suffix[NumOfCharPD];
+    // read the next files while this one is contoured and the one before
+    // is sent
+    run_block_pipeline(myFiles, 2, loader_queue_depth(), send_piece, &target, &stats);
 
-    strcpy(prefix_suffix, prefix);
+    if (getenv("LOADER_STATS") != NULL)
+    {
+        char who[32];
 
-    strcat(prefix_suffix, buf);
+        sprintf(who, "Process %d", procRank);
 
-    strcat(prefix_suffix, suffix);
+        print_loader_stats(who, &stats);
+    }
+}
+
+/**
+ * This function is the packed dataset version of process(), called by 
+ * every process: the child processes read their blocks (dealt out round 
+ * robin like the files) out of the packed file with collective MPI-IO, 
+ * and the parent process takes part in the reads with nothing to read. 
+ * All the blocks are read before any piece is sent, because the parent
+ * process only receives once it is out of the collective reads.
+ */
+void process_packed(int procRank, int procSize, vtkMPIController* procController,
+                    const char* packFile, const std::vector<pack_entry>& index)
+{
+    std::vector<int> myBlocks;
 
-    vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
+    if (procRank != 0)
+    {
+        for (int b = procRank - 1; b < (int) index.size(); b += procSize - 1)
+            myBlocks.push_back(b);
+    }
 
-    reader->SetFileName(prefix_suffix);
-    reader->Update();
+    MPI_Info hints = block_pack_hints();
 
-    // Create a grid
-    vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
-    reader->Delete();
+    double t0 = MPI_Wtime();
 
-    vtkPointData* pointdata = grid->GetPointData();
+    std::vector<vtkRectilinearGrid*> grids;
 
-    double* range;
+    TRACE_BEGIN(read);
 
-    range = pointdata->GetArray("grad")->GetRange();
+    read_packed_blocks_all(MPI_COMM_WORLD, packFile, index, myBlocks, hints, grids);
 
-    vtkContourFilter* contour = vtkContourFilter::New();
+    TRACE_END(read);
 
-    // name of array is "grad"
-    contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+    double t1 = MPI_Wtime();
 
-    // better than setinput
-    contour->SetInputConnection(grid->GetProducerPort());
+    if (hints != MPI_INFO_NULL)
+        MPI_Info_free(&hints);
 
-    // woo 50 contours
-    contour->GenerateValues(50, range);
+    if (procRank != 0 && getenv("LOADER_STATS") != NULL)
+    {
+        printf("Process %d read %d packed blocks in %f s with MPI_File_read_at_all\n",
+               procRank, (int) grids.size(), t1 - t0);
+    }
 
-    contour->ComputeNormalsOn();
+    // the same filters for every block of this process
+    block_workspace* workspace = new_block_workspace();
 
-    contour->Update();
+    for (int g = 0; g < (int) grids.size(); g++)
+    {
+        MEMORY_RECORD_DATA(read, grids[g]);
 
-    // calc cell normal
-    vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
+        vtkPolyData* piece = contour_block_with(workspace, grids[g]);
 
-    triangleCellNormals->SetInputConnection(contour->GetOutputPort());
+        grids[g]->Delete();
 
-    triangleCellNormals->ComputeCellNormalsOn();
-    triangleCellNormals->ComputePointNormalsOff();
-    triangleCellNormals->ConsistencyOn();
-    triangleCellNormals->AutoOrientNormalsOn();
-    triangleCellNormals->Update(); // creates vtkPolyData
+        TRACE_BEGIN(send);
 
-    // send the vtkPolyData to the parent process
-    procController->Send(triangleCellNormals->GetOutput(), 0, 101);
+        // send the vtkPolyData to the parent process
+        procController->Send(piece, 0, 101);
 
-    triangleCellNormals->Delete();
-    pointdata->Delete();
+        TRACE_END(send);
+
+        MEMORY_RECORD_DATA(send, piece);
+
+        piece->Delete();
+    }
+
+    delete_block_workspace(workspace);
 }
 
 /**
@@ -152,33 +229,87 @@ int main(int argc, char *argv[])
     /* Figure out the rank of this processor */
     int size = controller->GetNumberOfProcesses();
 
+    TRACE_SET_RANK(rank);
+    MEMORY_SET_RANK(rank);
+
+    // one file per child process, unless told otherwise
+    int numFiles = size - 1;
+
+    if (argc > 3)
+        numFiles = atoi(argv[3]);
+
+    std::vector<std::string> files;
+    std::vector<pack_entry> index;
+
+    bool packed = is_block_pack(argv[2]);
+
+    if (packed)
+    {
+        if (!read_pack_index_all(MPI_COMM_WORLD, argv[2], index))
+        {
+            fprintf(stderr, "Could not read the packed dataset %s\n", argv[2]);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        numFiles = (int) index.size();
+
+        // every process takes part in the collective reads
+        process_packed(rank, size, controller, argv[2], index);
+    }
+    else if (read_block_list(argv[2], numFiles, files) < 0)
+    {
+        fprintf(stderr, "Could not read the manifest %s\n", argv[2]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    else
+    {
+        numFiles = (int) files.size();
+    }
+
     // If not parent process, do the vtkContourFilter implementation
-    if (rank != 0)
+    if (rank != 0 && !packed)
     {
-        const char* prefix = argv[2];
-        process(rank, size, controller, prefix);
+        process(rank, size, controller, files);
     }
 
     // Parent
-    else
+    else if (rank == 0)
     {   
         // to append each piece into 1 big vtk file
         vtkAppendPolyData *appendWriter = vtkAppendPolyData::New();
 
-        // go through the child processes, and append
+        // go through the child processes, and append every piece of each
         for(int k = 1; k < size; k++)
         {
-            vtkPolyData* pd = vtkPolyData::New();
-            
-            controller->Receive(pd, k, 101);
+            for(int n = files_of(k, size, numFiles); n > 0; n--)
+            {
+                vtkPolyData* pd = vtkPolyData::New();
+
+                TRACE_BEGIN(receive);
 
-            appendWriter->AddInput(pd);
+                controller->Receive(pd, k, 101);
 
-            appendWriter->Update();
+                TRACE_END(receive);
 
-            pd->Delete();
+                // every piece is held until they are all appended
+                MEMORY_RECORD_DATA(receive, pd);
+
+                appendWriter->AddInput(pd);
+
+                pd->Delete();
+            }
         }
 
+        TRACE_BEGIN(append);
+
+        appendWriter->Update();
+
+        TRACE_END(append);
+
+        MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
+        TRACE_BEGIN(write);
+
         vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
         pWriter->SetFileName(argv[1]);
 
@@ -187,6 +318,8 @@ int main(int argc, char *argv[])
         // output vtk file
         pWriter->Write();
 
+        TRACE_END(write);
+
         double t2 = MPI_Wtime();
 
         double time = t2 - t1;
@@ -195,16 +328,18 @@ int main(int argc, char *argv[])
 
         FILE *out_file = fopen("../OutPutFile.txt", "a"); // write only 
 
-        char strPD[6];
-
-	    snprintf(strPD, 7, "%f \n", time);
+        // the full time (the benchmark harness reads the printf above)
+        if (out_file != NULL)
+        {
+            fprintf(out_file, "%f\n", time);
 
-        fputs(strPD, out_file);
+            fclose(out_file);
+        }
+    }
 
-        fputs("\n", out_file);
+    TRACE_DUMP();
 
-        fclose(out_file);
-    }
+    MEMORY_REPORT();
 
     controller->Finalize(); 
     controller->Delete();
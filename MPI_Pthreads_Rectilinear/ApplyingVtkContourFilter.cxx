@@ -31,7 +31,11 @@
 * @param[in] argv[1] - number of threads for pthreading (look at 
 *            README for more information)
 * @param[in] argv[2] - the output's filename
-* @param[in] argv[3] - the prefix of the files (i.e. 27noise.vtk.)
+* @param[in] argv[3...] - the prefix of the files (i.e. 27noise.vtk.) or a
+*            ".visit" manifest (i.e. 27noise.vtk.visit), one per timestep.
+*            With more than one timestep the threads and filters are kept
+*            alive for the whole batch, and timestep t is written to the
+*            output's filename with ".t" inserted before ".vtk"
 * @param[out] pWriter - vtkPolyData file with the output's filename
 * @return - EXIT_SUCCESS at the end
 */
@@ -51,80 +55,141 @@
 #include <pthread.h>
 #include <time.h>
 
+#include <string>
+#include <vector>
+
 #include <vtkRectilinearGrid.h>
 #include <vtkRectilinearGridReader.h>
 
 #include <vtkContourFilter.h>
 #include <vtkPoints.h>
 
+#include "BlockManifest.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
+/**
+ * This struct is the double buffer between a thread and its prefetch 
+ * thread. The prefetch thread reads the thread's file of timestep t+1 with
+ * one reader while the thread contours timestep t out of the other one.
+*/
+typedef struct Prefetch_Buffer
+{
+    vtkRectilinearGridReader* reader[2];
+    int Loaded;
+    int Released;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} prefetch;
+
+/**
+ * This struct counts, for every timestep, how many threads of this 
+ * processor have finished their vtk polydata, so that the processor can 
+ * send timestep t while the threads go on with timestep t+1.
+*/
+typedef struct Timestep_Progress
+{
+    std::vector<int> Finished;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} progress;
+
 /**
  * This struct contains the id of the thread, the rank of the processor, 
- * the filename prefix of the vtk files, the number of total threads, and 
- * vtk poly data that has been outputted by vtkContourFilter. This will 
- * be useful for determining which vtk file goes with which particular 
- * thread/processor combination.
+ * the files of every timestep, the number of total threads, and the vtk 
+ * poly data that has been outputted by vtkContourFilter for every 
+ * timestep. This will be useful for determining which vtk file goes with 
+ * which particular thread/processor combination.
 */
 typedef struct Param_Function
 {
     int NumThreads;
-    const char *VTKinput;
+    const std::vector<std::vector<std::string> >* VTKinput;
     int ThreadId;
-    vtkPolyData* vtkPiece;
+    std::vector<vtkPolyData*> vtkPieces;
     int procRank;
+    prefetch Buffer;
+    progress* Progress;
 } params;
 
+/**
+ * Returns the file of this thread/processor combination in timestep t, or
+ * NULL if the timestep has fewer files than there are threads.
+*/
+static const char* block_of(params* NewPtr, int t)
+{
+    const std::vector<std::string>& files = (*NewPtr->VTKinput)[t];
+
+    int blockId = (NewPtr->procRank-1)*(NewPtr->NumThreads) + NewPtr->ThreadId;
+
+    if (blockId >= (int) files.size())
+        return NULL;
+
+    return files[blockId].c_str();
+}
 
 /**
- * This function takes in the appropriate vtk Rectilinear file and 
- * thread/processor. The thread reads the file and applies vtkContourFilter 
- * to the data. vtk polydata is outputted, and are then sent to the parent 
- * thread. 
+ * This function reads the thread's vtk Rectilinear file of every timestep
+ * ahead of the thread, at most one timestep ahead of the one being 
+ * contoured.
 */
-void* thread_function(void* ptr)
+void* prefetch_function(void* ptr)
 {
     params* NewPtr;
     NewPtr = (params*) ptr;
 
-    /* The vtk file extension we want to search for */
-
-    int NumOfCharPD = strlen(NewPtr->VTKinput) + 5 + 1;
-    int original = NumOfCharPD;
+    prefetch* buffer = &NewPtr->Buffer;
 
-    // figure out how many characters are in the temporary file name, 
-    if((NewPtr->procRank-1)*(NewPtr->NumThreads) + NewPtr->ThreadId > 9)
-        NumOfCharPD += (int) log10((NewPtr->procRank-1)*(NewPtr->NumThreads) + NewPtr->ThreadId);
+    int NumTimesteps = (int) NewPtr->VTKinput->size();
 
-    char buf[(int) NumOfCharPD - original + 1];
- 
-    sprintf(buf, "%d", (NewPtr->procRank-1)*(NewPtr->NumThreads) + NewPtr->ThreadId);
-
-    const char* suffix = ".vtk";
+    for (int t = 0; t < NumTimesteps; t++)
+    {
+        // wait until the thread is done with the timestep in this reader
+        pthread_mutex_lock(&buffer->mutex);
+        while (t - 2 > buffer->Released)
+            pthread_cond_wait(&buffer->cond, &buffer->mutex);
+        pthread_mutex_unlock(&buffer->mutex);
 
-    const char* prefix = NewPtr->VTKinput;
+        const char* prefix_suffix = block_of(NewPtr, t);
 
-    char prefix_suffix[NumOfCharPD];
+        if (prefix_suffix != NULL)
+        {
+            TRACE_STAGE(read);
 
-    strcpy(prefix_suffix, prefix);
+            buffer->reader[t % 2]->SetFileName(prefix_suffix);
 
-    strcat(prefix_suffix, buf);
+            buffer->reader[t % 2]->Update();
 
-    strcat(prefix_suffix, suffix);
+            MEMORY_RECORD_DATA(read, buffer->reader[t % 2]->GetOutput());
+        }
 
-    vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
-    
-    reader->SetFileName(prefix_suffix);
+        pthread_mutex_lock(&buffer->mutex);
+        buffer->Loaded = t;
+        pthread_cond_broadcast(&buffer->cond);
+        pthread_mutex_unlock(&buffer->mutex);
+    }
 
-    reader->Update();
+    return NULL;
+}
 
-    // Create a grid
-    vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
-    reader->Delete();
+/**
+ * This function takes in the appropriate vtk Rectilinear file of every 
+ * timestep and thread/processor. The thread applies vtkContourFilter to 
+ * the data read by its prefetch thread. vtk polydata is outputted, and are 
+ * then sent to the parent thread. The filters are created once and reused
+ * for every timestep.
+*/
+void* thread_function(void* ptr)
+{
+    params* NewPtr;
+    NewPtr = (params*) ptr;
 
-    vtkPointData* pointdata = grid->GetPointData();
+    prefetch* buffer = &NewPtr->Buffer;
 
-    double* range;
+    int NumTimesteps = (int) NewPtr->VTKinput->size();
 
-    range = pointdata->GetArray("grad")->GetRange();
+    // Create a grid, which shares the arrays of the reader's output
+    vtkRectilinearGrid* grid = vtkRectilinearGrid::New();
 
     vtkContourFilter* contour = vtkContourFilter::New();
 
@@ -134,13 +199,8 @@ void* thread_function(void* ptr)
     // better than setinput
     contour->SetInputConnection(grid->GetProducerPort());
 
-    // woo 50 contours
-    contour->GenerateValues(50, range);
-
     contour->ComputeNormalsOn();
 
-    contour->Update();
-
     // calc cell normal
     vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
 
@@ -150,11 +210,94 @@ void* thread_function(void* ptr)
     triangleCellNormals->ComputePointNormalsOff();
     triangleCellNormals->ConsistencyOn();
     triangleCellNormals->AutoOrientNormalsOn();
-    triangleCellNormals->Update(); // creates vtkPolyData
 
-    NewPtr->vtkPiece = triangleCellNormals->GetOutput();
+    for (int t = 0; t < NumTimesteps; t++)
+    {
+        // wait for the prefetch thread to read this timestep
+        pthread_mutex_lock(&buffer->mutex);
+        while (buffer->Loaded < t)
+            pthread_cond_wait(&buffer->cond, &buffer->mutex);
+        pthread_mutex_unlock(&buffer->mutex);
+
+        vtkPolyData* piece = vtkPolyData::New();
+
+        if (block_of(NewPtr, t) != NULL)
+        {
+            grid->ShallowCopy(buffer->reader[t % 2]->GetOutput());
+
+            double* range;
+
+            TRACE_BEGIN(range);
+
+            range = grid->GetPointData()->GetArray("grad")->GetRange();
+
+            TRACE_END(range);
+
+            TRACE_BEGIN(contour);
+
+            // woo 50 contours
+            contour->GenerateValues(50, range);
+
+            contour->Update();
+
+            TRACE_END(contour);
 
-    pointdata->Delete();
+            MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+            TRACE_BEGIN(normals);
+
+            triangleCellNormals->Update(); // creates vtkPolyData
+
+            TRACE_END(normals);
+
+            MEMORY_RECORD_DATA(normals, triangleCellNormals->GetOutput());
+
+            // the filters' outputs are rebuilt next timestep, so keep our
+            // own reference to this timestep's data
+            piece->ShallowCopy(triangleCellNormals->GetOutput());
+        }
+
+        // the reader may now be refilled with timestep t+2
+        pthread_mutex_lock(&buffer->mutex);
+        buffer->Released = t;
+        pthread_cond_broadcast(&buffer->cond);
+        pthread_mutex_unlock(&buffer->mutex);
+
+        NewPtr->vtkPieces[t] = piece;
+
+        pthread_mutex_lock(&NewPtr->Progress->mutex);
+        NewPtr->Progress->Finished[t]++;
+        pthread_cond_broadcast(&NewPtr->Progress->cond);
+        pthread_mutex_unlock(&NewPtr->Progress->mutex);
+    }
+
+    triangleCellNormals->Delete();
+    contour->Delete();
+    grid->Delete();
+
+    return NULL;
+}
+
+/**
+ * Returns the output's filename of timestep t. A single timestep keeps
+ * the output's filename, otherwise ".t" goes in front of ".vtk" (or at the
+ * end if there is no ".vtk").
+*/
+static std::string timestep_output(const std::string& output, int t, int NumTimesteps)
+{
+    if (NumTimesteps == 1)
+        return output;
+
+    char buf[16];
+
+    sprintf(buf, ".%d", t);
+
+    std::string::size_type extension = output.rfind(".vtk");
+
+    if (extension == std::string::npos || extension + 4 != output.size())
+        return output + buf;
+
+    return output.substr(0, extension) + buf + ".vtk";
 }
 
 int main(int argc, char *argv[])
@@ -172,54 +315,120 @@ int main(int argc, char *argv[])
     /* Figure out the rank of this processor */
     int MPI_size = controller->GetNumberOfProcesses();
 
+    TRACE_SET_RANK(MPI_rank);
+    MEMORY_SET_RANK(MPI_rank);
+
     /* The parent process will be of rank 0 */
     int PARENT = 0;
 
     int pthreads_size = atoi(argv[1]);
 
+    /* Every argument after the output's filename is one timestep */
+    int NumTimesteps = argc - 3;
+
+    std::vector<std::vector<std::string> > timesteps(NumTimesteps);
+
+    for (int t = 0; t < NumTimesteps; t++)
+    {
+        if (read_block_list(argv[3 + t], (MPI_size-1)*pthreads_size, timesteps[t]) < 0)
+        {
+            fprintf(stderr, "Could not read the manifest %s\n", argv[3 + t]);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
 	pthread_t threads[pthreads_size];
 
+	pthread_t prefetchers[pthreads_size];
+
     // this is the input into the function for each thread
     params thread_data_array[pthreads_size];
 
     // If not parent process, do the vtkContourFilter implementation
     if (MPI_rank >= 1)
     {
-        //creating threads
-        // The file extension to look for is .f.vtk
-        std::string fileprefix = argv[3];
+        progress Progress;
+        Progress.Finished.assign(NumTimesteps, 0);
+        pthread_mutex_init(&Progress.mutex, NULL);
+        pthread_cond_init(&Progress.cond, NULL);
 
 	    for (int f = 0; f < pthreads_size; f++) {      
             //creating threads
             thread_data_array[f].NumThreads = pthreads_size;
             thread_data_array[f].procRank = MPI_rank;
-            thread_data_array[f].VTKinput = fileprefix.c_str();
+            thread_data_array[f].VTKinput = &timesteps;
             thread_data_array[f].ThreadId = f;
+            thread_data_array[f].vtkPieces.assign(NumTimesteps, (vtkPolyData*) NULL);
+            thread_data_array[f].Progress = &Progress;
+
+            prefetch* buffer = &thread_data_array[f].Buffer;
+            buffer->reader[0] = vtkRectilinearGridReader::New();
+            buffer->reader[1] = vtkRectilinearGridReader::New();
+            buffer->Loaded = -1;
+            buffer->Released = -1;
+            pthread_mutex_init(&buffer->mutex, NULL);
+            pthread_cond_init(&buffer->cond, NULL);
+
+		    pthread_create(&prefetchers[f], NULL, prefetch_function, (void*)&thread_data_array[f]);
 		    pthread_create(&threads[f], NULL, thread_function, (void*)&thread_data_array[f]);
         }
 
-	    for (int j = 0; j < pthreads_size; j++)
-        {
-		    pthread_join(threads[j], NULL);
-        }
-
         vtkAppendPolyData *appendWriter = vtkAppendPolyData::New();
 
-        for(int y = 0; y < pthreads_size; y++)
+        // send every timestep as soon as all of its pieces are done, while
+        // the threads already work on the next timestep
+        for (int t = 0; t < NumTimesteps; t++)
         {
-            vtkPolyData *inputNum = vtkPolyData::New();
+            pthread_mutex_lock(&Progress.mutex);
+            while (Progress.Finished[t] < pthreads_size)
+                pthread_cond_wait(&Progress.cond, &Progress.mutex);
+            pthread_mutex_unlock(&Progress.mutex);
 
-            inputNum->ShallowCopy(thread_data_array[y].vtkPiece);
+            for(int y = 0; y < pthreads_size; y++)
+            {
+                appendWriter->AddInput(thread_data_array[y].vtkPieces[t]);
+            }
 
-            appendWriter->AddInput(thread_data_array[y].vtkPiece);
+            TRACE_BEGIN(append);
 
             appendWriter->Update();
 
-            inputNum->Delete();
+            TRACE_END(append);
+
+            MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
+            TRACE_BEGIN(send);
+
+            // send the vtkPolyData to the parent process
+            controller->Send(appendWriter->GetOutput(), 0, 1);
+
+            TRACE_END(send);
+
+            MEMORY_RECORD_DATA(send, appendWriter->GetOutput());
+
+            appendWriter->RemoveAllInputs();
+
+            for(int y = 0; y < pthreads_size; y++)
+            {
+                thread_data_array[y].vtkPieces[t]->Delete();
+            }
         }
 
-        // send the vtkPolyData to the parent process
-        controller->Send(appendWriter->GetOutput(), 0, 1);
+	    for (int j = 0; j < pthreads_size; j++)
+        {
+		    pthread_join(threads[j], NULL);
+		    pthread_join(prefetchers[j], NULL);
+
+            thread_data_array[j].Buffer.reader[0]->Delete();
+            thread_data_array[j].Buffer.reader[1]->Delete();
+            pthread_mutex_destroy(&thread_data_array[j].Buffer.mutex);
+            pthread_cond_destroy(&thread_data_array[j].Buffer.cond);
+        }
+
+        appendWriter->Delete();
+
+        pthread_mutex_destroy(&Progress.mutex);
+        pthread_cond_destroy(&Progress.cond);
     }
 
     if (MPI_rank == PARENT)
@@ -227,25 +436,58 @@ int main(int argc, char *argv[])
         // to append each piece into 1 big vtk file
         vtkAppendPolyData *appendWriterPARENT = vtkAppendPolyData::New();
 
-        // go through the processes, and append
-        for(int k = 1; k < MPI_size; k++)
+        vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
+
+        for (int t = 0; t < NumTimesteps; t++)
         {
-            vtkPolyData* pd = vtkPolyData::New();
-            controller->Receive(pd, k, 1);
+            double ts1 = MPI_Wtime();
+
+            // go through the processes, and append
+            for(int k = 1; k < MPI_size; k++)
+            {
+                vtkPolyData* pd = vtkPolyData::New();
+
+                TRACE_BEGIN(receive);
+
+                controller->Receive(pd, k, 1);
+
+                TRACE_END(receive);
+
+                MEMORY_RECORD_DATA(receive, pd);
+
+                appendWriterPARENT->AddInput(pd);
 
-            appendWriterPARENT->AddInput(pd);
+                pd->Delete();
+            }
+
+            TRACE_BEGIN(append);
 
             appendWriterPARENT->Update();
 
-            pd->Delete();
-        }
+            TRACE_END(append);
 
-        vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
-        pWriter->SetFileName(argv[2]);
+            MEMORY_RECORD_DATA(append, appendWriterPARENT->GetOutput());
+
+            TRACE_BEGIN(write);
+
+            std::string output = timestep_output(argv[2], t, NumTimesteps);
+
+            pWriter->SetFileName(output.c_str());
 
             pWriter->SetInput(appendWriterPARENT->GetOutput());
 
-        pWriter->Write();
+            pWriter->Write();
+
+            TRACE_END(write);
+
+            appendWriterPARENT->RemoveAllInputs();
+
+            if (NumTimesteps > 1)
+                printf("Timestep %d (%s) took %f\n", t, output.c_str(), MPI_Wtime() - ts1);
+        }
+
+        pWriter->Delete();
+        appendWriterPARENT->Delete();
 
         double t2 = MPI_Wtime();
 
@@ -253,6 +495,11 @@ int main(int argc, char *argv[])
 
         printf("MPI_Wtime measured the time elapsed to be: %f\n", time);
     }
+
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
 	MPI_Finalize();
 
 	return EXIT_SUCCESS;
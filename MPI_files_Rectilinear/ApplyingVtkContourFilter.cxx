@@ -29,7 +29,9 @@
 * @param[in] number of processes - number of processes for MPI (look at README 
              for more information)
 * @param[in] argv[1] - the output's filename
-* @param[in] argv[2] - the prefix of the files (i.e. 27noise.vtk.)
+* @param[in] argv[2] - the prefix of the files (i.e. 27noise.vtk.) or a
+*            packed dataset (i.e. 27noise.vtkpack) with one block per child
+*            process, whose blocks are read with collective MPI-IO
 * @param[out] pWriter - vtkPolyData file with the output's filename
 * @return - EXIT_SUCCESS at the end
 */
@@ -54,6 +56,12 @@
 
 #include <time.h>
 
+#include <vector>
+
+#include "BlockPackReader.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
 /**
  * This program takes in vtkRectilinear files and assigns the appropriate
  * file (which is numbered) with the appropriate child processor. In each 
@@ -84,10 +92,54 @@ int main(int argc, char *argv[])
     // Figure out the rank of this processor
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    TRACE_SET_RANK(rank);
+    MEMORY_SET_RANK(rank);
+
     int NumOfCharPD;
 
     char strPD[NumOfCharPD];
 
+    // a packed dataset is read by all the processes together, the parent 
+    // process with nothing to read
+    bool packed = is_block_pack(argv[2]);
+
+    vtkRectilinearGrid* packedGrid = NULL;
+
+    if (packed)
+    {
+        std::vector<pack_entry> index;
+
+        if (!read_pack_index_all(MPI_COMM_WORLD, argv[2], index) ||
+            (int) index.size() < size - 1)
+        {
+            if (rank == 0)
+                fprintf(stderr, "Could not read a block per child process from %s\n", argv[2]);
+
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        std::vector<int> myBlocks;
+
+        if (rank >= 1)
+            myBlocks.push_back(rank - 1);
+
+        MPI_Info hints = block_pack_hints();
+
+        std::vector<vtkRectilinearGrid*> grids;
+
+        TRACE_BEGIN(read);
+
+        read_packed_blocks_all(MPI_COMM_WORLD, argv[2], index, myBlocks, hints, grids);
+
+        TRACE_END(read);
+
+        if (hints != MPI_INFO_NULL)
+            MPI_Info_free(&hints);
+
+        if (rank >= 1)
+            packedGrid = grids[0];
+    }
+
     // If not master process, do the vtkMarchingCubes implementation
     if (rank >= 1)
     {
@@ -120,21 +172,41 @@ int main(int argc, char *argv[])
 
         strcat(prefix_suffix, suffix);
 
-        vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
+        // Create a grid
+        vtkSmartPointer<vtkRectilinearGrid> grid;
 
-        reader->SetFileName(prefix_suffix);
-        reader->Update();
+        if (packed)
+        {
+            grid = packedGrid;
+            packedGrid->Delete();
+        }
+        else
+        {
+            TRACE_STAGE(read);
 
-        // Create a grid
-        vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
-        reader->Delete();
+            vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
+
+            reader->SetFileName(prefix_suffix);
+            reader->Update();
+
+            grid = reader->GetOutput();
+            reader->Delete();
+        }
+
+        MEMORY_RECORD_DATA(read, grid);
 
         vtkPointData* pointdata = grid->GetPointData();
 
         double* range;
 
+        TRACE_BEGIN(range);
+
         range = pointdata->GetArray("grad")->GetRange();
 
+        TRACE_END(range);
+
+        TRACE_BEGIN(contour);
+
         vtkContourFilter* contour = vtkContourFilter::New();
 
         // name of array is "grad"
@@ -150,7 +222,11 @@ int main(int argc, char *argv[])
 
         contour->Update();
 
-        pointdata->Delete();
+        TRACE_END(contour);
+
+        MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+        TRACE_BEGIN(normals);
 
         // calc cell normal
         vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
@@ -165,6 +241,13 @@ int main(int argc, char *argv[])
         triangleCellNormals->AutoOrientNormalsOn();
         triangleCellNormals->Update(); // creates vtkPolyData
 
+        TRACE_END(normals);
+
+        // the piece goes to the parent through a temporary file
+        MEMORY_RECORD_DATA(normals, triangleCellNormals->GetOutput());
+
+        TRACE_BEGIN(write);
+
         /* vtkPolyDataWriter for temporary file */
         vtkPolyDataWriter *PDwriter = vtkPolyDataWriter::New();
 
@@ -178,8 +261,14 @@ int main(int argc, char *argv[])
 
         triangleCellNormals->Delete();
 
+        TRACE_END(write);
+
+        TRACE_BEGIN(send);
+
         // Send this temporary file name to the parent process
         MPI_Send(strPD, NumOfCharPD, MPI_CHAR, 0, 1, MPI_COMM_WORLD);
+
+        TRACE_END(send);
     }
 
     // Parent
@@ -193,6 +282,8 @@ int main(int argc, char *argv[])
         {
             NumOfCharPD = log10(i) + 18;
 
+            TRACE_STAGE(receive);
+
             MPI_Recv(strPD, NumOfCharPD, MPI_CHAR, i, 1, MPI_COMM_WORLD, &status);
         }
 
@@ -208,21 +299,36 @@ int main(int argc, char *argv[])
             char strPDPARENT[NumOfCharPDPARENT];
 
             sprintf(strPDPARENT, "ShrimpChowFun%d.vtk", k);
+
+            TRACE_BEGIN(read);
+
             reader->SetFileName(strPDPARENT);
             reader->Update();
             inputNum->ShallowCopy(reader->GetOutput());
 
+            TRACE_END(read);
+
+            MEMORY_RECORD_DATA(receive, inputNum);
+
             appendWriter->AddInput(reader->GetOutput());
 
             // remove temporary files
             remove(strPDPARENT);
 
+            TRACE_BEGIN(append);
+
             appendWriter->Update();
 
+            TRACE_END(append);
+
+            MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
             reader->Delete();
             inputNum->Delete();
         }
 
+        TRACE_BEGIN(write);
+
         // output vtkpolydata file
         vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
         pWriter->SetFileName(argv[1]);
@@ -231,6 +337,8 @@ int main(int argc, char *argv[])
 
         pWriter->Write();
 
+        TRACE_END(write);
+
         appendWriter->Delete();
         pWriter->Delete();
 
@@ -242,20 +350,18 @@ int main(int argc, char *argv[])
 
         FILE *out_file = fopen("../OutPutFile.txt", "a"); // write only 
 
-        char strPDNew[6];
-
-    	snprintf(strPDNew, 7, "%f", time);
-
-        fputs(strPDNew, out_file);
-
-        fputs("\n", out_file);
+        // the full time (the benchmark harness reads the printf above)
+        if (out_file != NULL)
+        {
+            fprintf(out_file, "%f\n", time);
 
-        remove(strPDNew);
+            fclose(out_file);
+        }
+    }
 
-        remove(strPD);
+    TRACE_DUMP();
 
-        fclose(out_file);
-    }
+    MEMORY_REPORT();
 
     MPI_Finalize();    
 
@@ -0,0 +1,144 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file PackingVtkRectilinearFiles.cxx
+* @author Naoki Eto
+* @brief This program reads the VTK rectilinear files of a dataset and
+*        packs them into one packed dataset file, which the MPI variants
+*        can read with collective MPI-IO.
+* @param[in] argv[1] - the packed file's filename (i.e. 27noise.vtkpack)
+* @param[in] argv[2] - the prefix of the files (i.e. 27noise.vtk.) or a
+*            ".visit" manifest (i.e. 27noise.vtk.visit)
+* @param[in] argv[3] - the number of files when argv[2] is a prefix
+* @param[out] the packed dataset file
+* @return - EXIT_SUCCESS at the end, EXIT_FAILURE if a file could not be
+*           read or written
+*/
+
+#include <vtkSmartPointer.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkRectilinearGridReader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "BlockManifest.h"
+#include "BlockPack.h"
+
+/**
+ * Copies the values of the array into floats, whatever type the file had.
+ */
+static void to_floats(vtkDataArray* array, std::vector<float>& values)
+{
+    int components = array->GetNumberOfComponents();
+    vtkIdType tuples = array->GetNumberOfTuples();
+
+    values.resize(components * tuples);
+
+    for (vtkIdType t = 0; t < tuples; t++)
+        for (int c = 0; c < components; c++)
+            values[t * components + c] = (float) array->GetComponent(t, c);
+}
+
+/**
+ * This program takes in vtkRectilinear files, and writes the coordinates
+ * and "grad" vectors of every file into the packed file, in the order of
+ * the files.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || (!is_visit_manifest(argv[2]) && argc < 4))
+    {
+        fprintf(stderr, "Usage: %s PACKFILE PREFIX NUMFILES | %s PACKFILE MANIFEST.visit\n",
+                argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int numFiles = argc > 3 ? atoi(argv[3]) : 0;
+
+    std::vector<std::string> files;
+
+    if (read_block_list(argv[2], numFiles, files) < 0)
+    {
+        fprintf(stderr, "Could not read the manifest %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* pack = begin_block_pack(argv[1], (int) files.size());
+
+    if (pack == NULL)
+    {
+        fprintf(stderr, "Could not create %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<pack_entry> index;
+
+    std::vector<float> x, y, z, grad;
+
+    bool ok = true;
+
+    for (int f = 0; f < (int) files.size() && ok; f++)
+    {
+        vtkSmartPointer<vtkRectilinearGridReader> reader =
+            vtkSmartPointer<vtkRectilinearGridReader>::New();
+
+        reader->SetFileName(files[f].c_str());
+        reader->Update();
+
+        vtkRectilinearGrid* grid = reader->GetOutput();
+
+        vtkDataArray* vectors = grid->GetPointData()->GetArray("grad");
+
+        if (grid->GetNumberOfPoints() == 0 || vectors == NULL)
+        {
+            fprintf(stderr, "Could not read %s\n", files[f].c_str());
+            ok = false;
+            break;
+        }
+
+        int dims[3];
+
+        grid->GetDimensions(dims);
+
+        to_floats(grid->GetXCoordinates(), x);
+        to_floats(grid->GetYCoordinates(), y);
+        to_floats(grid->GetZCoordinates(), z);
+        to_floats(vectors, grad);
+
+        ok = append_packed_block(pack, index, dims, &x[0], &y[0], &z[0], &grad[0]);
+    }
+
+    if (!finish_block_pack(pack, index) || !ok)
+    {
+        fprintf(stderr, "Could not write %s\n", argv[1]);
+        remove(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Packed %d files into %s\n", (int) index.size(), argv[1]);
+
+    return EXIT_SUCCESS;
+}
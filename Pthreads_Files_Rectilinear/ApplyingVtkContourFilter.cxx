@@ -54,6 +54,9 @@
 #include <vtkContourFilter.h>
 #include <vtkPoints.h>
 
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+
 /**
  * This struct contains the id of the thread and the filename prefix of the 
  * vtk files. This will be useful for determining which vtk file goes with
@@ -104,24 +107,36 @@ void* thread_function(void* ptr)
 
     strcat(prefix_suffix, suffix);
 
+    TRACE_BEGIN(read);
+
     vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
     
     reader->SetFileName(prefix_suffix);
 
     reader->Update();
 
+    TRACE_END(read);
+
     pthread_mutex_unlock( &(NewPtr->mutex) );
 
     // Create a grid
     vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
     reader->Delete();
 
+    MEMORY_RECORD_DATA(read, grid);
+
     vtkPointData* pointdata = grid->GetPointData();
 
     double* range;
 
+    TRACE_BEGIN(range);
+
     range = pointdata->GetArray("grad")->GetRange();
 
+    TRACE_END(range);
+
+    TRACE_BEGIN(contour);
+
     vtkContourFilter* contour = vtkContourFilter::New();
 
     // name of array is "grad"
@@ -137,6 +152,12 @@ void* thread_function(void* ptr)
 
     contour->Update();
 
+    TRACE_END(contour);
+
+    MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+    TRACE_BEGIN(normals);
+
     // calc cell normal
     vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
 
@@ -148,6 +169,12 @@ void* thread_function(void* ptr)
     triangleCellNormals->AutoOrientNormalsOn();
     triangleCellNormals->Update(); // creates vtkPolyData
 
+    TRACE_END(normals);
+
+    MEMORY_RECORD_DATA(normals, triangleCellNormals->GetOutput());
+
+    TRACE_BEGIN(write);
+
     /* vtkPolyDataWriter for temporary file */
     vtkPolyDataWriter *PDwriter = vtkPolyDataWriter::New();
 
@@ -170,6 +197,8 @@ void* thread_function(void* ptr)
 
     PDwriter->Write();
 
+    TRACE_END(write);
+
     triangleCellNormals->Delete();
     pointdata->Delete();
 }
@@ -233,21 +262,36 @@ int main(int argc, char *argv[])
         char strPDPARENT[NumOfCharPDPARENT];
 
         sprintf(strPDPARENT, "ShrimpChowFun%d.vtk", k);
+
+        TRACE_BEGIN(read);
+
         readerPD->SetFileName(strPDPARENT);
         readerPD->Update();
         inputNum->ShallowCopy(readerPD->GetOutput());
 
+        TRACE_END(read);
+
+        MEMORY_RECORD_DATA(receive, inputNum);
+
         appendWriter->AddInput(readerPD->GetOutput());
 
         // remove temporary files
         remove(strPDPARENT);
 
+        TRACE_BEGIN(append);
+
         appendWriter->Update();
 
+        TRACE_END(append);
+
+        MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
         readerPD->Delete();
         inputNum->Delete();
     }
 
+    TRACE_BEGIN(write);
+
     vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
     
     // Output vtkpolydata file
@@ -257,11 +301,17 @@ int main(int argc, char *argv[])
 
     pWriter->Write();
 
+    TRACE_END(write);
+
     clock_gettime(CLOCK_REALTIME,&t1);
 
     double dt = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
 
     printf("The measured time elapsed to be: %f\n", dt);
 
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
     exit(0);
 }
@@ -29,9 +29,26 @@
 * @param[in] argv[1] - number of threads for pthreading (look at 
 *            README for more information)
 * @param[in] argv[2] - the output's filename
-* @param[in] argv[3] - the prefix of the files (i.e. 27noise.vtk.)
+* @param[in] argv[3] - the prefix of the files (i.e. 27noise.vtk.) or a
+*            ".visit" manifest (i.e. 27noise.vtk.visit)
+* @param[in] argv[4] - optional number of files when argv[3] is a prefix,
+*            one per thread if left out. Threads with more than one file 
+*            read, contour and append them in a pipeline
 * @param[out] pWriter - vtkPolyData file with the output's filename
 * @return - EXIT_SUCCESS at the end
+*
+* With COALESCE_POINTS set, neighbouring files are first merged into bricks
+* of about that many points, and the threads take the bricks instead, each
+* contoured at 50 values over the brick's range (so not the same surface).
+*
+* With argv[1] = "--serve" the program instead stays resident and answers
+* contour requests on a UNIX domain socket, reading every file only once
+* into a block cache (look at README for more information):
+* @param[in] argv[2] - the path of the socket
+* @param[in] argv[3] - number of threads for pthreading
+* @param[in] argv[4] - the prefix of the files or a ".visit" manifest
+* @param[in] argv[5] - optional memory budget of the caches in megabytes
+* @param[in] argv[6] - optional directory to also keep the surfaces in
 */
 
 #include <vtkVersion.h>
@@ -44,33 +61,77 @@
 #include <vtkAppendPolyData.h>
 #include <vtkCleanPolyData.h>
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <vector>
 
 #include <vtkRectilinearGrid.h>
 #include <vtkRectilinearGridReader.h>
 
 #include <vtkContourFilter.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
 #include <vtkPoints.h>
 
+#include "BlockCache.h"
+#include "BlockCoalesce.h"
+#include "BlockManifest.h"
+#include "BlockPipeline.h"
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+#include "SurfaceCache.h"
+
 /**
  * This struct contains the id of the thread, the filename prefix of the 
  * vtk files, the number of total threads, and vtk poly data that has been
  * outputted by vtkContourFilter. This will be useful for determining which 
- * vtk file goes with which particular thread.
+ * vtk file goes with which particular thread. When the program is a 
+ * server, the thread's files come out of the block cache and their 
+ * surfaces out of the surface cache instead, and the contour values may
+ * be given.
 */
 typedef struct Param_Function
 {
-    const char *VTKinput;
+    const std::vector<std::string>* VTKinput;
     int threadId;
+    int NumThreads;
+    int LoaderDepth;
+    loader_stats LoaderStats;
     vtkPolyData* vtkPiece;
+    block_cache* Cache;
+    surface_cache* Surfaces;
+    const std::vector<double>* Values;
 } params;
 
 /**
- * This function takes in the appropriate vtk Rectilinear file and thread. The
- * thread reads the file and applies vtkContourFilter to the data. vtk polydata
- * is outputted, and are then sent to the parent thread. 
+ * Sender stage of a thread: appends every piece into the thread's vtk 
+ * polydata.
+*/
+static void append_piece(int fileIndex, vtkPolyData* piece, void* user)
+{
+    vtkAppendPolyData* appendPieces = (vtkAppendPolyData*) user;
+
+    appendPieces->AddInput(piece);
+
+    piece->Delete();
+}
+
+/**
+ * This function takes in the appropriate vtk Rectilinear files and thread. 
+ * The thread takes files threadId, threadId + NumThreads, ..., reads them 
+ * and applies vtkContourFilter to the data in a pipeline, so the next file
+ * is read while this one is contoured. vtk polydata is outputted, and are 
+ * then sent to the parent thread. 
 */
 void* thread_function(void* ptr)
 {
@@ -80,75 +141,600 @@ void* thread_function(void* ptr)
     params* NewPtr;
     NewPtr = (params*) ptr;
 
-    int NumOfCharPD = strlen(NewPtr->VTKinput) + 5 + 1;
-    int original = NumOfCharPD;
+    std::vector<std::string> myFiles;
 
-    // figure out how many characters are in the temporary file name, 
-    if(NewPtr->threadId > 9)
-        NumOfCharPD += (int) log10(NewPtr->threadId);
+    assign_blocks(*NewPtr->VTKinput, NewPtr->threadId, NewPtr->NumThreads, myFiles);
 
-    char buf[(int) NumOfCharPD - original + 1];
+    vtkAppendPolyData *appendPieces = vtkAppendPolyData::New();
 
-    sprintf(buf, "%d", NewPtr->threadId);
+    run_block_pipeline(myFiles, 2, NewPtr->LoaderDepth, append_piece, appendPieces,
+                       &NewPtr->LoaderStats);
 
-    const char* suffix = ".vtk";
+    TRACE_BEGIN(append);
 
-    const char* prefix = NewPtr->VTKinput;
+    appendPieces->Update();
 
-    char prefix_suffix[NumOfCharPD];
+    TRACE_END(append);
 
-    strcpy(prefix_suffix, prefix);
+    // Save the vtk poly data as a member of the struct
+    NewPtr->vtkPiece = vtkPolyData::New();
+    NewPtr->vtkPiece->ShallowCopy(appendPieces->GetOutput());
 
-    strcat(prefix_suffix, buf);
+    // the piece is held until the main thread has appended every piece
+    MEMORY_RECORD_DATA(append, NewPtr->vtkPiece);
 
-    strcat(prefix_suffix, suffix);
+    appendPieces->Delete();
 
-    vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
-    
-    reader->SetFileName(prefix_suffix);
+    return NULL;
+}
 
-    reader->Update();
+/**
+ * Splits the surfaces of several contour values, contoured in one pass, 
+ * into one vtk polydata per value: every triangle goes to the value 
+ * nearest to the scalar of its first point, which is the value it was 
+ * contoured at. The points and the point and cell data go along with 
+ * their triangles (vtkContourFilter makes no vertices or lines out of a
+ * rectilinear grid, so the polygons are all the cells).
+*/
+static void split_by_value(vtkPolyData* contoured, const std::vector<double>& values,
+                           std::vector<vtkPolyData*>& pieces)
+{
+    TRACE_STAGE(split);
 
-    // Create a grid
-    vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
-    reader->Delete();
+    int numValues = (int) values.size();
 
-    vtkPointData* pointdata = grid->GetPointData();
+    vtkDataArray* scalars = contoured->GetPointData()->GetScalars();
 
-    double* range;
+    vtkCellArray* polys = contoured->GetPolys();
 
-    range = pointdata->GetArray("grad")->GetRange();
+    // the triangles of every value, by their cell id
+    std::vector<std::vector<vtkIdType> > cells(numValues);
 
-    vtkContourFilter* contour = vtkContourFilter::New();
+    vtkIdType npts, *pts;
+    vtkIdType cellId = 0;
 
-    // name of array is "grad"
-    contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+    for (polys->InitTraversal(); polys->GetNextCell(npts, pts); cellId++)
+    {
+        int nearest = 0;
 
-    // better than setinput
-    contour->SetInputConnection(grid->GetProducerPort());
+        if (scalars != NULL && npts > 0)
+        {
+            double scalar = scalars->GetTuple1(pts[0]);
 
-    // woo 50 contours
-    contour->GenerateValues(50, range);
+            for (int v = 1; v < numValues; v++)
+            {
+                if (fabs(values[v] - scalar) < fabs(values[nearest] - scalar))
+                    nearest = v;
+            }
+        }
 
-    contour->ComputeNormalsOn();
+        cells[nearest].push_back(cellId);
+    }
 
-    contour->Update();
+    // the id of every point in the piece it went to, the surfaces of
+    // different values sharing no point
+    std::vector<vtkIdType> pointIds(contoured->GetNumberOfPoints(), -1);
 
-    // calc cell normal
-    vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
+    pieces.resize(numValues);
 
-    triangleCellNormals->SetInputConnection(contour->GetOutputPort());
+    for (int v = 0; v < numValues; v++)
+    {
+        vtkPolyData* piece = vtkPolyData::New();
+        vtkPoints* points = vtkPoints::New();
+        vtkCellArray* triangles = vtkCellArray::New();
 
-    triangleCellNormals->ComputeCellNormalsOn();
-    triangleCellNormals->ComputePointNormalsOff();
-    triangleCellNormals->ConsistencyOn();
-    triangleCellNormals->AutoOrientNormalsOn();
-    triangleCellNormals->Update(); // creates vtkPolyData
+        piece->GetPointData()->CopyAllocate(contoured->GetPointData());
+        piece->GetCellData()->CopyAllocate(contoured->GetCellData(), (vtkIdType) cells[v].size());
 
-    // Save the vtk poly data as a member of the struct
-    NewPtr->vtkPiece = triangleCellNormals->GetOutput();
+        for (size_t c = 0; c < cells[v].size(); c++)
+        {
+            contoured->GetCellPoints(cells[v][c], npts, pts);
+
+            std::vector<vtkIdType> ids(npts);
+
+            for (vtkIdType p = 0; p < npts; p++)
+            {
+                if (pointIds[pts[p]] < 0)
+                {
+                    pointIds[pts[p]] = points->InsertNextPoint(contoured->GetPoint(pts[p]));
+
+                    piece->GetPointData()->CopyData(contoured->GetPointData(), pts[p],
+                                                    pointIds[pts[p]]);
+                }
+
+                ids[p] = pointIds[pts[p]];
+            }
+
+            vtkIdType newId = triangles->InsertNextCell(npts, npts > 0 ? &ids[0] : NULL);
+
+            piece->GetCellData()->CopyData(contoured->GetCellData(), cells[v][c], newId);
+        }
+
+        piece->SetPoints(points);
+        piece->SetPolys(triangles);
+
+        points->Delete();
+        triangles->Delete();
+
+        pieces[v] = piece;
+    }
+}
+
+/**
+ * This function contours one file of the server. The file comes out of 
+ * the block cache, and its surface at every contour value comes out of 
+ * the surface cache when that value was contoured before, so 
+ * vtkContourFilter is only applied for the missing values, all of them in
+ * one pass whose output is split by value (see split_by_value). Returns 
+ * the surfaces appended in the order of the values.
+*/
+static vtkPolyData* cached_block_piece(params* NewPtr, const std::string& block)
+{
+    std::vector<double> values = *NewPtr->Values;
+
+    std::vector<vtkPolyData*> surfaces(values.size(), (vtkPolyData*) NULL);
+
+    int missing = (int) values.size();
+
+    for (int v = 0; v < (int) values.size(); v++)
+    {
+        surfaces[v] = surface_cache_find(NewPtr->Surfaces, block, values[v]);
+
+        if (surfaces[v] != NULL)
+            missing--;
+    }
+
+    vtkRectilinearGrid* grid = NULL;
+
+    // the grid is only needed for missing surfaces, or for the range
+    if (values.empty() || missing > 0)
+    {
+        grid = block_cache_acquire(NewPtr->Cache, block);
+
+        if (grid == NULL)
+            return vtkPolyData::New();
+    }
+
+    if (values.empty())
+    {
+        TRACE_STAGE(range);
+
+        double* range;
+
+        range = grid->GetPointData()->GetArray("grad")->GetRange();
+
+        // woo 50 contours, the same as vtkContourFilter would make them
+        generate_values(50, range, values);
+
+        surfaces.assign(values.size(), (vtkPolyData*) NULL);
+
+        for (int v = 0; v < (int) values.size(); v++)
+            surfaces[v] = surface_cache_find(NewPtr->Surfaces, block, values[v]);
+    }
+
+    // the values no surface was found for, contoured in one pass
+    std::vector<double> missingValues;
+    std::vector<int> missingIndex;
+
+    for (int v = 0; v < (int) values.size(); v++)
+    {
+        if (surfaces[v] == NULL)
+        {
+            missingValues.push_back(values[v]);
+            missingIndex.push_back(v);
+        }
+    }
+
+    if (!missingValues.empty())
+    {
+        vtkContourFilter* contour = vtkContourFilter::New();
+
+        // name of array is "grad"
+        contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS, "grad");
+
+        // better than setinput
+        contour->SetInputConnection(grid->GetProducerPort());
+
+        contour->SetNumberOfContours((int) missingValues.size());
+
+        for (int m = 0; m < (int) missingValues.size(); m++)
+            contour->SetValue(m, missingValues[m]);
+
+        contour->ComputeNormalsOn();
+
+        // the value of every point, to tell the surfaces apart afterwards
+        contour->ComputeScalarsOn();
+
+        // calc cell normal, the surfaces of different values never
+        // touch, so this is the same as for each of them alone
+        vtkPolyDataNormals *triangleCellNormals = vtkPolyDataNormals::New();
+
+        triangleCellNormals->SetInputConnection(contour->GetOutputPort());
+
+        triangleCellNormals->ComputeCellNormalsOn();
+        triangleCellNormals->ComputePointNormalsOff();
+        triangleCellNormals->ConsistencyOn();
+        triangleCellNormals->AutoOrientNormalsOn();
+
+        TRACE_BEGIN(contour);
+
+        contour->Update();
+
+        TRACE_END(contour);
+
+        TRACE_BEGIN(normals);
+
+        triangleCellNormals->Update(); // creates vtkPolyData
+
+        TRACE_END(normals);
+
+        std::vector<vtkPolyData*> contoured;
+
+        split_by_value(triangleCellNormals->GetOutput(), missingValues, contoured);
+
+        for (int m = 0; m < (int) missingValues.size(); m++)
+        {
+            int v = missingIndex[m];
+
+            surfaces[v] = contoured[m];
+
+            MEMORY_RECORD_DATA(normals, surfaces[v]);
+
+            surface_cache_store(NewPtr->Surfaces, block, values[v], surfaces[v]);
+        }
+
+        triangleCellNormals->Delete();
+        contour->Delete();
+    }
+
+    vtkAppendPolyData *appendSurfaces = vtkAppendPolyData::New();
+
+    for (int v = 0; v < (int) values.size(); v++)
+    {
+        appendSurfaces->AddInput(surfaces[v]);
+        surfaces[v]->Delete();
+    }
+
+    TRACE_BEGIN(append);
+
+    appendSurfaces->Update();
+
+    TRACE_END(append);
+
+    vtkPolyData* piece = vtkPolyData::New();
+    piece->ShallowCopy(appendSurfaces->GetOutput());
+
+    appendSurfaces->Delete();
+
+    // the grid lives on in the block cache
+    if (grid != NULL)
+        grid->Delete();
+
+    return piece;
+}
+
+/**
+ * This function is the thread function of the server. The thread takes 
+ * files threadId, threadId + NumThreads, ... like thread_function, 
+ * contours each of them with cached_block_piece and appends the pieces.
+*/
+void* cached_thread_function(void* ptr)
+{
+    params* NewPtr;
+    NewPtr = (params*) ptr;
+
+    std::vector<std::string> myFiles;
+
+    assign_blocks(*NewPtr->VTKinput, NewPtr->threadId, NewPtr->NumThreads, myFiles);
+
+    vtkAppendPolyData *appendPieces = vtkAppendPolyData::New();
+
+    for (size_t f = 0; f < myFiles.size(); f++)
+    {
+        vtkPolyData* piece = cached_block_piece(NewPtr, myFiles[f]);
+
+        appendPieces->AddInput(piece);
+
+        piece->Delete();
+    }
+
+    TRACE_BEGIN(append);
+
+    appendPieces->Update();
+
+    TRACE_END(append);
+
+    NewPtr->vtkPiece = vtkPolyData::New();
+    NewPtr->vtkPiece->ShallowCopy(appendPieces->GetOutput());
+
+    MEMORY_RECORD_DATA(append, NewPtr->vtkPiece);
+
+    appendPieces->Delete();
+
+    return NULL;
+}
+
+/**
+ * This function answers one "CONTOUR" request of the server: numThreads 
+ * threads (no more than there are files) take their files out of the 
+ * block cache, contour them with the given values (or 50 values over the
+ * range of each file if none are given) unless the surfaces are in the 
+ * surface cache, and the pieces are appended into the output's filename.
+*/
+static void contour_request(block_cache* cache, surface_cache* surfaces,
+                            const std::vector<std::string>& files, int numThreads,
+                            const std::vector<double>& values, const char* output)
+{
+    int size = numThreads < (int) files.size() ? numThreads : (int) files.size();
 
-    pointdata->Delete();
+    if (size < 1)
+        size = 1;
+
+    params thread_data_array[size];
+
+	pthread_t threads[size];
+
+	for (int f = 0; f < size; f++) {      
+        thread_data_array[f].VTKinput = &files;
+        thread_data_array[f].threadId = f;
+        thread_data_array[f].NumThreads = size;
+        thread_data_array[f].Cache = cache;
+        thread_data_array[f].Surfaces = surfaces;
+        thread_data_array[f].Values = &values;
+		pthread_create(&threads[f], NULL, cached_thread_function, (void*)&thread_data_array[f]);
+	}
+
+	for (int j = 0; j < size; j++)
+    {
+		pthread_join(threads[j], NULL);
+    }
+
+    vtkAppendPolyData *appendWriter = vtkAppendPolyData::New();
+
+    for(int k = 0; k < size; k++)
+    {
+        appendWriter->AddInput(thread_data_array[k].vtkPiece);
+
+        thread_data_array[k].vtkPiece->Delete();
+    }
+
+    TRACE_BEGIN(append);
+
+    appendWriter->Update();
+
+    TRACE_END(append);
+
+    MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
+    TRACE_BEGIN(write);
+
+    vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
+    pWriter->SetFileName(output);
+
+    pWriter->SetInput(appendWriter->GetOutput());
+
+    pWriter->Write();
+
+    TRACE_END(write);
+
+    pWriter->Delete();
+    appendWriter->Delete();
+}
+
+/**
+ * This function keeps the program resident and listens on a UNIX domain 
+ * socket. Each line sent to the socket is one request:
+ *
+ *   CONTOUR <output's filename> [value value ...]
+ *   STATS
+ *   SHUTDOWN
+ *
+ * and each request is answered with one line starting with "OK" or "ERR".
+ * The files are read into the block cache the first time they are needed,
+ * so repeated contours of the dataset only cost the contouring, and every
+ * surface is kept per file and contour value in the surface cache (and in
+ * surfaceDirectory, if not NULL), so only new values are contoured.
+*/
+static int serve(const char* socketPath, int size, const char* dataset, unsigned long budget,
+                 const char* surfaceDirectory)
+{
+    std::vector<std::string> files;
+
+    if (read_block_list(dataset, size, files) < 0)
+    {
+        fprintf(stderr, "Could not read the manifest %s\n", dataset);
+        return EXIT_FAILURE;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    unlink(socketPath);
+
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr*) &address, sizeof(address)) < 0 ||
+        listen(listener, 4) < 0)
+    {
+        perror(socketPath);
+        return EXIT_FAILURE;
+    }
+
+    printf("Serving %d files of %s on %s\n", (int) files.size(), dataset, socketPath);
+
+    // a client hanging up early must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    // the read files and the surfaces share the one budget
+    cache_budget* shared = cache_budget_create(budget);
+
+    block_cache* cache = block_cache_create(shared);
+
+    surface_cache* surfaces = surface_cache_create(shared, surfaceDirectory);
+
+    bool running = true;
+
+    while (running)
+    {
+        int connection = accept(listener, NULL, NULL);
+
+        if (connection < 0)
+            continue;
+
+        FILE* requests = fdopen(connection, "r");
+
+        char line[65536];
+
+        while (running && fgets(line, sizeof(line), requests) != NULL)
+        {
+            char reply[256];
+
+            char* command = strtok(line, " \t\r\n");
+
+            if (command == NULL)
+                continue;
+
+            if (strcmp(command, "CONTOUR") == 0)
+            {
+                char* output = strtok(NULL, " \t\r\n");
+
+                std::vector<double> values;
+
+                for (char* value = strtok(NULL, " \t\r\n"); value != NULL; value = strtok(NULL, " \t\r\n"))
+                    values.push_back(atof(value));
+
+                if (output == NULL)
+                {
+                    snprintf(reply, sizeof(reply), "ERR CONTOUR needs an output's filename\n");
+                }
+                else
+                {
+                    struct timespec t0,t1;
+
+                    clock_gettime(CLOCK_REALTIME,&t0);
+
+                    long misses = cache->Misses;
+
+                    long contoured = surfaces->Misses;
+
+                    contour_request(cache, surfaces, files, size, values, output);
+
+                    clock_gettime(CLOCK_REALTIME,&t1);
+
+                    double dt = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+
+                    snprintf(reply, sizeof(reply), "OK %f seconds, %ld files read, %ld surfaces contoured\n",
+                             dt, cache->Misses - misses, surfaces->Misses - contoured);
+                }
+            }
+            else if (strcmp(command, "STATS") == 0)
+            {
+                pthread_mutex_lock(&cache->mutex);
+                pthread_mutex_lock(&surfaces->mutex);
+                pthread_mutex_lock(&shared->mutex);
+                snprintf(reply, sizeof(reply), "OK %lu of %lu bytes; files: %lu bytes, %ld hits, %ld misses, %ld evictions; "
+                         "surfaces: %lu bytes, %ld hits, %ld from disk, %ld contoured\n",
+                         shared->Bytes, shared->Budget,
+                         cache->Bytes, cache->Hits, cache->Misses, cache->Evictions,
+                         surfaces->Bytes, surfaces->Hits, surfaces->DiskHits, surfaces->Misses);
+                pthread_mutex_unlock(&shared->mutex);
+                pthread_mutex_unlock(&surfaces->mutex);
+                pthread_mutex_unlock(&cache->mutex);
+            }
+            else if (strcmp(command, "SHUTDOWN") == 0)
+            {
+                snprintf(reply, sizeof(reply), "OK\n");
+                running = false;
+            }
+            else
+            {
+                snprintf(reply, sizeof(reply), "ERR unknown request %s\n", command);
+            }
+
+            if (write(connection, reply, strlen(reply)) < 0)
+                break;
+        }
+
+        // also closes the connection
+        fclose(requests);
+    }
+
+    surface_cache_destroy(surfaces);
+    block_cache_destroy(cache);
+    cache_budget_destroy(shared);
+
+    close(listener);
+    unlink(socketPath);
+
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Merges the files into bricks of about targetPoints points in a new 
+ * temporary directory, whose name goes in brickDir, and hands back the 
+ * bricks in place of the files. Returns -1 if they could not be merged.
+ */
+static int coalesce_at_load(std::vector<std::string>& files, long long targetPoints,
+                            std::string& brickDir)
+{
+    const char* tmp = getenv("TMPDIR");
+
+    std::string pattern = std::string(tmp != NULL ? tmp : "/tmp") + "/bricksXXXXXX";
+
+    std::vector<char> dir(pattern.begin(), pattern.end());
+    dir.push_back('\0');
+
+    if (mkdtemp(&dir[0]) == NULL)
+        return -1;
+
+    brickDir = &dir[0];
+
+    std::vector<std::string> bricks;
+    coalesce_stats stats;
+
+    if (coalesce_blocks(files, targetPoints, brickDir + "/brick.", bricks, &stats) < 0)
+        return -1;
+
+    if (getenv("LOADER_STATS") != NULL)
+    {
+        printf("Merged %d blocks into %d bricks of up to %d x %d x %d blocks in %f s\n",
+               stats.Blocks, stats.Bricks, stats.BlocksPerBrick[0], stats.BlocksPerBrick[1],
+               stats.BlocksPerBrick[2], stats.Seconds);
+    }
+
+    files.swap(bricks);
+
+    return (int) files.size();
+}
+
+/**
+ * Removes the temporary directory of the bricks, and the bricks in it.
+ */
+static void remove_brick_dir(const std::string& brickDir)
+{
+    DIR* dir = opendir(brickDir.c_str());
+
+    if (dir == NULL)
+        return;
+
+    struct dirent* entry;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            remove((brickDir + "/" + entry->d_name).c_str());
+    }
+
+    closedir(dir);
+
+    rmdir(brickDir.c_str());
 }
 
 /**
@@ -162,9 +748,49 @@ int main(int argc, char *argv[])
 
     clock_gettime(CLOCK_REALTIME,&t0);
 
+    if (argc > 4 && strcmp(argv[1], "--serve") == 0)
+    {
+        // 1 gigabyte of files by default
+        unsigned long budget = 1024;
+
+        if (argc > 5)
+            budget = strtoul(argv[5], NULL, 10);
+
+        return serve(argv[2], atoi(argv[3]), argv[4], budget * 1024 * 1024,
+                     argc > 6 ? argv[6] : NULL);
+    }
+
     /* Number of threads */
     int size = atoi(argv[1]);
 
+    // one file per thread, unless told otherwise
+    int numFiles = size;
+
+    if (argc > 4)
+        numFiles = atoi(argv[4]);
+
+    std::vector<std::string> files;
+
+    if (read_block_list(argv[3], numFiles, files) < 0)
+    {
+        fprintf(stderr, "Could not read the manifest %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    // small blocks are merged into bricks first, when asked to
+    std::string brickDir;
+
+    if (getenv("COALESCE_POINTS") != NULL &&
+        coalesce_at_load(files, atoll(getenv("COALESCE_POINTS")), brickDir) < 0)
+    {
+        fprintf(stderr, "Could not merge the blocks of %s into bricks\n", argv[3]);
+
+        if (!brickDir.empty())
+            remove_brick_dir(brickDir);
+
+        return EXIT_FAILURE;
+    }
+
     /* Array with elements of type params (the structure defined above) */
     params thread_data_array[size];
 
@@ -172,11 +798,13 @@ int main(int argc, char *argv[])
 
 	for (int f = 0; f < size; f++) {      
         //creating threads
-        // The file extension to look for is .f.vtk
-        std::string fileprefix = argv[3];
-
-        thread_data_array[f].VTKinput = fileprefix.c_str();
+        thread_data_array[f].VTKinput = &files;
         thread_data_array[f].threadId = f;
+        thread_data_array[f].NumThreads = size;
+        thread_data_array[f].LoaderDepth = loader_queue_depth();
+        thread_data_array[f].Cache = NULL;
+        thread_data_array[f].Surfaces = NULL;
+        thread_data_array[f].Values = NULL;
 		pthread_create(&threads[f], NULL, thread_function, (void*)&thread_data_array[f]);
 	}
 
@@ -184,6 +812,15 @@ int main(int argc, char *argv[])
 	for (int j = 0; j < size; j++)
     {
 		pthread_join(threads[j], NULL);
+
+        if (getenv("LOADER_STATS") != NULL)
+        {
+            char who[32];
+
+            sprintf(who, "Thread %d", j);
+
+            print_loader_stats(who, &thread_data_array[j].LoaderStats);
+        }
     }
 
     /* to append each piece into 1 big vtk file */
@@ -193,17 +830,21 @@ int main(int argc, char *argv[])
     // the vtk data
     for(int k = 0; k < size; k++)
     {
-        vtkPolyData *inputNum = vtkPolyData::New();
-
-        inputNum->ShallowCopy(thread_data_array[k].vtkPiece);
-
         appendWriter->AddInput(thread_data_array[k].vtkPiece);
 
+        TRACE_BEGIN(append);
+
         appendWriter->Update();
 
-        inputNum->Delete();
+        TRACE_END(append);
+
+        MEMORY_RECORD_DATA(append, appendWriter->GetOutput());
+
+        thread_data_array[k].vtkPiece->Delete();
     }
 
+    TRACE_BEGIN(write);
+
     // Output vtkpolydata file
     vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
     pWriter->SetFileName(argv[2]);
@@ -212,11 +853,20 @@ int main(int argc, char *argv[])
 
     pWriter->Write();
 
+    TRACE_END(write);
+
+    if (!brickDir.empty())
+        remove_brick_dir(brickDir);
+
     clock_gettime(CLOCK_REALTIME,&t1);
 
     double dt = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
 
     printf("The measured time elapsed to be: %f\n", dt);
 
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
 	return EXIT_SUCCESS;
 }
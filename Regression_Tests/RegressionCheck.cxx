@@ -0,0 +1,675 @@
+/**
+* Do whatever you want with public license
+* Version 2, September 3, 2013
+*
+* Copyright (C) 2013 Naoki Eto <neto@lbl.gov>
+*
+* Everyone is permitted to copy and distribute verbatim or modified
+* copies of this license document, and changing it is allowed as long
+* as the name is changed.
+*
+* Do whatever you want with the public license
+*
+* TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+*
+* 0. You just do what you want to do.
+* 1. Uses VTK_MAJOR_VERSION <= 5
+*
+*/
+/**
+* @file RegressionCheck.cxx
+* @author Naoki Eto
+* @brief This program is one regression test of a variant: it runs the
+*        command of the variant a few times in the current directory, and
+*        checks the points, triangles and bounds of the output polydata
+*        against the golden ones of the variant, so that no change drops
+*        or moves geometry, and the median time of the run and of every
+*        stage (from the stage traces, if the variant was built with
+*        STAGE_TRACING) against the baseline of the machine, failing if
+*        one got slower than the tolerance allows. A baseline file that is
+*        not there yet is recorded; a golden file that is not there fails
+*        the test, the golden outputs being committed, unless --record is
+*        given, which records both again.
+*
+*        With --consistent, it checks that the outputs measured by the
+*        tests of several variants have the same points, triangles and
+*        bounds.
+* @param[in] --output FILE - the output polydata of the command
+* @param[in] --golden FILE - the golden points, triangles and bounds
+* @param[in] --baseline FILE - the baseline seconds of the run and stages
+* @param[in] --measured FILE - where the points, triangles and bounds of
+*            this run go, for --consistent
+* @param[in] --tolerance X - how much slower than its baseline a stage may
+*            get, 0.25 being 25% (REGRESSION_TOLERANCE overrides it)
+* @param[in] --min-seconds X - stages faster than this in the baseline are
+*            too noisy to check (0.05)
+* @param[in] --repetitions N - runs of the command (3)
+* @param[in] --requires FILE - the program of the variant; the test fails
+*            if it has not been built
+* @param[in] --record - records the golden and baseline files again
+* @param[in] -- COMMAND... - the command line of the variant
+* @return - 0 if it passed, 1 if it failed
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "StageTraceSummary.h"
+
+/**
+ * What a test checks of an output polydata.
+ */
+typedef struct Surface_Summary
+{
+    long long Points;
+    long long Triangles;
+    double Bounds[6];
+} surface_summary;
+
+/**
+ * The median seconds of the whole run ("total") and of every stage.
+ */
+typedef struct Run_Timing
+{
+    std::vector<std::string> Names;
+    std::vector<double> Seconds;
+} run_timing;
+
+/**
+ * Swaps the bytes of a value of the given size, for the big endian binary
+ * legacy files on a little endian machine.
+ */
+static void swap_bytes(char* value, int size)
+{
+    for (int b = 0; b < size / 2; b++)
+        std::swap(value[b], value[size - 1 - b]);
+}
+
+/**
+ * Reads the points, triangles (polygons) and bounds of a legacy vtk
+ * polydata file, ASCII or binary. Returns false if it cannot be read.
+ */
+static bool read_surface(const std::string& path, surface_summary& surface)
+{
+    FILE* in = fopen(path.c_str(), "rb");
+
+    if (in == NULL)
+        return false;
+
+    surface.Points = -1;
+    surface.Triangles = 0;
+
+    for (int b = 0; b < 6; b++)
+        surface.Bounds[b] = 0;
+
+    char line[4096];
+    bool binary = false;
+    bool ok = true;
+
+    for (int n = 0; ok && fgets(line, sizeof(line), in) != NULL; n++)
+    {
+        if (n == 2)
+            binary = strncmp(line, "BINARY", 6) == 0;
+
+        long long count;
+        char type[64];
+
+        if (sscanf(line, "POINTS %lld %63s", &count, type) == 2)
+        {
+            surface.Points = count;
+
+            int size = strcmp(type, "double") == 0 ? 8 : 4;
+
+            for (long long p = 0; ok && p < count; p++)
+            {
+                double xyz[3];
+
+                for (int c = 0; ok && c < 3; c++)
+                {
+                    if (!binary)
+                    {
+                        ok = fscanf(in, "%lf", &xyz[c]) == 1;
+                        continue;
+                    }
+
+                    char value[8];
+
+                    ok = fread(value, size, 1, in) == 1;
+
+                    const int one = 1;
+
+                    if (*(const char*) &one == 1)
+                        swap_bytes(value, size);
+
+                    float single;
+
+                    if (size == 8)
+                        memcpy(&xyz[c], value, 8);
+                    else
+                    {
+                        memcpy(&single, value, 4);
+                        xyz[c] = single;
+                    }
+                }
+
+                for (int c = 0; ok && c < 3; c++)
+                {
+                    if (p == 0 || xyz[c] < surface.Bounds[2 * c])
+                        surface.Bounds[2 * c] = xyz[c];
+
+                    if (p == 0 || xyz[c] > surface.Bounds[2 * c + 1])
+                        surface.Bounds[2 * c + 1] = xyz[c];
+                }
+            }
+        }
+        else if (sscanf(line, "POLYGONS %lld", &count) == 1)
+        {
+            surface.Triangles = count;
+            break;
+        }
+    }
+
+    fclose(in);
+
+    return ok && surface.Points >= 0;
+}
+
+/**
+ * Writes the points, triangles and bounds to the file.
+ */
+static bool write_surface(const std::string& path, const surface_summary& surface,
+                          const char* comment)
+{
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "# %s\n", comment);
+    fprintf(out, "points %lld\n", surface.Points);
+    fprintf(out, "triangles %lld\n", surface.Triangles);
+    fprintf(out, "bounds %.9g %.9g %.9g %.9g %.9g %.9g\n", surface.Bounds[0],
+            surface.Bounds[1], surface.Bounds[2], surface.Bounds[3], surface.Bounds[4],
+            surface.Bounds[5]);
+
+    return fclose(out) == 0;
+}
+
+/**
+ * Reads a file written by write_surface(). Returns false if it is not
+ * there or not one.
+ */
+static bool load_surface(const std::string& path, surface_summary& surface)
+{
+    FILE* in = fopen(path.c_str(), "r");
+
+    if (in == NULL)
+        return false;
+
+    int found = 0;
+    char line[512];
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        double* b = surface.Bounds;
+
+        if (sscanf(line, "points %lld", &surface.Points) == 1)
+            found |= 1;
+        else if (sscanf(line, "triangles %lld", &surface.Triangles) == 1)
+            found |= 2;
+        else if (sscanf(line, "bounds %lf %lf %lf %lf %lf %lf",
+                        &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) == 6)
+            found |= 4;
+    }
+
+    fclose(in);
+
+    return found == 7;
+}
+
+/**
+ * Checks the surface against the expected one: the same points and
+ * triangles, and the same bounds up to the precision of the files. Prints
+ * what differs.
+ */
+static bool same_surface(const surface_summary& expected, const surface_summary& actual,
+                         const std::string& what)
+{
+    bool same = true;
+
+    if (expected.Points != actual.Points)
+    {
+        printf("%s: %lld points, expected %lld\n", what.c_str(), actual.Points, expected.Points);
+        same = false;
+    }
+
+    if (expected.Triangles != actual.Triangles)
+    {
+        printf("%s: %lld triangles, expected %lld\n", what.c_str(), actual.Triangles,
+               expected.Triangles);
+        same = false;
+    }
+
+    for (int b = 0; b < 6; b++)
+    {
+        double extent = fabs(expected.Bounds[b | 1] - expected.Bounds[b & ~1]);
+
+        if (fabs(expected.Bounds[b] - actual.Bounds[b]) > 1.0e-5 * (extent > 1 ? extent : 1))
+        {
+            printf("%s: bound %d is %.9g, expected %.9g\n", what.c_str(), b, actual.Bounds[b],
+                   expected.Bounds[b]);
+            same = false;
+        }
+    }
+
+    return same;
+}
+
+/**
+ * Writes the timing to the file, one "name seconds" line each.
+ */
+static bool write_timing(const std::string& path, const run_timing& timing)
+{
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "# median seconds of the run (total) and of its stages on this machine\n");
+
+    for (size_t s = 0; s < timing.Names.size(); s++)
+        fprintf(out, "%s %.6f\n", timing.Names[s].c_str(), timing.Seconds[s]);
+
+    return fclose(out) == 0;
+}
+
+/**
+ * Reads a file written by write_timing(). Returns false if it is not
+ * there.
+ */
+static bool load_timing(const std::string& path, run_timing& timing)
+{
+    FILE* in = fopen(path.c_str(), "r");
+
+    if (in == NULL)
+        return false;
+
+    char line[512];
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        char name[64];
+        double seconds;
+
+        if (line[0] != '#' && sscanf(line, "%63s %lf", name, &seconds) == 2)
+        {
+            timing.Names.push_back(name);
+            timing.Seconds.push_back(seconds);
+        }
+    }
+
+    fclose(in);
+
+    return true;
+}
+
+/**
+ * Returns the seconds of the stage, or -1 if it is not in the timing.
+ */
+static double timing_of(const run_timing& timing, const std::string& name)
+{
+    for (size_t s = 0; s < timing.Names.size(); s++)
+    {
+        if (timing.Names[s] == name)
+            return timing.Seconds[s];
+    }
+
+    return -1;
+}
+
+/**
+ * Returns the median of the values.
+ */
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+
+    size_t n = values.size();
+
+    return n % 2 == 1 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+/**
+ * Runs the command and waits for it. Returns its exit status (-1 if it
+ * could not be run or was killed), and how long it took in seconds.
+ */
+static int run_command(const std::vector<std::string>& command, double& seconds)
+{
+    std::vector<char*> args;
+
+    for (size_t a = 0; a < command.size(); a++)
+        args.push_back((char*) command[a].c_str());
+
+    args.push_back(NULL);
+
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    fflush(stdout);
+
+    pid_t child = fork();
+
+    if (child < 0)
+        return -1;
+
+    if (child == 0)
+    {
+        execvp(args[0], &args[0]);
+
+        _exit(127);
+    }
+
+    int status;
+
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+
+    seconds = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * Checks that the measured outputs of the variants are all the same. A
+ * variant that was not measured (its test failed before measuring it)
+ * fails the check.
+ */
+static int check_consistent(const std::vector<std::string>& paths)
+{
+    std::vector<surface_summary> surfaces;
+    std::vector<std::string> names;
+
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        surface_summary surface;
+
+        if (load_surface(paths[p], surface))
+        {
+            surfaces.push_back(surface);
+            names.push_back(paths[p]);
+        }
+        else
+            printf("%s was not measured\n", paths[p].c_str());
+    }
+
+    if (surfaces.size() < paths.size() || surfaces.empty())
+        return EXIT_FAILURE;
+
+    bool same = true;
+
+    for (size_t s = 1; s < surfaces.size(); s++)
+        same = same_surface(surfaces[0], surfaces[s], names[s] + " against " + names[0]) && same;
+
+    if (same)
+        printf("%d variants agree: %lld points, %lld triangles\n", (int) surfaces.size(),
+               surfaces[0].Points, surfaces[0].Triangles);
+
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Prints how to use the program.
+ */
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s --output FILE [--golden FILE] [--baseline FILE] [--measured FILE]\n"
+            "          [--tolerance X] [--min-seconds X] [--repetitions N]\n"
+            "          [--requires PROGRAM] [--record] -- COMMAND...\n"
+            "       %s --consistent MEASURED...\n", program, program);
+}
+
+/**
+ * This program runs one regression test, see above.
+ */
+int main(int argc, char *argv[])
+{
+    std::string output, golden, baseline, measured, program;
+    double tolerance = 0.25;
+    double minSeconds = 0.05;
+    int repetitions = 3;
+    bool record = false;
+    std::vector<std::string> command;
+
+    int a = 1;
+
+    if (argc > 1 && strcmp(argv[1], "--consistent") == 0)
+        return check_consistent(std::vector<std::string>(argv + 2, argv + argc));
+
+    for (; a < argc; a++)
+    {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (arg == "--")
+        {
+            command.assign(argv + a + 1, argv + argc);
+            break;
+        }
+        else if (arg == "--record")
+            record = true;
+        else if (arg == "--output" && hasValue)
+            output = argv[++a];
+        else if (arg == "--golden" && hasValue)
+            golden = argv[++a];
+        else if (arg == "--baseline" && hasValue)
+            baseline = argv[++a];
+        else if (arg == "--measured" && hasValue)
+            measured = argv[++a];
+        else if (arg == "--requires" && hasValue)
+            program = argv[++a];
+        else if (arg == "--tolerance" && hasValue)
+            tolerance = atof(argv[++a]);
+        else if (arg == "--min-seconds" && hasValue)
+            minSeconds = atof(argv[++a]);
+        else if (arg == "--repetitions" && hasValue)
+            repetitions = atoi(argv[++a]);
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (output.empty() || command.empty())
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // a measure of an earlier run must not stand in for this one
+    if (!measured.empty())
+        remove(measured.c_str());
+
+    if (!program.empty() && access(program.c_str(), X_OK) != 0)
+    {
+        printf("%s has not been built; build it, or leave the variant out of "
+               "REGRESSION_VARIANTS\n", program.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const char* envTolerance = getenv("REGRESSION_TOLERANCE");
+
+    if (envTolerance != NULL && *envTolerance != '\0')
+        tolerance = atof(envTolerance);
+
+    if (repetitions < 1)
+        repetitions = 1;
+
+    surface_summary surface;
+    std::vector<double> totals;
+    std::vector<std::string> stageNames;
+    std::vector<std::vector<double> > stageRuns;
+
+    for (int r = 0; r < repetitions; r++)
+    {
+        remove(output.c_str());
+        remove_stage_traces(".");
+
+        double seconds;
+
+        int status = run_command(command, seconds);
+
+        if (status != 0)
+        {
+            printf("Run %d of %s failed (exit status %d)\n", r + 1, command[0].c_str(), status);
+            return EXIT_FAILURE;
+        }
+
+        surface_summary run;
+
+        if (!read_surface(output, run))
+        {
+            printf("Run %d wrote no polydata to %s\n", r + 1, output.c_str());
+            return EXIT_FAILURE;
+        }
+
+        char which[32];
+
+        sprintf(which, "run %d", r + 1);
+
+        // every run has to give the same geometry, whatever the threads do
+        if (r > 0 && !same_surface(surface, run, which))
+            return EXIT_FAILURE;
+
+        surface = run;
+        totals.push_back(seconds);
+
+        std::vector<std::string> names;
+        std::vector<double> stageSeconds;
+
+        read_stage_traces(".", names, stageSeconds);
+
+        for (size_t s = 0; s < names.size(); s++)
+        {
+            size_t at = std::find(stageNames.begin(), stageNames.end(), names[s]) -
+                        stageNames.begin();
+
+            if (at == stageNames.size())
+            {
+                stageNames.push_back(names[s]);
+                stageRuns.push_back(std::vector<double>());
+            }
+
+            stageRuns[at].push_back(stageSeconds[s]);
+        }
+    }
+
+    remove_stage_traces(".");
+
+    printf("%lld points, %lld triangles, bounds [%g, %g] [%g, %g] [%g, %g]\n", surface.Points,
+           surface.Triangles, surface.Bounds[0], surface.Bounds[1], surface.Bounds[2],
+           surface.Bounds[3], surface.Bounds[4], surface.Bounds[5]);
+
+    if (!measured.empty() && !write_surface(measured, surface, "measured by the last test run"))
+        printf("Could not write %s\n", measured.c_str());
+
+    bool passed = true;
+
+    if (surface.Triangles == 0)
+    {
+        printf("The output has no triangles\n");
+        passed = false;
+    }
+
+    surface_summary expected;
+
+    if (!golden.empty() && !record)
+    {
+        if (load_surface(golden, expected))
+            passed = same_surface(expected, surface, "geometry") && passed;
+        else
+        {
+            printf("There is no golden output in %s, record it with --record "
+                   "(cmake -DREGRESSION_RECORD=ON)\n", golden.c_str());
+            passed = false;
+        }
+    }
+    else if (!golden.empty())
+    {
+        if (write_surface(golden, surface, "golden output, checked by RegressionCheck"))
+            printf("Recorded the golden output in %s\n", golden.c_str());
+        else
+        {
+            printf("Could not write %s\n", golden.c_str());
+            passed = false;
+        }
+    }
+
+    run_timing timing;
+
+    timing.Names.push_back("total");
+    timing.Seconds.push_back(median(totals));
+
+    for (size_t s = 0; s < stageNames.size(); s++)
+    {
+        // a stage that some runs did not trace did not take any time in them
+        stageRuns[s].resize(repetitions, 0.0);
+
+        timing.Names.push_back(stageNames[s]);
+        timing.Seconds.push_back(median(stageRuns[s]));
+    }
+
+    run_timing base;
+
+    if (!baseline.empty() && !record && load_timing(baseline, base))
+    {
+        for (size_t s = 0; s < base.Names.size(); s++)
+        {
+            double now = timing_of(timing, base.Names[s]);
+            double before = base.Seconds[s];
+
+            if (now < 0)
+            {
+                printf("%-8s not traced in this build\n", base.Names[s].c_str());
+                continue;
+            }
+
+            const char* verdict = "ok";
+
+            if (before < minSeconds)
+                verdict = "too short to check";
+            else if (now > before * (1.0 + tolerance))
+            {
+                verdict = "REGRESSED";
+                passed = false;
+            }
+
+            printf("%-8s %10.4f s, baseline %10.4f s (%+.1f%%) %s\n", base.Names[s].c_str(), now,
+                   before, before > 0 ? 100.0 * (now - before) / before : 0.0, verdict);
+        }
+    }
+    else if (!baseline.empty())
+    {
+        if (write_timing(baseline, timing))
+            printf("Recorded the timing baseline in %s\n", baseline.c_str());
+        else
+            printf("Could not write %s\n", baseline.c_str());
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
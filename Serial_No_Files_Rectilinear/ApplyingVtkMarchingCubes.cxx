@@ -23,7 +23,10 @@
 * @brief This program gets the VTK file and converts it to a metaimage data 
 *        so that vtkMarchingCubes class can be applied. It applies marching 
 *        cubes to the data and outputs the resulting vtk file.
-* @param[in] argv[1] - the output's filename
+* @param[in] argv[1] - the output's filename, or --stream followed by the
+*            output's filename, one rectilinear file, and optionally the
+*            lowest and highest contour value, to contour a file that does
+*            not fit in memory two Z-planes at a time
 * @param[out] pWriter - vtkPolyData file with the output's filename
 * @return - EXIT_SUCCESS at the end
 */
@@ -57,7 +60,55 @@
 #include <time.h>
 
 #include <stdio.h>
-#include "/work2/vt-system-install/include/vampirtrace/vt_user.h"
+
+#include "MemoryAccounting.h"
+#include "StageTracer.h"
+#include "StreamingContour.h"
+
+/**
+ * The --stream mode: contours one rectilinear file slab by slab, so that
+ * only two Z-planes of it are in memory, and writes the triangles as each
+ * slab is done.
+ */
+static int stream_main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: %s --stream OUTPUT FILE [MIN MAX]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double given[2];
+    const double* range = NULL;
+
+    // without a range, the file is read once more to find it
+    if (argc > 5)
+    {
+        given[0] = atof(argv[4]);
+        given[1] = atof(argv[5]);
+        range = given;
+    }
+
+    stream_stats stats;
+
+    if (stream_contour_file(argv[3], argv[2], 50, range, &stats) < 0)
+    {
+        fprintf(stderr, "Could not contour %s into %s\n", argv[3], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
+
+    printf("Streamed %d x %d x %d points in %d slabs (%lld bytes of planes): "
+           "%lld triangles over [%g, %g], range scan %f s, contour %f s\n",
+           stats.Dims[0], stats.Dims[1], stats.Dims[2], stats.Slabs, stats.PlaneBytes,
+           stats.Triangles, stats.Range[0], stats.Range[1], stats.ScanSeconds,
+           stats.ContourSeconds);
+
+    return EXIT_SUCCESS;
+}
 
 /**
  * This program converts a vtkPolyData image into volume representation 
@@ -69,10 +120,10 @@
  */
 int main(int argc, char *argv[])
 {
-    /* The vtk file extension we want to search for */
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0)
+        return stream_main(argc, argv);
 
-    //VT_ON();
-    //VT_USER_START("Region 1");
+    /* The vtk file extension we want to search for */
 
     const char* fp = argv[2];
 
@@ -95,8 +146,7 @@ int main(int argc, char *argv[])
 
     strcat(prefix_suffix, suffix);
 
-    //VT_USER_END("Region 1");
-    //VT_OFF();
+    TRACE_BEGIN(read);
 
     vtkRectilinearGridReader *reader = vtkRectilinearGridReader::New();
 
@@ -107,12 +157,22 @@ int main(int argc, char *argv[])
     vtkSmartPointer<vtkRectilinearGrid> grid = reader->GetOutput();
     reader->Delete();
 
+    TRACE_END(read);
+
+    MEMORY_RECORD_DATA(read, grid);
+
     vtkPointData* pointdata = grid->GetPointData();
 
     double* range;
 
+    TRACE_BEGIN(range);
+
     range = pointdata->GetArray("grad")->GetRange();
 
+    TRACE_END(range);
+
+    TRACE_BEGIN(contour);
+
     vtkContourFilter* contour = vtkContourFilter::New();
 
     // name of array is "grad"
@@ -126,6 +186,12 @@ int main(int argc, char *argv[])
 
     contour->Update();
 
+    TRACE_END(contour);
+
+    MEMORY_RECORD_DATA(contour, contour->GetOutput());
+
+    TRACE_BEGIN(normals);
+
     // calc cell normal
     vtkPolyDataNormals *triangleCellNormals= vtkPolyDataNormals::New();
 
@@ -137,8 +203,11 @@ int main(int argc, char *argv[])
     triangleCellNormals->AutoOrientNormalsOn();
     triangleCellNormals->Update(); // creates vtkPolyData
 
-    VT_ON();
-    VT_USER_START("Region 5");
+    TRACE_END(normals);
+
+    MEMORY_RECORD_DATA(normals, triangleCellNormals->GetOutput());
+
+    TRACE_BEGIN(write);
 
     /* vtkPolyDataWriter for output vtk file */
     vtkPolyDataWriter *pWriter = vtkPolyDataWriter::New();
@@ -152,8 +221,11 @@ int main(int argc, char *argv[])
     pointdata->Delete();
     contour->Delete();
 
-    VT_USER_END("Region 5");
-    VT_OFF();
+    TRACE_END(write);
+
+    TRACE_DUMP();
+
+    MEMORY_REPORT();
 /*
     // Remove any duplicate points.
     vtkCleanPolyData *cleanFilter = vtkCleanPolyData::New();
@@ -181,8 +253,6 @@ int main(int argc, char *argv[])
     // Render and interact
     renderWindow->Render();
     renderWindowInteractor->Start();
-
-    //VT_USER_END("ApplyingVtkMarchingCubes");  
 */
     return EXIT_SUCCESS;
 }